@@ -1,4 +1,3 @@
-import random
 import sys
 import argparse
 from dd_client import DD
@@ -11,6 +10,7 @@ parser.add_argument("--cpu", action='store_true', help="Force model to run on CP
 parser.add_argument("--input-size", type=int, default=512)
 parser.add_argument("--topk", type=int, default=5, help="How many top predictions should be considered to chose the next token.")
 parser.add_argument("--temperature", type=float, default=1, help="Temperature of the predictions. The higher, the 'randomer'.")
+parser.add_argument("--max-tokens", type=int, default=256, help="How many tokens to generate at most.")
 
 args = parser.parse_args()
 
@@ -37,39 +37,15 @@ parameters_output = {}
 dd.put_service(sname,model,description,mllib,
                parameters_input,parameters_mllib,parameters_output)
 
-# generating text
+# generating text, the server samples the tokens one after the other
 prompt = input("Enter beggining of sentence >>> ")
 
-for i in range(0, 256):
-    data = [prompt]
-    parameters_input = {'word_start': "Ġ", 'suffix_start': ""}
-    parameters_mllib = {}
-    parameters_output = {'best':args.topk}
-    result = dd.post_predict(sname, data, parameters_input,parameters_mllib,parameters_output)
-
-    # Select result from the returned tokens
-    word_probs = list()
-    total_probs = 0
-
-    for cls in result['body']['predictions'][0]['classes']:
-        word = cls['cat'].replace("Ġ", " ")
-        # dede does not support \n character well, so we don't select tokens containing a new line
-        if 'Ċ' in word:
-            continue
-
-        prob = pow(cls['prob'], args.temperature)
-        total_probs += prob
-        word_probs.append((word, prob))
-    
-    selector = random.uniform(0, total_probs)
-    total_probs = 0
-
-    for word, prob in word_probs:
-        total_probs += prob
-        if total_probs > selector:
-            selected_word = word
-            break
+data = [prompt]
+parameters_input = {'word_start': "Ġ", 'suffix_start': ""}
+parameters_mllib = {'generate': {'max_tokens': args.max_tokens,
+                                 'top_k': args.topk,
+                                 'temperature': args.temperature}}
+parameters_output = {}
+result = dd.post_predict(sname, data, parameters_input,parameters_mllib,parameters_output)
 
-    print(selected_word, sep='', end='')
-    sys.stdout.flush()
-    prompt += selected_word
+print(prompt + result['body']['predictions'][0]['classes'][0]['cat'])
@@ -2314,9 +2314,9 @@ namespace dd
     while (hit != txt.end())
       {
         if (_characters)
-          datum = to_datum<TxtCharEntry>(static_cast<TxtCharEntry *>((*hit)));
+          datum = to_datum(static_cast<TxtCharEntry *>((*hit)));
         else
-          datum = to_datum<TxtBowEntry>(static_cast<TxtBowEntry *>((*hit)));
+          datum = to_datum(static_cast<TxtBowEntry *>((*hit)));
         if (_channels == 0)
           _channels = datum.channels();
         int length = snprintf(key_cstr, kMaxKeyLength, "%s",
@@ -2369,7 +2369,7 @@ namespace dd
     while (hit != txt.end())
       {
         /*if (_characters)
-          datum = to_datum<TxtCharEntry>(static_cast<TxtCharEntry*>((*hit)));
+          datum = to_datum(static_cast<TxtCharEntry*>((*hit)));
           else*/
         datum = to_sparse_datum(static_cast<TxtBowEntry *>((*hit)));
         int length = snprintf(key_cstr, kMaxKeyLength, "%s",
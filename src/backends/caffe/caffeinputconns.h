@@ -1199,10 +1199,10 @@ namespace dd
                   if (!_sparse)
                     {
                       if (_characters)
-                        _dv.push_back(std::move(to_datum<TxtCharEntry>(
+                        _dv.push_back(std::move(to_datum(
                             static_cast<TxtCharEntry *>((*hit)))));
                       else
-                        _dv.push_back(std::move(to_datum<TxtBowEntry>(
+                        _dv.push_back(std::move(to_datum(
                             static_cast<TxtBowEntry *>((*hit)))));
                     }
                   else
@@ -1246,10 +1246,10 @@ namespace dd
                   if (!_sparse)
                     {
                       if (_characters)
-                        _dv_test.push_back(std::move(to_datum<TxtCharEntry>(
+                        _dv_test.push_back(std::move(to_datum(
                             static_cast<TxtCharEntry *>((*hit)))));
                       else
-                        _dv_test.push_back(std::move(to_datum<TxtBowEntry>(
+                        _dv_test.push_back(std::move(to_datum(
                             static_cast<TxtBowEntry *>((*hit)))));
                     }
                   else
@@ -1322,13 +1322,11 @@ namespace dd
       _test_db = std::unique_ptr<caffe::db::DB>();
     }
 
-    template <class TEntry> caffe::Datum to_datum(TEntry *tbe)
+    caffe::Datum to_datum(TxtBowEntry *tbe)
     {
       caffe::Datum datum;
       int datum_channels;
-      if (_characters)
-        datum_channels = 1;
-      else if (_embed && !_characters)
+      if (_embed)
         datum_channels = _sequence;
       else
         datum_channels = _vocab.size(); // XXX: may be very large
@@ -1336,89 +1334,89 @@ namespace dd
       datum.set_height(1);
       datum.set_width(1);
       datum.set_label(tbe->_target);
-      if (!_characters)
+      if (!_embed)
         {
-          std::unordered_map<std::string, Word>::const_iterator wit;
-          if (!_embed)
-            {
-              for (int i = 0; i < datum_channels;
-                   i++) // XXX: expected to be slow
-                datum.add_float_data(0.0);
-              tbe->reset();
-              while (tbe->has_elt())
-                {
-                  std::string key;
-                  double val;
-                  tbe->get_next_elt(key, val);
-                  if ((wit = _vocab.find(key)) != _vocab.end())
-                    datum.set_float_data(_vocab[key]._pos,
-                                         static_cast<float>(val));
-                }
-            }
-          else
+          for (int i = 0; i < datum_channels;
+               i++) // XXX: expected to be slow
+            datum.add_float_data(0.0);
+          tbe->reset();
+          while (tbe->has_elt())
             {
-              tbe->reset();
-              int i = 0;
-              while (tbe->has_elt())
-                {
-                  std::string key;
-                  double val;
-                  tbe->get_next_elt(key, val);
-                  if ((wit = _vocab.find(key)) != _vocab.end())
-                    datum.add_float_data(static_cast<float>(_vocab[key]._pos));
-                  ++i;
-                  if (i == _sequence) // tmp limit on sequence length
-                    break;
-                }
-              while (datum.float_data_size() < _sequence)
-                datum.add_float_data(0.0);
+              int pos;
+              double val;
+              tbe->get_next_elt(pos, val);
+              datum.set_float_data(pos, static_cast<float>(val));
             }
         }
-      else // character-level features
+      else
         {
           tbe->reset();
-          std::vector<int> vals;
-          std::unordered_map<uint32_t, int>::const_iterator whit;
+          int i = 0;
           while (tbe->has_elt())
             {
-              std::string key;
-              double val = -1.0;
-              tbe->get_next_elt(key, val);
-              uint32_t c = std::strtoul(key.c_str(), 0, 10);
-              if ((whit = _alphabet.find(c)) != _alphabet.end())
-                vals.push_back((*whit).second);
-              else
-                vals.push_back(-1);
+              int pos;
+              double val;
+              tbe->get_next_elt(pos, val);
+              datum.add_float_data(static_cast<float>(pos));
+              ++i;
+              if (i == _sequence) // tmp limit on sequence length
+                break;
             }
-          /*if (vals.size() > _sequence)
-            std::cerr << "more characters than sequence / " << vals.size() << "
-            / sequence=" << _sequence << std::endl;*/
-          if (!_embed)
+          while (datum.float_data_size() < _sequence)
+            datum.add_float_data(0.0);
+        }
+      return datum;
+    }
+
+    caffe::Datum to_datum(TxtCharEntry *tbe)
+    {
+      caffe::Datum datum;
+      datum.set_channels(1);
+      datum.set_height(1);
+      datum.set_width(1);
+      datum.set_label(tbe->_target);
+      tbe->reset();
+      std::vector<int> vals;
+      std::unordered_map<uint32_t, int>::const_iterator whit;
+      while (tbe->has_elt())
+        {
+          std::string key;
+          double val = -1.0;
+          tbe->get_next_elt(key, val);
+          uint32_t c = std::strtoul(key.c_str(), 0, 10);
+          if ((whit = _alphabet.find(c)) != _alphabet.end())
+            vals.push_back((*whit).second);
+          else
+            vals.push_back(-1);
+        }
+      /*if (vals.size() > _sequence)
+        std::cerr << "more characters than sequence / " << vals.size() << "
+        / sequence=" << _sequence << std::endl;*/
+      if (!_embed)
+        {
+          for (int c = 0; c < _sequence; c++)
             {
-              for (int c = 0; c < _sequence; c++)
-                {
-                  std::vector<float> v(_alphabet.size(), 0.0);
-                  if (c < (int)vals.size() && vals[c] != -1)
-                    v[vals[c]] = 1.0;
-                  for (float f : v)
-                    datum.add_float_data(f);
-                }
-              datum.set_height(_sequence);
-              datum.set_width(_alphabet.size());
+              std::vector<float> v(_alphabet.size(), 0.0);
+              if (c < (int)vals.size() && vals[c] != -1)
+                v[vals[c]] = 1.0;
+              for (float f : v)
+                datum.add_float_data(f);
             }
-          else
+          datum.set_height(_sequence);
+          datum.set_width(_alphabet.size());
+        }
+      else
+        {
+          for (int c = 0; c < _sequence; c++)
             {
-              for (int c = 0; c < _sequence; c++)
-                {
-                  double val = 0.0;
-                  if (c < (int)vals.size() && vals[c] != -1)
-                    val = static_cast<float>(
-                        vals[c] + 1.0); // +1 as offset to null index
-                  datum.add_float_data(val);
-                }
-              datum.set_height(_sequence);
-              datum.set_width(1);
+              double val = 0.0;
+              if (c < (int)vals.size() && vals[c] != -1)
+                val = static_cast<float>(vals[c]
+                                         + 1.0); // +1 as offset to null index
+              datum.add_float_data(val);
             }
+          datum.set_height(_sequence);
+          datum.set_width(1);
         }
       return datum;
     }
@@ -1427,21 +1425,16 @@ namespace dd
     {
       caffe::SparseDatum datum;
       datum.set_label(tbe->_target);
-      std::unordered_map<std::string, Word>::const_iterator wit;
       tbe->reset();
       int nwords = 0;
       while (tbe->has_elt())
         {
-          std::string key;
+          int word_pos;
           double val;
-          tbe->get_next_elt(key, val);
-          if ((wit = _vocab.find(key)) != _vocab.end())
-            {
-              int word_pos = _vocab[key]._pos;
-              datum.add_data(static_cast<float>(val));
-              datum.add_indices(word_pos);
-              ++nwords;
-            }
+          tbe->get_next_elt(word_pos, val);
+          datum.add_data(static_cast<float>(val));
+          datum.add_indices(word_pos);
+          ++nwords;
         }
       datum.set_nnz(nwords);
       datum.set_size(_vocab.size());
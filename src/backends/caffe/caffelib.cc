@@ -3762,6 +3762,7 @@ namespace dd
           conf._timeseries = true;
       }
 
+    this->_stats.output_start();
     oatpp::Object<DTO::PredictBody> out_dto;
     conf._nclasses = nclasses;
     conf._has_bbox = bbox;
@@ -3779,6 +3780,7 @@ namespace dd
             = unsupo.finalize(ad.getobj("parameters").getobj("output"), conf,
                               static_cast<MLModel *>(&this->_mlmodel));
       }
+    this->_stats.output_end();
     if (ad.has("chain") && ad.get("chain").get<bool>())
       {
         if (typeid(inputc) == typeid(ImgCaffeInputFileConn))
@@ -411,10 +411,12 @@ namespace dd
           }
         idoffset += dv.size();
       } // end prediction loop over batches
+    this->_stats.output_start();
     tout.add_results(vrad);
     out.add("bbox", bbox);
     tout.finalize(ad.getobj("parameters").getobj("output"), out,
                   static_cast<MLModel *>(&this->_mlmodel));
+    this->_stats.output_end();
     if (ad.has("chain") && ad.get("chain").get<bool>())
       {
         if (typeid(inputc) == typeid(ImgDlibInputFileConn))
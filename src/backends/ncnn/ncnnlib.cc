@@ -380,9 +380,11 @@ namespace dd
       conf._timeseries = true;
     if (output_params->bbox == true)
       conf._has_bbox = true;
+    this->_stats.output_start();
     oatpp::Object<DTO::PredictBody> out_dto
         = tout.finalize(predict_dto->parameters->output, conf,
                         static_cast<MLModel *>(&this->_mlmodel));
+    this->_stats.output_end();
 
     // chain compliance
     if (ad.has("chain") && ad.get("chain").get<bool>())
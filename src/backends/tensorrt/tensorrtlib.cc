@@ -1232,6 +1232,7 @@ namespace dd
 
     cudaStreamDestroy(cstream);
 
+    this->_stats.output_start();
     oatpp::Object<DTO::PredictBody> out_dto;
     OutputConnectorConfig conf;
     if (extract_layer.empty())
@@ -1252,6 +1253,7 @@ namespace dd
         out_dto = unsupo.finalize(predict_dto->parameters->output, conf,
                                   static_cast<MLModel *>(&this->_mlmodel));
       }
+    this->_stats.output_end();
 
     if (predict_dto->_chain)
       {
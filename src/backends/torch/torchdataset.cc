@@ -24,6 +24,8 @@
 #include "torchdataset.h"
 #include "torchinputconns.h"
 
+#include <cstring>
+
 namespace dd
 {
   void TorchDataset::db_finalize()
@@ -118,10 +120,57 @@ namespace dd
       }
   }
 
+  // raw image record: magic, rows, cols, opencv type, then the pixel rows
+  static const char raw_magic[4] = { 'D', 'D', 'R', 'W' };
+  static const size_t raw_header_size
+      = sizeof(raw_magic) + 3 * sizeof(int32_t);
+
+  void TorchDataset::image_to_raw(const cv::Mat &img, std::string &out)
+  {
+    if (img.depth() != CV_8U)
+      throw InputConnectorBadParamException(
+          "raw db images must be 8-bit images");
+    int32_t header[3] = { img.rows, img.cols, img.type() };
+    size_t row_bytes = img.cols * img.elemSize();
+    out.resize(raw_header_size + img.rows * row_bytes);
+    char *dst = &out[0];
+    std::memcpy(dst, raw_magic, sizeof(raw_magic));
+    std::memcpy(dst + sizeof(raw_magic), header, sizeof(header));
+    dst += raw_header_size;
+    for (int r = 0; r < img.rows; ++r, dst += row_bytes)
+      std::memcpy(dst, img.ptr(r), row_bytes);
+  }
+
+  bool TorchDataset::raw_to_image(const std::string &raw, cv::Mat &img)
+  {
+    if (raw.size() < raw_header_size
+        || std::memcmp(raw.data(), raw_magic, sizeof(raw_magic)) != 0)
+      return false;
+    int32_t header[3];
+    std::memcpy(header, raw.data() + sizeof(raw_magic), sizeof(header));
+    img.create(header[0], header[1], header[2]);
+    size_t bytes = img.total() * img.elemSize();
+    if (raw.size() != raw_header_size + bytes)
+      throw InputConnectorInternalException(
+          "corrupted raw db image, expected "
+          + std::to_string(raw_header_size + bytes) + " bytes, got "
+          + std::to_string(raw.size()));
+    std::memcpy(img.data, raw.data() + raw_header_size, bytes);
+    return true;
+  }
+
   void TorchDataset::image_to_stringstream(const cv::Mat &img,
                                            std::ostringstream &dstream,
                                            const bool &lossless)
   {
+    if (_db_raw)
+      {
+        std::string raw;
+        image_to_raw(img, raw);
+        dstream.write(raw.data(), raw.size());
+        return;
+      }
+
     std::vector<uint8_t> buffer;
     std::vector<int> param;
     std::string ext;
@@ -210,16 +259,30 @@ namespace dd
                                         cv::Mat &bw_target, const bool &bw,
                                         const int &width, const int &height)
   {
-    std::vector<uint8_t> img_data(datas.begin(), datas.end());
-    bgr = cv::Mat(img_data, true);
-    bgr = cv::imdecode(bgr,
-                       bw ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR);
+    if (raw_to_image(datas, bgr))
+      {
+        if (bw && bgr.channels() == 3)
+          cv::cvtColor(bgr, bgr, cv::COLOR_BGR2GRAY);
+        else if (!bw && bgr.channels() == 1)
+          cv::cvtColor(bgr, bgr, cv::COLOR_GRAY2BGR);
+      }
+    else
+      {
+        std::vector<uint8_t> img_data(datas.begin(), datas.end());
+        bgr = cv::Mat(img_data, true);
+        bgr = cv::imdecode(bgr,
+                           bw ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR);
+      }
 
     if (_segmentation)
       {
-        std::vector<uint8_t> img_target_data(targets.begin(), targets.end());
-        bw_target = cv::Mat(img_target_data, true);
-        bw_target = cv::imdecode(bw_target, CV_LOAD_IMAGE_GRAYSCALE);
+        if (!raw_to_image(targets, bw_target))
+          {
+            std::vector<uint8_t> img_target_data(targets.begin(),
+                                                 targets.end());
+            bw_target = cv::Mat(img_target_data, true);
+            bw_target = cv::imdecode(bw_target, CV_LOAD_IMAGE_GRAYSCALE);
+          }
       }
     else
       {
@@ -333,6 +396,14 @@ namespace dd
           _dbCursor = _dbData->NewCursor();
 
         data_size = _dbData->Count() / 2;
+
+        if (_db_shuffle_buffer > 0)
+          {
+            _db_stream.reset();
+            _db_stream = std::make_shared<TorchDbStream>(
+                _dbData, _db_shuffle_buffer, _db_stream_chunk, _shuffle);
+            _db_stream->start(_rng());
+          }
       }
 
     _indices.resize(data_size);
@@ -597,84 +668,99 @@ namespace dd
       {
         bool has_data = false;
 
-        while (count > 0)
-          {
-            std::stringstream data_key;
-            std::stringstream target_key;
-
-            std::string targets;
-            std::string datas;
+        // all data and targets for one example
+        auto add_db_example = [&](const std::string &datas,
+                                  const std::string &targets) {
+          std::vector<torch::Tensor> d;
+          std::vector<torch::Tensor> t;
 
+          if (!_image)
             {
-              std::lock_guard<std::mutex> guard(_mutex);
-
-              if (_indices.empty())
-                // end of the dataset
-                break;
+              std::stringstream datastream(datas);
+              std::stringstream targetstream(targets);
+              torch::load(d, datastream);
+              torch::load(t, targetstream);
 
-              if (!_dbCursor->valid())
+              for (unsigned int i = 0; i < d.size(); ++i)
                 {
-                  delete _dbCursor;
-                  _dbCursor = _dbData->NewCursor();
+                  while (i >= data.size())
+                    data.emplace_back();
+                  data.at(i).push_back(d[i]);
                 }
-              std::string key = _dbCursor->key();
-              size_t pos = key.find("_data");
-              if (pos != std::string::npos)
+              for (unsigned int i = 0; i < t.size(); ++i)
                 {
-                  data_key << key;
-                  std::string sid = key.substr(0, pos);
-                  target_key << sid << "_target";
+                  while (i >= target.size())
+                    target.emplace_back();
+                  target.at(i).push_back(t[i]);
                 }
-              else // skip targets
-                {
-                  _dbCursor->Next();
-                  continue;
-                }
-              _dbData->Get(data_key.str(), datas);
-              _dbData->Get(target_key.str(), targets);
-              _dbCursor->Next();
-
-              --count;
-              _indices.pop_back();
-              has_data = true;
             }
+          else
+            {
+              ImgTorchInputFileConn *inputc
+                  = dynamic_cast<ImgTorchInputFileConn *>(_inputc);
 
-            // all data for one example
-            std::vector<torch::Tensor> d;
-            // all targets for one example
-            std::vector<torch::Tensor> t;
+              cv::Mat bgr, bw_target;
+              read_image_from_db(datas, targets, bgr, t, bw_target,
+                                 inputc->_bw, inputc->width(),
+                                 inputc->height());
 
-            if (!_image)
-              {
-                std::stringstream datastream(datas);
-                std::stringstream targetstream(targets);
-                torch::load(d, datastream);
-                torch::load(t, targetstream);
+              dataaug_then_push_back(bgr, t, bw_target, data, target);
+            }
+        };
 
-                for (unsigned int i = 0; i < d.size(); ++i)
-                  {
-                    while (i >= data.size())
-                      data.emplace_back();
-                    data.at(i).push_back(d[i]);
-                  }
-                for (unsigned int i = 0; i < t.size(); ++i)
-                  {
-                    while (i >= target.size())
-                      target.emplace_back();
-                    target.at(i).push_back(t[i]);
-                  }
-              }
-            else
+        if (_db_stream)
+          {
+            // the whole batch is drawn at once from the shuffle buffer
+            std::vector<TorchDbStream::Record> records;
+            has_data = _db_stream->pop(count, records) > 0;
+            for (const TorchDbStream::Record &record : records)
+              add_db_example(record.first, record.second);
+          }
+        else
+          {
+            while (count > 0)
               {
-                ImgTorchInputFileConn *inputc
-                    = dynamic_cast<ImgTorchInputFileConn *>(_inputc);
+                std::stringstream data_key;
+                std::stringstream target_key;
+
+                std::string targets;
+                std::string datas;
 
-                cv::Mat bgr, bw_target;
-                read_image_from_db(datas, targets, bgr, t, bw_target,
-                                   inputc->_bw, inputc->width(),
-                                   inputc->height());
+                {
+                  std::lock_guard<std::mutex> guard(_mutex);
+
+                  if (_indices.empty())
+                    // end of the dataset
+                    break;
+
+                  if (!_dbCursor->valid())
+                    {
+                      delete _dbCursor;
+                      _dbCursor = _dbData->NewCursor();
+                    }
+                  std::string key = _dbCursor->key();
+                  size_t pos = key.find("_data");
+                  if (pos != std::string::npos)
+                    {
+                      data_key << key;
+                      std::string sid = key.substr(0, pos);
+                      target_key << sid << "_target";
+                    }
+                  else // skip targets
+                    {
+                      _dbCursor->Next();
+                      continue;
+                    }
+                  _dbData->Get(data_key.str(), datas);
+                  _dbData->Get(target_key.str(), targets);
+                  _dbCursor->Next();
 
-                dataaug_then_push_back(bgr, t, bw_target, data, target);
+                  --count;
+                  _indices.pop_back();
+                  has_data = true;
+                }
+
+                add_db_example(datas, targets);
               }
           }
 
@@ -987,50 +1073,112 @@ namespace dd
     return 0;
   }
 
+  /** Writes out = in * a + b for each output channel, from interleaved
+   * uint8 rows into CHW planes. A single input channel fills all output
+   * channels. Rows are addressed one by one so that views into a larger
+   * image need no copy. */
+  template <typename T>
+  static void normalize_image(const cv::Mat &img, T *dst,
+                              const int &nchannels, const float *a,
+                              const float *b)
+  {
+    const int in_channels = img.channels();
+    const int cols = img.cols;
+    const int64_t plane = static_cast<int64_t>(img.rows) * cols;
+
+    // runs serially when called from a parallel region
+#pragma omp parallel for if (plane >= 65536)
+    for (int r = 0; r < img.rows; ++r)
+      {
+        const uint8_t *row = img.ptr<uint8_t>(r);
+        for (int c = 0; c < nchannels; ++c)
+          {
+            const uint8_t *src = row + (in_channels == 1 ? 0 : c);
+            T *out = dst + c * plane + static_cast<int64_t>(r) * cols;
+            const float ac = a[c];
+            const float bc = b[c];
+#pragma omp simd
+            for (int x = 0; x < cols; ++x)
+              out[x] = static_cast<T>(src[x * in_channels] * ac + bc);
+          }
+      }
+  }
+
+  int TorchDataset::image_tensor_channels(const cv::Mat &bgr,
+                                          const bool &target)
+  {
+    ImgTorchInputFileConn *inputc
+        = dynamic_cast<ImgTorchInputFileConn *>(_inputc);
+    if (!target && !inputc->_supports_bw && bgr.channels() == 1)
+      return 3;
+    return bgr.channels();
+  }
+
   at::Tensor TorchDataset::image_to_tensor(const cv::Mat &bgr,
                                            const bool &target)
+  {
+    at::Tensor imgt
+        = torch::empty({ image_tensor_channels(bgr, target), bgr.rows,
+                         bgr.cols },
+                       at::kFloat);
+    image_to_tensor(bgr, imgt, target);
+    return imgt;
+  }
+
+  void TorchDataset::image_to_tensor(const cv::Mat &bgr, at::Tensor &dst,
+                                     const bool &target)
   {
     ImgTorchInputFileConn *inputc
         = dynamic_cast<ImgTorchInputFileConn *>(_inputc);
 
-    std::vector<int64_t> sizes{ bgr.rows, bgr.cols, bgr.channels() };
-    at::TensorOptions options(at::ScalarType::Byte);
+    if (bgr.depth() != CV_8U)
+      throw InputConnectorBadParamException(
+          "image to tensor: expected 8-bit image");
+    size_t nchannels = image_tensor_channels(bgr, target);
+    if (!dst.is_contiguous() || dst.dim() != 3
+        || dst.size(0) != static_cast<int64_t>(nchannels)
+        || dst.size(1) != bgr.rows || dst.size(2) != bgr.cols)
+      throw InputConnectorInternalException(
+          "image to tensor: destination tensor does not match image size");
 
-    at::Tensor imgt = torch::from_blob(bgr.data, at::IntList(sizes), options);
-    imgt = imgt.toType(at::kFloat).permute({ 2, 0, 1 });
-    size_t nchannels = imgt.size(0);
+    // (x * scale - mean) / std == x * a + b
+    std::vector<float> a(nchannels, 1.0);
+    std::vector<float> b(nchannels, 0.0);
 
     if (!target)
       {
-        if (!inputc->_supports_bw && nchannels == 1)
-          {
-            this->_logger->warn("Model needs 3 input channel, input will be "
-                                "duplicated to fit the model input format");
-            imgt = imgt.repeat({ 3, 1, 1 });
-            nchannels = 3;
-          }
-
-        if (inputc->_scale != 1.0)
-          imgt = imgt.mul(inputc->_scale);
+        if (nchannels != static_cast<size_t>(bgr.channels()))
+          this->_logger->warn("Model needs 3 input channel, input will be "
+                              "duplicated to fit the model input format");
 
         if (!inputc->_mean.empty() && inputc->_mean.size() != nchannels)
           throw InputConnectorBadParamException(
               "mean vector be of size the number of channels ("
               + std::to_string(nchannels) + ")");
 
-        for (size_t m = 0; m < inputc->_mean.size(); m++)
-          imgt[m] = imgt[m].sub_(inputc->_mean.at(m));
-
         if (!inputc->_std.empty() && inputc->_std.size() != nchannels)
           throw InputConnectorBadParamException(
               "std vector be of size the number of channels ("
               + std::to_string(nchannels) + ")");
 
-        for (size_t s = 0; s < inputc->_std.size(); s++)
-          imgt[s] = imgt[s].div_(inputc->_std.at(s));
+        for (size_t c = 0; c < nchannels; ++c)
+          {
+            float mean = inputc->_mean.empty() ? 0.0 : inputc->_mean.at(c);
+            float sd = inputc->_std.empty() ? 1.0 : inputc->_std.at(c);
+            a[c] = inputc->_scale / sd;
+            b[c] = -mean / sd;
+          }
       }
 
-    return imgt;
+    if (dst.scalar_type() == at::kFloat)
+      normalize_image(bgr, dst.data_ptr<float>(), nchannels, a.data(),
+                      b.data());
+    else if (dst.scalar_type() == at::kHalf)
+      normalize_image(bgr, dst.data_ptr<at::Half>(), nchannels, a.data(),
+                      b.data());
+    else
+      throw InputConnectorInternalException(
+          "image to tensor: destination tensor must be float or half");
   }
 
   at::Tensor TorchDataset::target_to_tensor(const int &target)
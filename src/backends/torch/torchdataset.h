@@ -34,6 +34,7 @@
 
 #include "inputconnectorstrategy.h"
 #include "torchdataaug.h"
+#include "torchdbstream.h"
 #include "torchutils.h"
 
 #include <opencv2/opencv.hpp>
@@ -67,6 +68,9 @@ namespace dd
         = 10; /**< number of batches per db transaction */
     std::shared_ptr<db::Transaction> _txn;   /**< db transaction pointer */
     std::shared_ptr<spdlog::logger> _logger; /**< dd logger */
+    std::shared_ptr<TorchDbStream>
+        _db_stream; /**< db streaming reads, if any */
+    size_t _db_stream_chunk = 256; /**< db records read in a row */
 
     std::mutex _mutex; /**< lock to keep the dataset synchronized */
     void dataaug_then_push_back(const cv::Mat &bgr,
@@ -98,6 +102,9 @@ namespace dd
     bool _bbox = false;                 /**< true if bbox detection dataset. */
     bool _segmentation = false;         /**< true if segmentation dataset. */
     bool _test = false;                 /**< whether a test set */
+    bool _db_raw = false; /**< whether db images are stored decoded. */
+    size_t _db_shuffle_buffer
+        = 0; /**< db streaming shuffle buffer size, 0 for cursor reads. */
     TorchImgRandAugCV _img_rand_aug_cv; /**< image data augmentation policy. */
 
     /**
@@ -120,6 +127,7 @@ namespace dd
           _dbFullName(d._dbFullName), _inputc(d._inputc),
           _classification(d._classification), _image(d._image), _bbox(d._bbox),
           _segmentation(d._segmentation), _test(d._test),
+          _db_raw(d._db_raw), _db_shuffle_buffer(d._db_shuffle_buffer),
           _img_rand_aug_cv(d._img_rand_aug_cv)
     {
     }
@@ -354,6 +362,23 @@ namespace dd
      */
     at::Tensor image_to_tensor(const cv::Mat &bgr, const bool &target = false);
 
+    /**
+     * \brief turns an uint8 image into a preallocated CHW tensor, e.g. a
+     *        batch slot, applying scale, mean and std in a single pass
+     * \param bgr input image, may be a view into a larger image
+     * \param dst contiguous float or half tensor of size
+     *        (channels, rows, cols)
+     * \param target whether the image is a label/target, targets are not
+     *        normalized
+     */
+    void image_to_tensor(const cv::Mat &bgr, at::Tensor &dst,
+                         const bool &target = false);
+
+    /**
+     * \brief number of channels of the tensor built from an image
+     */
+    int image_tensor_channels(const cv::Mat &bgr, const bool &target = false);
+
     /**
      * \brief turns an int into a torch::Tensor
      */
@@ -364,6 +389,32 @@ namespace dd
      */
     at::Tensor target_to_tensor(const std::vector<double> &target);
 
+    /**
+     * \brief serializes an uint8 image as raw pixels: a header holding
+     *        the image shape, followed by the pixel rows
+     * \param img input image
+     * \param out serialized image
+     */
+    static void image_to_raw(const cv::Mat &img, std::string &out);
+
+    /**
+     * \brief deserializes an image written with image_to_raw
+     * \param raw serialized image
+     * \param img output image
+     * \return false if raw is not a raw image, e.g. an encoded one
+     */
+    static bool raw_to_image(const std::string &raw, cv::Mat &img);
+
+    /**
+     * \brief reads an encoded or raw image from db along with its target,
+     *        an image for segmentation, tensors otherwise
+     */
+    void read_image_from_db(const std::string &datas,
+                            const std::string &targets, cv::Mat &bgr,
+                            std::vector<torch::Tensor> &targett,
+                            cv::Mat &bw_target, const bool &bw,
+                            const int &width, const int &height);
+
   private:
     /**
      * \brief converts and write data to db
@@ -395,15 +446,6 @@ namespace dd
     void write_image_to_db(const std::ostringstream &dstream,
                            const std::ostringstream &tstream,
                            const int &height, const int &width);
-
-    /**
-     * \brief reads an encoded image from db along with its tensor target
-     */
-    void read_image_from_db(const std::string &datas,
-                            const std::string &targets, cv::Mat &bgr,
-                            std::vector<torch::Tensor> &targett,
-                            cv::Mat &bw_target, const bool &bw,
-                            const int &width, const int &height);
   };
 
   /**
@@ -424,8 +466,8 @@ namespace dd
         : _inputc(d._inputc), _image(d._image), _bbox(d._bbox),
           _classification(d._classification), _segmentation(d._segmentation),
           _dbFullNames(d._dbFullNames), _datasets_names(d._datasets_names),
-          _test(d._test), _db(d._db), _backend(d._backend),
-          _dbPrefix(d._dbPrefix), _logger(d._logger),
+          _test(d._test), _db_raw(d._db_raw), _db(d._db),
+          _backend(d._backend), _dbPrefix(d._dbPrefix), _logger(d._logger),
           _batches_per_transaction(d._batches_per_transaction),
           _datasets(d._datasets)
     {
@@ -594,6 +636,7 @@ namespace dd
       _datasets[id]._segmentation = _segmentation;
       _datasets[id]._test = _test;
       _datasets[id]._classification = _classification;
+      _datasets[id]._db_raw = _db_raw;
       _datasets[id].set_db_params(_db, _backend,
                                   _dbPrefix + "_" + std::to_string(id));
       _datasets[id].set_logger(_logger);
@@ -609,7 +652,8 @@ namespace dd
     bool _segmentation = false;  /**< whether a segmentation dataset. */
     std::vector<std::string> _dbFullNames;
     std::vector<std::string> _datasets_names;
-    bool _test = false; /**< whether a test set */
+    bool _test = false;   /**< whether a test set */
+    bool _db_raw = false; /**< whether db images are stored decoded. */
 
   protected:
     bool _db = false;
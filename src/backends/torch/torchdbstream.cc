@@ -0,0 +1,166 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "torchdbstream.h"
+
+#include <algorithm>
+
+namespace dd
+{
+  TorchDbStream::TorchDbStream(const std::shared_ptr<db::DB> &db,
+                               const size_t &buffer_size,
+                               const size_t &chunk_size, const bool &shuffle)
+      : _db(db), _buffer_size(std::max(buffer_size, size_t(1))),
+        _chunk_size(std::max(chunk_size, size_t(1))), _shuffle(shuffle)
+  {
+  }
+
+  TorchDbStream::~TorchDbStream()
+  {
+    stop();
+  }
+
+  void TorchDbStream::stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _cv.notify_all();
+    if (_reader.joinable())
+      _reader.join();
+  }
+
+  void TorchDbStream::start(const unsigned int &seed)
+  {
+    stop();
+    _buffer.clear();
+    _eof = false;
+    _stop = false;
+    _error = nullptr;
+    _rng.seed(seed);
+    _reader = std::thread([this]() { read_loop(); });
+  }
+
+  bool TorchDbStream::push(std::vector<Record> &chunk)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock,
+             [this]() { return _stop || _buffer.size() < _buffer_size; });
+    if (_stop)
+      return false;
+    std::move(chunk.begin(), chunk.end(), std::back_inserter(_buffer));
+    chunk.clear();
+    lock.unlock();
+    _cv.notify_all();
+    return true;
+  }
+
+  void TorchDbStream::read_loop()
+  {
+    try
+      {
+        std::unique_ptr<db::Cursor> cursor(_db->NewCursor());
+        std::vector<Record> chunk;
+        chunk.reserve(_chunk_size);
+
+        // keys of an example are consecutive in key order, "<id>_data"
+        // followed by "<id>_target"
+        while (cursor->valid())
+          {
+            std::string key = cursor->key();
+            size_t pos = key.find("_data");
+            if (pos == std::string::npos)
+              {
+                cursor->Next();
+                continue;
+              }
+            Record record;
+            record.first = cursor->value();
+            cursor->Next();
+            std::string target_key = key.substr(0, pos) + "_target";
+            if (cursor->valid() && cursor->key() == target_key)
+              {
+                record.second = cursor->value();
+                cursor->Next();
+              }
+            else
+              _db->Get(target_key, record.second);
+            chunk.push_back(std::move(record));
+
+            if (chunk.size() >= _chunk_size && !push(chunk))
+              return;
+          }
+        if (!chunk.empty() && !push(chunk))
+          return;
+      }
+    catch (...)
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _error = std::current_exception();
+      }
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _eof = true;
+    }
+    _cv.notify_all();
+  }
+
+  size_t TorchDbStream::pop(const size_t &n, std::vector<Record> &records)
+  {
+    // when shuffling, records are only drawn from a full buffer
+    const size_t min_fill = _shuffle ? _buffer_size : 1;
+    size_t count = 0;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (count < n)
+      {
+        _cv.wait(lock, [this, min_fill]() {
+          return _stop || _eof || _error || _buffer.size() >= min_fill;
+        });
+        if (_error)
+          std::rethrow_exception(_error);
+        if (_stop || _buffer.empty())
+          break;
+
+        size_t k = std::min(n - count, _buffer.size());
+        for (size_t i = 0; i < k; ++i)
+          {
+            if (_shuffle)
+              {
+                std::uniform_int_distribution<size_t> pick(
+                    0, _buffer.size() - 1);
+                std::swap(_buffer[pick(_rng)], _buffer.back());
+                records.push_back(std::move(_buffer.back()));
+                _buffer.pop_back();
+              }
+            else
+              {
+                records.push_back(std::move(_buffer.front()));
+                _buffer.pop_front();
+              }
+          }
+        count += k;
+        _cv.notify_all();
+      }
+    return count;
+  }
+}
@@ -0,0 +1,112 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TORCH_DB_STREAM_H
+#define TORCH_DB_STREAM_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "utils/db.hpp"
+
+namespace dd
+{
+  /**
+   * \brief streaming reads of a training db through a shuffle buffer.
+   *        A reader thread walks the db in key order and appends chunks
+   *        of records to the buffer while it is not full. Consumers draw
+   *        whole batches of records at random from the buffer, so that
+   *        the buffer size controls the shuffling quality and the memory
+   *        footprint, whatever the db size.
+   */
+  class TorchDbStream
+  {
+  public:
+    /** (data, target) serialized values of a db example */
+    typedef std::pair<std::string, std::string> Record;
+
+    /**
+     * \brief stream creation, no reading before start()
+     * @param db opened db, with "<id>_data" and "<id>_target" keys
+     * @param buffer_size number of records in the shuffle buffer
+     * @param chunk_size number of records read in a row by the reader
+     * @param shuffle whether to draw records at random, records are
+     *        returned in db order otherwise
+     */
+    TorchDbStream(const std::shared_ptr<db::DB> &db, const size_t &buffer_size,
+                  const size_t &chunk_size, const bool &shuffle);
+
+    /** Stops the reader thread. */
+    ~TorchDbStream();
+
+    /**
+     * \brief starts a new pass over the db, e.g. a new epoch, drops the
+     *        records buffered from the previous pass
+     * @param seed shuffling seed of the pass
+     */
+    void start(const unsigned int &seed);
+
+    /**
+     * \brief draws records from the buffer, blocks until enough records
+     *        are buffered or the end of the pass is reached
+     * @param n number of records
+     * @param records drawn records are appended there
+     * @return number of drawn records, lower than n only at the end of
+     *         the pass
+     */
+    size_t pop(const size_t &n, std::vector<Record> &records);
+
+  private:
+    /** Reader thread main loop. */
+    void read_loop();
+
+    /**
+     * \brief moves a chunk to the buffer, waits for room in the buffer
+     * @return false if the stream is stopping
+     */
+    bool push(std::vector<Record> &chunk);
+
+    /** Stops and joins the reader thread. */
+    void stop();
+
+    std::shared_ptr<db::DB> _db;
+    size_t _buffer_size; /**< shuffle buffer size, in records. */
+    size_t _chunk_size;  /**< records read in a row. */
+    bool _shuffle;
+    std::mt19937 _rng;
+
+    std::deque<Record> _buffer;
+    bool _eof = false;  /**< whether the reader reached the end of the db. */
+    bool _stop = false; /**< whether the reader must stop. */
+    std::exception_ptr _error; /**< reader error, rethrown by pop(). */
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::thread _reader;
+  };
+}
+
+#endif
@@ -286,12 +286,32 @@ namespace dd
         // XXX: No predict from db yet
         _dataset.set_db_params(false, "", "");
 
+        for (size_t i = 0; i < this->_images.size(); ++i)
+          _imgs_size.insert(std::pair<std::string, std::pair<int, int>>(
+              this->_ids.at(i), this->_images_size.at(i)));
+
+        // images are converted in parallel, the dataset stacks them into
+        // batches
+        std::vector<at::Tensor> imgts(this->_images.size());
+        std::vector<std::exception_ptr> eptrs(this->_images.size());
+#pragma omp parallel for schedule(dynamic)
         for (size_t i = 0; i < this->_images.size(); ++i)
           {
-            _imgs_size.insert(std::pair<std::string, std::pair<int, int>>(
-                this->_ids.at(i), this->_images_size.at(i)));
-            _dataset.add_batch({ _dataset.image_to_tensor(this->_images[i]) });
+            try
+              {
+                imgts[i] = _dataset.image_to_tensor(this->_images[i]);
+              }
+            catch (...)
+              {
+                eptrs[i] = std::current_exception();
+              }
           }
+        for (const std::exception_ptr &eptr : eptrs)
+          if (eptr)
+            std::rethrow_exception(eptr);
+
+        for (const at::Tensor &imgt : imgts)
+          _dataset.add_batch({ imgt });
       }
     else // if (!_train)
       {
@@ -716,6 +736,11 @@ namespace dd
   {
     _ndbed = 0;
     TxtInputFileConn::parse_content(content, target, test_id);
+    entries_parsed(test_id);
+  }
+
+  void TxtTorchInputFileConn::entries_parsed(int test_id)
+  {
     if (_db)
       push_to_db(test_id);
   }
@@ -899,6 +924,25 @@ namespace dd
         std::string word;
         double val;
         std::vector<int64_t> ids;
+        int64_t last_token = 0; // needed by gpt2
+
+        if (!tow->_ids.empty())
+          {
+            // wordpiece tokens are vocabulary positions already
+            for (int id : tow->_ids)
+              {
+                if (ids.size() >= _width)
+                  {
+                    if (id >= 0)
+                      last_token = id;
+                    break;
+                  }
+                if (id >= 0)
+                  ids.push_back(id);
+                else if (_input_format == "bert")
+                  ids.push_back(_unk_pos);
+              }
+          }
 
         while (tow->has_elt())
           {
@@ -918,8 +962,7 @@ namespace dd
               }
           }
 
-        // Extract last token (needed by gpt2)
-        int64_t last_token = 0;
+        // Extract last token
         if (tow->has_elt())
           {
             tow->get_next_elt(word, val);
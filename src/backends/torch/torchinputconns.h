@@ -112,6 +112,14 @@ namespace dd
         _dataset.set_shuffle(ad_in.get("shuffle").get<bool>());
       if (ad_in.has("db"))
         _db = ad_in.get("db").get<bool>();
+      if (ad_in.has("db_raw"))
+        {
+          _dataset._db_raw = ad_in.get("db_raw").get<bool>();
+          _test_datasets._db_raw = _dataset._db_raw;
+        }
+      if (ad_in.has("db_shuffle_buffer"))
+        _dataset._db_shuffle_buffer
+            = std::max(0, ad_in.get("db_shuffle_buffer").get<int>());
       _dataset.set_db_params(_db, _backend, model_repo + "/train");
       _dataset.set_logger(logger);
       _test_datasets.set_db_params(_db, _backend, model_repo + "/test");
@@ -181,6 +189,14 @@ namespace dd
       return "";
     }
 
+    /**
+     * \brief holder token id accessor for txtinputconn
+     */
+    int64_t get_word_id(__attribute__((unused)) const std::string &word) const
+    {
+      return -1;
+    }
+
     /**
      * \brief get first input for exploration (size ...)
      */
@@ -472,6 +488,15 @@ namespace dd
       return _inv_vocab.at(id);
     }
 
+    /**
+     * \brief get token id given token, -1 if not in vocabulary
+     */
+    int64_t get_word_id(const std::string &word) const
+    {
+      auto it = _vocab.find(word);
+      return it == _vocab.end() ? -1 : it->second._pos;
+    }
+
     /**
      * \brief read data wrt APIdata
      */
@@ -505,6 +530,11 @@ namespace dd
     void parse_content(const std::string &content, const float &target = -1,
                        int test_id = -1) override;
 
+    /**
+     * \brief puts data from a directory into db on the fly if needed
+     */
+    void entries_parsed(int test_id) override;
+
   private:
     /**
      * push read data to db
@@ -30,6 +30,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <unordered_set>
 
 #include "native/native.h"
 #include "torchsolver.h"
@@ -38,6 +39,7 @@
 
 #include "dto/mllib.hpp"
 #include "utils/bbox.hpp"
+#include "utils/cv_utils.hpp"
 
 using namespace torch;
 
@@ -83,6 +85,7 @@ namespace dd
     _loss = tl._loss;
     _template_params = tl._template_params;
     _dtype = tl._dtype;
+    _prefetcher = tl._prefetcher;
   }
 
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
@@ -1368,6 +1371,222 @@ namespace dd
     return 0;
   }
 
+  /** GPT-2 byte-level BPE tokens to text: each token character stands for
+   * a byte, printable bytes for themselves and other bytes for code points
+   * from 256 on, in byte order. */
+  static std::string gpt2_decode(const std::vector<std::string> &tokens)
+  {
+    static const std::vector<int> cp_to_byte = []() {
+      std::vector<int> table(512, -1);
+      int n = 0;
+      for (int b = 0; b < 256; ++b)
+        {
+          bool printable = (b >= 33 && b <= 126) || (b >= 161 && b <= 172)
+                           || b >= 174;
+          table[printable ? b : 256 + n++] = b;
+        }
+      return table;
+    }();
+
+    std::string text;
+    for (const std::string &token : tokens)
+      {
+        size_t i = 0;
+        while (i < token.size())
+          {
+            unsigned char c = token[i];
+            size_t len = 1;
+            if ((c >> 5) == 6)
+              len = 2;
+            else if ((c >> 4) == 14)
+              len = 3;
+            else if ((c >> 3) == 30)
+              len = 4;
+            len = std::min(len, token.size() - i);
+            uint32_t cp = len == 1 ? c : c & (0x7f >> len);
+            for (size_t k = 1; k < len; ++k)
+              cp = (cp << 6) | (token[i + k] & 0x3f);
+            if (cp < cp_to_byte.size() && cp_to_byte[cp] >= 0)
+              text.push_back(static_cast<char>(cp_to_byte[cp]));
+            else
+              text.append(token, i, len);
+            i += len;
+          }
+      }
+    return text;
+  }
+
+  /** Segmentation map resized to the input image size and encoded as
+   * "rle" runs or as a base64 "png" image. */
+  static APIData encode_mask(const cv::Mat &mask, const std::string &format,
+                             const int &height, const int &width,
+                             const bool &nearest)
+  {
+    cv::Mat resized = mask;
+    if (mask.rows != height || mask.cols != width)
+      cv::resize(mask, resized, cv::Size(width, height), 0, 0,
+                 nearest ? cv::INTER_NEAREST : cv::INTER_LINEAR);
+
+    APIData ad_mask;
+    ad_mask.add("format", format);
+    ad_mask.add("height", height);
+    ad_mask.add("width", width);
+    if (format == "png")
+      {
+        cv::Mat img = resized;
+        if (resized.type() == CV_32SC1)
+          resized.convertTo(img, CV_16UC1);
+        ad_mask.add("data", cv_utils::image_to_base64(img, ".png"));
+      }
+    else
+      {
+        std::vector<int> values, counts;
+        cv_utils::mask_to_rle(resized, values, counts);
+        ad_mask.add("values", values);
+        ad_mask.add("counts", counts);
+      }
+    return ad_mask;
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
+            class TMLModel>
+  void TorchLib<TInputConnectorStrategy, TOutputConnectorStrategy, TMLModel>::
+      generate(TInputConnectorStrategy &inputc,
+               const oatpp::Object<DTO::Generate> &params,
+               std::vector<APIData> &results_ads)
+  {
+    if (_template != "gpt2" || !_module._traced)
+      throw MLLibBadParamException(
+          "text generation requires a traced gpt2 model");
+
+    int max_tokens = params->max_tokens;
+    int top_k = params->top_k;
+    float temperature = params->temperature;
+    int64_t eot = inputc.get_word_id("<|endoftext|>");
+    std::unordered_set<int64_t> stop_ids;
+    if (eot >= 0)
+      stop_ids.insert(eot);
+    for (const oatpp::String &stop : *params->stop)
+      {
+        int64_t id = inputc.get_word_id(stop);
+        if (id < 0)
+          throw MLLibBadParamException("unknown stop token " + *stop);
+        stop_ids.insert(id);
+      }
+    std::mt19937 rng(params->seed >= 0 ? params->seed
+                                       : std::random_device()());
+
+    // models traced with past keys and values as input run one token per
+    // step, others run the whole sequence at each step
+    auto forward_past = _module._traced->find_method("forward_past");
+    if (!forward_past)
+      this->_logger->warn("no forward_past method in traced model, past "
+                          "keys and values are recomputed at each step");
+
+    torch::NoGradGuard no_grad;
+    torch::Device cpu("cpu");
+    TorchDataset &dataset = inputc._dataset;
+
+    for (size_t i = 0; i < dataset._batches.size(); ++i)
+      {
+        // sequences are padded to the model width, with an end of text
+        // token after the prompt
+        Tensor padded = dataset._batches.at(i).data.at(0).to(cpu);
+        int64_t width = padded.size(0);
+        int64_t *ids = padded.data_ptr<int64_t>();
+        std::vector<int64_t> tokens(ids, ids + inputc._lengths.at(i));
+        if (!tokens.empty() && tokens.back() == eot)
+          tokens.pop_back();
+        if (tokens.empty())
+          {
+            if (eot < 0)
+              throw MLLibBadParamException("empty prompt");
+            tokens.push_back(eot);
+          }
+        size_t prompt_len = tokens.size();
+
+        std::vector<std::string> words;
+        double prob = 1.0;
+        Tensor past;
+        while (tokens.size() - prompt_len < static_cast<size_t>(max_tokens)
+               && static_cast<int64_t>(tokens.size()) < width)
+          {
+            Tensor logits;
+            try
+              {
+                std::vector<c10::IValue> out;
+                int64_t ntokens = tokens.size();
+                if (forward_past && past.defined())
+                  {
+                    // last token only
+                    Tensor in_ids
+                        = torch::full({ 1, 1 }, tokens.back(), at::kLong);
+                    Tensor pos
+                        = torch::full({ 1, 1 }, ntokens - 1, at::kLong);
+                    out = torch_utils::unwrap_c10_vector((*forward_past)(
+                        { in_ids.to(_main_device), pos.to(_main_device),
+                          past }));
+                  }
+                else
+                  {
+                    // whole sequence, padded to the model width unless
+                    // past keys and values are kept
+                    int64_t len = forward_past ? ntokens : width;
+                    Tensor in_ids = torch::zeros({ 1, len }, at::kLong);
+                    std::copy(tokens.begin(), tokens.end(),
+                              in_ids.data_ptr<int64_t>());
+                    Tensor pos = torch::arange(len, at::kLong).unsqueeze(0);
+                    out = torch_utils::unwrap_c10_vector(
+                        _module._traced->forward({ in_ids.to(_main_device),
+                                                   pos.to(_main_device) }));
+                  }
+                logits = torch_utils::to_tensor_safe(out.at(0))[0]
+                                                               [ntokens - 1];
+                if (forward_past)
+                  past = out.at(1).toTensor();
+              }
+            catch (std::exception &e)
+              {
+                throw MLLibInternalException(std::string("Libtorch error:")
+                                             + e.what());
+              }
+            this->_stats.inc_inference_count(1);
+
+            // top-k sampling
+            logits = logits.to(cpu).to(torch::kFloat);
+            int k = top_k > 0 ? std::min<int64_t>(top_k, logits.size(0))
+                              : logits.size(0);
+            if (temperature <= 0)
+              k = 1;
+            else
+              logits = logits / temperature;
+            std::tuple<Tensor, Tensor> topk = logits.topk(k);
+            Tensor probs = torch::softmax(std::get<0>(topk), 0);
+            std::vector<double> weights(probs.data_ptr<float>(),
+                                        probs.data_ptr<float>() + k);
+            std::discrete_distribution<int> pick(weights.begin(),
+                                                 weights.end());
+            int j = pick(rng);
+            int64_t next = std::get<1>(topk)[j].item<int64_t>();
+            if (stop_ids.count(next))
+              break;
+
+            prob *= weights[j];
+            tokens.push_back(next);
+            words.push_back(inputc.get_word(next));
+          }
+
+        APIData results_ad;
+        results_ad.add("uri", inputc._uris.at(results_ads.size()));
+        results_ad.add("loss", 0.0);
+        results_ad.add("cats",
+                       std::vector<std::string>{ gpt2_decode(words) });
+        results_ad.add("probs", std::vector<double>{ prob });
+        results_ad.add("nclasses", (int)_nclasses);
+        results_ads.push_back(results_ad);
+      }
+  }
+
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy,
             class TMLModel>
   oatpp::Object<DTO::PredictBody>
@@ -1460,6 +1679,16 @@ namespace dd
           confidences.push_back(conf);
       }
 
+    std::string mask_format = output_params->mask_format;
+    if (!mask_format.empty() && mask_format != "rle" && mask_format != "png")
+      throw MLLibBadParamException("unknown mask_format " + mask_format
+                                   + ", expected rle or png");
+    if (!mask_format.empty()
+        && (confidences.size() > 1
+            || (confidences.size() == 1 && confidences[0] != "best")))
+      throw MLLibBadParamException(
+          "mask_format only encodes the \"best\" confidence map");
+
     bool lstm_continuation = input_params->continuation;
     TInputConnectorStrategy inputc(this->_inputc);
 
@@ -1520,25 +1749,66 @@ namespace dd
 
     inputc._dataset.reset(false);
 
+    // generation runs its own forward loop
+    bool generating = mllib_params->generate != nullptr;
+
     int batch_size = predict_batch_size;
     if (lstm_continuation)
       batch_size = 1;
 
-    auto dataloader = torch::data::make_data_loader(
-        std::move(inputc._dataset), data::DataLoaderOptions(batch_size));
+    // batches are read and moved to device ahead of the forward pass
+    int prefetch_batches = mllib_params->net->prefetch_batches;
+    bool pinned = prefetch_batches > 0 && _main_device.is_cuda();
+    TorchDataset &dataset = inputc._dataset;
+    auto next_batch = [&dataset, batch_size]() {
+      return dataset.get_batch({ static_cast<size_t>(batch_size) });
+    };
+    torch::Dtype dtype = _dtype;
+    torch::Device device = _main_device;
+    auto prepare_batch = [dtype, device, pinned](TorchBatch &batch) {
+      for (Tensor &tensor : batch.data)
+        {
+          if (tensor.scalar_type() == torch::kFloat32)
+            tensor = tensor.to(dtype);
+          // pinned memory lets the host to device copy run asynchronously
+          if (pinned)
+            tensor = tensor.pin_memory().to(device, tensor.scalar_type(),
+                                            /*non_blocking=*/true);
+          else
+            tensor = tensor.to(device);
+        }
+    };
+    std::unique_ptr<TorchPrefetcher::BatchesHandle> prefetched;
+    if (prefetch_batches > 0 && !generating)
+      prefetched = _prefetcher->run(next_batch, prepare_batch,
+                                    static_cast<size_t>(prefetch_batches));
 
     std::vector<APIData> results_ads;
     int nsample = 0;
 
-    for (TorchBatch batch : *dataloader)
+    if (generating)
+      generate(inputc, mllib_params->generate, results_ads);
+
+    while (!generating)
       {
-        std::vector<c10::IValue> in_vals;
-        for (Tensor tensor : batch.data)
+        TorchBatch batch;
+        if (prefetched)
+          {
+            if (!prefetched->pop(batch))
+              break;
+          }
+        else
           {
-            if (tensor.scalar_type() == torch::kFloat32)
-              tensor = tensor.to(_dtype);
-            in_vals.push_back(tensor.to(_main_device));
+            c10::optional<TorchBatch> obatch = next_batch();
+            if (!obatch)
+              break;
+            batch = std::move(obatch.value());
+            prepare_batch(batch);
           }
+
+        std::vector<c10::IValue> in_vals;
+        for (Tensor tensor : batch.data)
+          in_vals.push_back(tensor);
         this->_stats.inc_inference_count(batch.data[0].size(0));
 
         c10::IValue out_ivalue;
@@ -1805,6 +2075,71 @@ namespace dd
                     results_ads.push_back(results_ad);
                   }
               }
+            else if (_segmentation && !mask_format.empty())
+              {
+                if (out_ivalue.isGenericDict())
+                  {
+                    auto out_dict = out_ivalue.toGenericDict();
+                    output = torch_utils::to_tensor_safe(out_dict.at("out"));
+                  }
+                else
+                  output = torch_utils::to_tensor_safe(out_ivalue);
+                output = torch::softmax(output, 1);
+
+                // maps stay 8-bit or 32-bit integers from the device to
+                // the encoded output
+                std::string uri;
+                if (!inputc._ids.empty())
+                  uri = inputc._ids.at(results_ads.size());
+                else
+                  uri = std::to_string(results_ads.size());
+                auto bit = inputc._imgs_size.find(uri);
+                int height = (*bit).second.first;
+                int width = (*bit).second.second;
+
+                torch::Tensor segmap;
+                torch::Tensor confmap;
+                if (!confidences.empty()) // "best" confidence only
+                  {
+                    auto maxmap = torch::max(output.squeeze(), 0, false);
+                    confmap = std::get<0>(maxmap)
+                                  .mul(255)
+                                  .round()
+                                  .to(torch::kUInt8)
+                                  .to(cpu)
+                                  .contiguous();
+                    segmap = std::get<1>(maxmap);
+                  }
+                else
+                  segmap = torch::argmax(output.squeeze(), 0);
+                bool wide = _nclasses > 256;
+                segmap = segmap.to(wide ? torch::kInt32 : torch::kUInt8)
+                             .to(cpu)
+                             .contiguous();
+
+                APIData rad;
+                rad.add("uri", uri);
+                rad.add("loss", static_cast<double>(0.0));
+                APIData ad_imgsize;
+                ad_imgsize.add("height", height);
+                ad_imgsize.add("width", width);
+                rad.add("imgsize", ad_imgsize);
+                rad.add("vals", std::vector<double>());
+                cv::Mat segimg(inputc.height(), inputc.width(),
+                               wide ? CV_32SC1 : CV_8UC1,
+                               segmap.data_ptr());
+                rad.add("mask", encode_mask(segimg, mask_format, height,
+                                            width, true));
+                if (!confidences.empty())
+                  {
+                    cv::Mat confimg(inputc.height(), inputc.width(),
+                                    CV_8UC1, confmap.data_ptr());
+                    rad.add("mask_confidence",
+                            encode_mask(confimg, mask_format, height,
+                                        width, false));
+                  }
+                results_ads.push_back(rad);
+              }
             else if (_segmentation)
               {
                 if (out_ivalue.isGenericDict())
@@ -1945,6 +2280,7 @@ namespace dd
           }
       }
 
+    this->_stats.output_start();
     oatpp::Object<DTO::PredictBody> out_dto;
     OutputConnectorConfig conf;
     if (extract_layer.empty() && !_segmentation)
@@ -1967,6 +2303,7 @@ namespace dd
         out_dto = unsupo.finalize(output_params, conf,
                                   static_cast<MLModel *>(&this->_mlmodel));
       }
+    this->_stats.output_end();
 
     if (predict_dto->_chain)
       {
@@ -45,6 +45,8 @@
 #include "native/native_net.h"
 #include "torchmodule.h"
 #include "torchsolver.h"
+#include "torchprefetcher.h"
+#include "dto/mllib.hpp"
 
 namespace dd
 {
@@ -136,6 +138,10 @@ namespace dd
 
     torch::Dtype _dtype = torch::kFloat32;
 
+    std::shared_ptr<TorchPrefetcher> _prefetcher
+        = std::make_shared<TorchPrefetcher>(); /**< predict batches
+                                                  prefetching threads */
+
   private:
     /**
      * \brief checks wether v1 is better than v2
@@ -167,6 +173,19 @@ namespace dd
 
     /** print and update model stats */
     void compute_and_print_model_info();
+
+    /**
+     * \brief autoregressive text generation from each input sequence,
+     *        gpt2 template only. Past keys and values are reused between
+     *        steps when the traced model has a forward_past method.
+     * @param inputc input connector holding the tokenized sequences
+     * @param params generation parameters
+     * @param results_ads one result per sequence, the generated text as
+     *        single category
+     */
+    void generate(TInputConnectorStrategy &inputc,
+                  const oatpp::Object<DTO::Generate> &params,
+                  std::vector<APIData> &results_ads);
   };
 }
 
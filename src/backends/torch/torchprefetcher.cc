@@ -0,0 +1,144 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "torchprefetcher.h"
+
+#include <algorithm>
+
+namespace dd
+{
+  bool TorchPrefetcher::Batches::pop(TorchBatch &batch)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this]() { return _done || !_ready.empty(); });
+    if (_ready.empty())
+      {
+        if (_error)
+          std::rethrow_exception(_error);
+        return false;
+      }
+    batch = std::move(_ready.front());
+    _ready.pop_front();
+    _cv.notify_all();
+    return true;
+  }
+
+  void TorchPrefetcher::Batches::produce()
+  {
+    while (true)
+      {
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _cv.wait(lock,
+                   [this]() { return _cancelled || _ready.size() < _depth; });
+          if (_cancelled)
+            break;
+        }
+
+        c10::optional<TorchBatch> batch;
+        std::exception_ptr error;
+        try
+          {
+            batch = _next();
+            if (batch)
+              _prepare(batch.value());
+          }
+        catch (...)
+          {
+            error = std::current_exception();
+          }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (error || !batch)
+          {
+            _error = error;
+            break;
+          }
+        _ready.push_back(std::move(batch.value()));
+        _cv.notify_all();
+      }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _done = true;
+    _producing = false;
+    _cv.notify_all();
+  }
+
+  void TorchPrefetcher::Batches::cancel()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cancelled = true;
+    _cv.notify_all();
+    // the dataset belongs to the predict call, it must not be read anymore
+    // once the call returns
+    _cv.wait(lock, [this]() { return !_producing; });
+  }
+
+  TorchPrefetcher::TorchPrefetcher()
+  {
+  }
+
+  TorchPrefetcher::~TorchPrefetcher()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _cv.notify_all();
+    for (auto &t : _threads)
+      if (t.joinable())
+        t.join();
+  }
+
+  std::unique_ptr<TorchPrefetcher::BatchesHandle>
+  TorchPrefetcher::run(const next_fn &next, const prepare_fn &prepare,
+                       const size_t &depth)
+  {
+    auto batches = std::make_shared<Batches>(next, prepare,
+                                             std::max(depth, size_t(1)));
+    batches->_producing = true;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _jobs.push_back(batches);
+      if (_idle < _jobs.size())
+        _threads.emplace_back([this]() { worker_loop(); });
+    }
+    _cv.notify_one();
+    return std::unique_ptr<BatchesHandle>(new BatchesHandle(batches));
+  }
+
+  void TorchPrefetcher::worker_loop()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+      {
+        ++_idle;
+        _cv.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+        --_idle;
+        if (_stop)
+          break;
+        std::shared_ptr<Batches> batches = _jobs.front();
+        _jobs.pop_front();
+        lock.unlock();
+        batches->produce();
+        lock.lock();
+      }
+  }
+}
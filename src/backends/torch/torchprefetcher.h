@@ -0,0 +1,147 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TORCH_PREFETCHER_H
+#define TORCH_PREFETCHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "torchdataset.h"
+
+namespace dd
+{
+  /**
+   * \brief prefetching of predict batches: batches are assembled and moved
+   *        to device on a background thread while the previous batches go
+   *        through the model. Batches keep the dataset order.
+   *        Prefetch threads are persistent and shared by all predict calls
+   *        of a service, a new thread is only started when all others are
+   *        busy with concurrent calls.
+   */
+  class TorchPrefetcher
+  {
+  public:
+    /** returns the next batch of the dataset, or nullopt at the end */
+    typedef std::function<c10::optional<TorchBatch>()> next_fn;
+    /** prepares a batch for the forward pass, e.g. moves it to device */
+    typedef std::function<void(TorchBatch &)> prepare_fn;
+
+    /**
+     * \brief batches of a single predict call
+     */
+    class Batches
+    {
+    public:
+      Batches(const next_fn &next, const prepare_fn &prepare,
+              const size_t &depth)
+          : _next(next), _prepare(prepare), _depth(depth)
+      {
+      }
+
+      /**
+       * \brief blocks until the next batch is ready
+       * @return false when all batches have been consumed
+       */
+      bool pop(TorchBatch &batch);
+
+      /**
+       * \brief producer loop, runs on a prefetch thread
+       */
+      void produce();
+
+      /**
+       * \brief stops the producer and waits for it to release the dataset
+       */
+      void cancel();
+
+    private:
+      friend class TorchPrefetcher;
+
+      next_fn _next;
+      prepare_fn _prepare;
+      size_t _depth; /**< max number of batches ready ahead. */
+
+      std::deque<TorchBatch> _ready;
+      std::mutex _mutex;
+      std::condition_variable _cv;
+      bool _producing = false; /**< whether a thread runs the producer. */
+      bool _done = false;
+      bool _cancelled = false;
+      std::exception_ptr _error;
+    };
+
+    /**
+     * \brief RAII handle on the batches of a predict call, cancels the
+     *        producer when the call ends, including on exceptions
+     */
+    class BatchesHandle
+    {
+    public:
+      BatchesHandle(std::shared_ptr<Batches> batches) : _batches(batches)
+      {
+      }
+      ~BatchesHandle()
+      {
+        _batches->cancel();
+      }
+      bool pop(TorchBatch &batch)
+      {
+        return _batches->pop(batch);
+      }
+
+    private:
+      std::shared_ptr<Batches> _batches;
+    };
+
+    TorchPrefetcher();
+
+    /** Stops and joins prefetch threads. */
+    ~TorchPrefetcher();
+
+    /**
+     * \brief starts prefetching the batches of a predict call
+     * @param next dataset reading function
+     * @param prepare batch preparation, runs on the prefetch thread
+     * @param depth max number of batches ready ahead of the consumer
+     */
+    std::unique_ptr<BatchesHandle> run(const next_fn &next,
+                                       const prepare_fn &prepare,
+                                       const size_t &depth);
+
+  private:
+    /** Prefetch thread main loop. */
+    void worker_loop();
+
+    std::vector<std::thread> _threads;
+    std::deque<std::shared_ptr<Batches>> _jobs;
+    size_t _idle = 0; /**< number of threads waiting for a job. */
+    bool _stop = false;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+  };
+}
+
+#endif
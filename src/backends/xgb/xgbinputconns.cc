@@ -351,17 +351,17 @@ namespace dd
         long nelem = 0;
         TxtBowEntry *tbe = static_cast<TxtBowEntry *>((*hit));
         mat.info.labels_.HostVector().push_back(tbe->_target);
-        tbe->reset();
-        while (tbe->has_elt())
+        // BOW rows are already sorted by vocabulary position
+        const int *indices = tbe->indices();
+        const double *values = tbe->values();
+        for (size_t k = 0; k < tbe->size(); ++k)
           {
-            std::string key;
-            double v;
-            tbe->get_next_elt(key, v);
+            double v = values[k];
             if (xgboost::common::CheckNAN(v) && !nan_missing)
               throw InputConnectorBadParamException(
                   "NaN value in input data matrix, and missing != NaN");
             mat.page_.data.HostVector().push_back(
-                xgboost::Entry(_vocab[key]._pos, v));
+                xgboost::Entry(indices[k], v));
             ++nelem;
           }
         mat.page_.offset.HostVector().push_back(
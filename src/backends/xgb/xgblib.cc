@@ -547,9 +547,11 @@ namespace dd
         conf._regression = true;
       }
     conf._nclasses = nclasses;
+    this->_stats.output_start();
     auto out_dto
         = tout.finalize(ad.getobj("parameters").getobj("output"), conf,
                         static_cast<MLModel *>(&this->_mlmodel));
+    this->_stats.output_end();
     // out_dto->status = 0;
     return out_dto;
   }
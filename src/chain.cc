@@ -21,6 +21,12 @@
 
 #include "chain.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <future>
+
 #include "dto/predict_out.hpp"
 
 namespace dd
@@ -144,4 +150,144 @@ namespace dd
       }
     return chain_dto;
   }
+
+  void ChainGraph::add_node(Node &node)
+  {
+    std::unordered_map<std::string, int> &ids
+        = node._action ? _action_ids : _service_ids;
+    if (!ids.insert(std::make_pair(node._id, int(_nodes.size()))).second)
+      throw ChainBadParamException("Chain call id " + node._id
+                                   + " is used more than once");
+    for (int d : node._deps)
+      _nodes.at(d)._children.push_back(_nodes.size());
+    _nodes.push_back(node);
+  }
+
+  void ChainGraph::add_service(const std::string &id,
+                               const std::string &parent_id,
+                               const std::string &sname)
+  {
+    Node node;
+    node._id = id.empty() ? std::to_string(_nodes.size()) : id;
+    node._name = sname;
+    node._input_id = parent_id.empty() ? _prec_action_id : parent_id;
+    // an unknown parent is reported by the service call itself
+    auto hit = _action_ids.find(node._input_id);
+    if (hit != _action_ids.end())
+      node._deps.push_back((*hit).second);
+    add_node(node);
+    if (_first_service_id.empty())
+      _first_service_id = node._id;
+    _prec_service_id = node._id;
+  }
+
+  void ChainGraph::add_action(const std::string &id, const std::string &type)
+  {
+    Node node;
+    node._id = id.empty() ? std::to_string(_nactions) : id;
+    node._name = type;
+    node._action = true;
+    node._input_id = _prec_service_id;
+    auto hit = _service_ids.find(node._input_id);
+    if (hit != _service_ids.end())
+      node._deps.push_back((*hit).second);
+    // actions on a same output run in chain order
+    auto ahit = _last_action.find(node._input_id);
+    if (ahit != _last_action.end())
+      node._deps.push_back((*ahit).second);
+    _last_action[node._input_id] = _nodes.size();
+    add_node(node);
+    _prec_action_id = node._id;
+    ++_nactions;
+  }
+
+  void ChainGraph::run(const node_fn &fn)
+  {
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::deque<int> ready;
+    std::vector<size_t> ndeps(_nodes.size());
+    for (size_t i = 0; i < _nodes.size(); ++i)
+      {
+        ndeps[i] = _nodes[i]._deps.size();
+        if (ndeps[i] == 0)
+          ready.push_back(i);
+      }
+
+    std::chrono::steady_clock::time_point tstart
+        = std::chrono::steady_clock::now();
+    auto ms = [tstart](const std::chrono::steady_clock::time_point &t) {
+      return std::chrono::duration<double, std::milli>(t - tstart).count();
+    };
+
+    std::vector<std::future<void>> tasks;
+    std::exception_ptr error;
+    int running = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+      {
+        // no new call is started once a call has failed
+        while (!error && !ready.empty())
+          {
+            int n = ready.front();
+            ready.pop_front();
+            ++running;
+            tasks.push_back(std::async(std::launch::async, [&, n]() {
+              std::chrono::steady_clock::time_point t0
+                  = std::chrono::steady_clock::now();
+              int status = 1;
+              std::exception_ptr e;
+              try
+                {
+                  status = fn(n, _nodes[n]);
+                }
+              catch (...)
+                {
+                  e = std::current_exception();
+                }
+              std::chrono::steady_clock::time_point t1
+                  = std::chrono::steady_clock::now();
+
+              std::lock_guard<std::mutex> node_lock(mutex);
+              Node &node = _nodes[n];
+              node._start = ms(t0);
+              node._time = ms(t1) - node._start;
+              node._status = status;
+              if (e && !error)
+                error = e;
+              if (!e && status == 0)
+                for (int c : node._children)
+                  if (--ndeps[c] == 0)
+                    ready.push_back(c);
+              --running;
+              done_cv.notify_one();
+            }));
+          }
+        if (running == 0)
+          break;
+        done_cv.wait(lock);
+      }
+    lock.unlock();
+    tasks.clear();
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  oatpp::Vector<oatpp::Object<DTO::ChainCallTime>> ChainGraph::timings() const
+  {
+    auto timings
+        = oatpp::Vector<oatpp::Object<DTO::ChainCallTime>>::createShared();
+    for (const Node &node : _nodes)
+      {
+        if (node._status < 0)
+          continue;
+        auto t = DTO::ChainCallTime::createShared();
+        t->id = node._id;
+        t->name = node._name;
+        t->start = node._start;
+        t->time = node._time;
+        timings->push_back(t);
+      }
+    return timings;
+  }
 }
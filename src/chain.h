@@ -22,7 +22,12 @@
 #ifndef CHAIN_H
 #define CHAIN_H
 
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "apidata.h"
 #include "dto/chain.hpp"
@@ -67,6 +72,7 @@ namespace dd
     void add_model_data(const std::string &id,
                         const oatpp::Object<DTO::PredictBody> &out)
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string,
                          oatpp::Object<DTO::PredictBody>>::const_iterator hit;
       if ((hit = _model_data.find(id)) != _model_data.end())
@@ -76,6 +82,7 @@ namespace dd
 
     oatpp::Object<DTO::PredictBody> get_model_data(const std::string &id) const
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string,
                          oatpp::Object<DTO::PredictBody>>::const_iterator hit;
       if ((hit = _model_data.find(id)) != _model_data.end())
@@ -86,6 +93,7 @@ namespace dd
 
     void add_action_data(const std::string &id, const APIData &out)
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string, APIData>::iterator hit;
       if ((hit = _action_data.find(id)) != _action_data.end())
         _action_data.erase(hit);
@@ -94,6 +102,7 @@ namespace dd
 
     APIData get_action_data(const std::string &id) const
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string, APIData>::const_iterator hit;
       if ((hit = _action_data.find(id)) != _action_data.end())
         return (*hit).second;
@@ -103,6 +112,7 @@ namespace dd
 
     void add_model_sname(const std::string &id, const std::string &sname)
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string, std::string>::iterator hit;
       if ((hit = _id_sname.find(id)) == _id_sname.end())
         _id_sname.insert(std::pair<std::string, std::string>(id, sname));
@@ -110,6 +120,7 @@ namespace dd
 
     std::string get_model_sname(const std::string &id)
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       std::unordered_map<std::string, std::string>::const_iterator hit;
       if ((hit = _id_sname.find(id)) != _id_sname.end())
         return (*hit).second;
@@ -125,6 +136,102 @@ namespace dd
     std::unordered_map<std::string, std::string> _id_sname;
     // std::string _first_sname;
     std::string _first_id;
+
+  private:
+    mutable std::mutex _mutex; /**< chain calls may run concurrently. */
+  };
+
+  /**
+   * \brief chain calls compiled into a dependency graph. A service call
+   *        depends on the action its input data comes from, an action on
+   *        the service whose output it acts on, and on the previous actions
+   *        on that same output since actions modify it. Calls run as soon
+   *        as their dependencies are done, so that independent branches run
+   *        concurrently.
+   */
+  class ChainGraph
+  {
+  public:
+    /**
+     * \brief a chain call
+     */
+    class Node
+    {
+    public:
+      std::string _id; /**< call id, defaults to the call position for
+                          services, to the action position for actions. */
+      std::string _name;          /**< service name or action type. */
+      bool _action = false;       /**< whether the call is an action. */
+      std::string _input_id;      /**< for a service, id of the action its
+                                     input data comes from, for an action,
+                                     id of the service it acts on. */
+      std::vector<int> _deps;     /**< calls to run before this one. */
+      std::vector<int> _children; /**< calls that depend on this one. */
+      int _status = -1;    /**< -1 not run, 0 done, 1 done without output,
+                              the calls that depend on it are skipped. */
+      double _start = 0.0; /**< start time from the chain start, in ms. */
+      double _time = 0.0;  /**< run time, in ms. */
+    };
+
+    /**
+     * \brief runs a call
+     * @return 0 on success, 1 if the call yields no output
+     */
+    typedef std::function<int(const int &, const Node &)> node_fn;
+
+    /**
+     * \brief appends a service call
+     * @param id call id, defaults to the call position
+     * @param parent_id action the input data comes from, defaults to the
+     *        previous action
+     * @param sname service name
+     */
+    void add_service(const std::string &id, const std::string &parent_id,
+                     const std::string &sname);
+
+    /**
+     * \brief appends an action, that acts on the previous service output
+     * @param id call id, defaults to the number of previous actions
+     * @param type action type
+     */
+    void add_action(const std::string &id, const std::string &type);
+
+    /**
+     * \brief runs all calls, rethrows the first exception from a call once
+     *        the running calls are done
+     */
+    void run(const node_fn &fn);
+
+    /**
+     * \brief timings of the calls that ran, in call order
+     */
+    oatpp::Vector<oatpp::Object<DTO::ChainCallTime>> timings() const;
+
+    /**
+     * \brief id of the first service call in chain order, whose output
+     *        roots the nested chain output
+     */
+    const std::string &first_service_id() const
+    {
+      return _first_service_id;
+    }
+
+    std::vector<Node> _nodes; /**< calls, in chain order. */
+
+  private:
+    void add_node(Node &node);
+
+    std::unordered_map<std::string, int>
+        _service_ids; /**< node per service call id. */
+    std::unordered_map<std::string, int>
+        _action_ids; /**< node per action id, services and actions have
+                        separate default ids. */
+    std::unordered_map<std::string, int>
+        _last_action; /**< last action per service id. */
+    std::string _prec_action_id;
+    std::string _prec_service_id;
+    std::string _first_service_id;
+    int _nactions = 0;
   };
 }
 
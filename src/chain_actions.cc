@@ -32,6 +32,7 @@
 #endif
 
 #include "utils/utils.hpp"
+#include "utils/cv_utils.hpp"
 
 #ifdef USE_DLIB
 #include "backends/dlib/dlib_actions.h"
@@ -44,13 +45,15 @@ namespace dd
   {
     auto predictions = model_out->predictions;
     ChainInputData &input_data = model_out->_chain_input;
-    std::vector<std::pair<int, int>> imgs_size = input_data._img_sizes;
+    const std::vector<std::pair<int, int>> &imgs_size = input_data._img_sizes;
     std::vector<std::string> bbox_ids;
 
-    std::vector<cv::Mat> imgs = input_data._imgs;
+    // crops are ROI views that share the ref-counted source images, the
+    // downstream service resizes them straight to its input size
+    const std::vector<cv::Mat> &imgs = input_data._imgs;
     std::vector<cv::Mat> cropped_imgs;
 #ifdef USE_CUDA_CV
-    std::vector<cv::cuda::GpuMat> cuda_imgs = input_data._cuda_imgs;
+    const std::vector<cv::cuda::GpuMat> &cuda_imgs = input_data._cuda_imgs;
     std::vector<cv::cuda::GpuMat> cropped_cuda_imgs;
 #endif
 
@@ -175,7 +178,7 @@ namespace dd
 #ifdef USE_CUDA_CV
             if (!cuda_imgs.empty())
               {
-                cv::cuda::GpuMat cropped_img = cuda_imgs.at(i)(roi).clone();
+                cv::cuda::GpuMat cropped_img = cuda_imgs.at(i)(roi);
 
                 // save crops if requested
                 if (save_crops)
@@ -193,7 +196,7 @@ namespace dd
             else
 #endif
               {
-                cv::Mat cropped_img = imgs.at(i)(roi).clone();
+                cv::Mat cropped_img = imgs.at(i)(roi);
 
                 // save crops if requested
                 if (save_crops)
@@ -480,13 +483,6 @@ namespace dd
     cdata.add_action_data(_action_id, action_out);
   }
 
-  cv::Scalar bbox_palette[]
-      = { { 82, 188, 227 }, { 196, 110, 49 }, { 39, 54, 227 },
-          { 68, 227, 81 },  { 77, 157, 255 }, { 255, 112, 207 },
-          { 240, 228, 65 }, { 94, 242, 151 }, { 236, 121, 242 },
-          { 28, 77, 120 } };
-  size_t bbox_palette_size = 10;
-
   void ImgsDrawBBoxAction::apply(oatpp::Object<DTO::PredictBody> &model_out,
                                  ChainData &cdata)
   {
@@ -534,16 +530,9 @@ namespace dd
             double xmax = bbox->xmax / orig_cols * im_cols;
             double ymax = bbox->ymax / orig_rows * im_rows;
 
-            // draw bbox
+            // draw bbox with class & confidences
             cv::Point pt1{ int(xmin), int(ymin) };
             cv::Point pt2{ int(xmax), int(ymax) };
-            size_t cls_hash = std::hash<std::string>{}(cat);
-            cv::Scalar color = bbox_palette[cls_hash % bbox_palette_size];
-            cv::rectangle(rimg, pt1, pt2, cv::Scalar(255, 255, 255),
-                          ref_thickness + 2);
-            cv::rectangle(rimg, pt1, pt2, color, ref_thickness);
-
-            // draw class & confidences
             std::string label;
             if (_params->write_cat)
               label = cat;
@@ -551,21 +540,7 @@ namespace dd
               label += " - ";
             if (_params->write_prob)
               label += std::to_string(pred->classes->at(j)->prob);
-
-            // font size relatively to base opencv font size
-            float font_size = 2;
-            int x_txt = static_cast<int>(xmin + 5);
-            if (x_txt > im_cols - 15)
-              x_txt = im_cols - 15;
-            int y_txt = std::min(im_rows - 20,
-                                 static_cast<int>(ymax + 2 + font_size * 12));
-
-            cv::putText(rimg, label, cv::Point(x_txt, y_txt),
-                        cv::FONT_HERSHEY_PLAIN, font_size,
-                        cv::Scalar(255, 255, 255), ref_thickness + 2);
-            cv::putText(rimg, label, cv::Point(x_txt, y_txt),
-                        cv::FONT_HERSHEY_PLAIN, font_size, color,
-                        ref_thickness);
+            cv_utils::draw_bbox(rimg, pt1, pt2, cat, label, ref_thickness);
           }
 
         rimgs.push_back(rimg);
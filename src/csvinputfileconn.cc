@@ -22,6 +22,10 @@
 #include "csvinputfileconn.h"
 #include "utils/csv_parser.hpp"
 #include "utils/utils.hpp"
+#include "utils/mapped_file.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
 
 namespace dd
@@ -181,85 +185,95 @@ namespace dd
                     column_id = col;
                   }
               }
+            if (!col.empty() && !_columns.empty() && is_category(col_name))
+              {
+                // one-hot vector encoding as required
+                int cnum = category_num(col_name, col);
+                int csize = _categoricals.find(col_name)->second._vals.size();
+                std::vector<double> ohv = one_hot_vector(cnum, csize);
+                vals.insert(vals.end(), ohv.begin(), ohv.end());
+                ++lit;
+                continue;
+              }
+            double val = 0.0;
+            CSVField kind;
             try
               {
-                double val = 0.0;
-                if (!col.empty())
-                  {
-                    // one-hot vector encoding as required
-                    if (!_columns.empty() && is_category(col_name))
-                      {
-                        // - look up category
-                        std::unordered_map<std::string,
-                                           CCategorical>::const_iterator chit
-                            = _categoricals.find(col_name);
-                        int cnum = (*chit).second.get_cat_num(col);
-                        if (cnum < 0)
-                          {
-                            throw InputConnectorBadParamException(
-                                "unknown category " + col + " for variable "
-                                + col_name);
-                          }
-
-                        // - create one-hot vector
-                        int csize = (*chit).second._vals.size();
-                        std::vector<double> ohv = one_hot_vector(cnum, csize);
-                        vals.insert(vals.end(), ohv.begin(), ohv.end());
-                      }
-                    else
-                      {
-                        val = std::stod(col);
-                        vals.push_back(val);
-                      }
-                  }
+                kind = csv_field(col, c, col_name, column_id, test, val);
               }
-            catch (std::invalid_argument &e)
+            catch (InputConnectorBadParamException &e)
               {
-                // not a number, skip for now
-                if (column_id == col) // if id is string, replace with number /
-                  vals.push_back(c);
-                else if (std::find(_label_pos.begin(), _label_pos.end(), c)
-                         != _label_pos.end())
-                  {
-                    std::unordered_map<std::string, int>::iterator uit;
-                    if ((uit = _hcorresp_r.find(col)) == _hcorresp_r.end())
-                      {
-                        if (test)
-                          {
-                            throw InputConnectorBadParamException(
-                                "label " + col
-                                + " found in test set but not in train set");
-                          }
-                        int clsn = _hcorresp_r.size();
-                        vals.push_back(clsn);
-                        _hcorresp_r.insert(
-                            std::pair<std::string, int>(col, clsn));
-                        _hcorresp.insert(
-                            std::pair<int, std::string>(clsn, col));
-                      }
-                    else
-                      {
-                        vals.push_back((*uit).second);
-                      }
-                  }
-                else
-                  {
-                    _logger->error(
-                        "line {}: skipping column {} / not a number", nlines,
-                        col_name);
-                    _logger->error(hline);
-                    throw InputConnectorBadParamException(
-                        "column " + col_name
-                        + " is not a number, use categoricals or ignore "
-                          "parameters instead");
-                  }
+                _logger->error("line {}: {}", nlines, e.what());
+                _logger->error(hline);
+                throw;
               }
+            if (kind == FIELD_NEW_LABEL)
+              {
+                int clsn = _hcorresp_r.size();
+                _hcorresp_r.insert(std::pair<std::string, int>(col, clsn));
+                _hcorresp.insert(std::pair<int, std::string>(clsn, col));
+                val = clsn;
+              }
+            if (kind != FIELD_EMPTY)
+              vals.push_back(val);
             ++lit;
           }
       }
     ++nlines;
   }
 
+  CSVInputFileConn::CSVField CSVInputFileConn::csv_field(
+      const std::string &col, const int &c, const std::string &col_name,
+      const std::string &column_id, const bool &test, double &val) const
+  {
+    if (col.empty())
+      return FIELD_EMPTY;
+
+    // same rules as std::stod, without an exception for every string field
+    char *cend = nullptr;
+    errno = 0;
+    val = std::strtod(col.c_str(), &cend);
+    if (cend != col.c_str())
+      {
+        if (errno == ERANGE)
+          throw std::out_of_range("stod");
+        return FIELD_VALUE;
+      }
+
+    // not a number
+    if (column_id == col) // if id is string, replace with number
+      {
+        val = c;
+        return FIELD_VALUE;
+      }
+    if (std::find(_label_pos.begin(), _label_pos.end(), c)
+        == _label_pos.end())
+      throw InputConnectorBadParamException(
+          "column " + col_name
+          + " is not a number, use categoricals or ignore parameters "
+            "instead");
+    auto uit = _hcorresp_r.find(col);
+    if (uit != _hcorresp_r.end())
+      {
+        val = (*uit).second;
+        return FIELD_VALUE;
+      }
+    if (test)
+      throw InputConnectorBadParamException(
+          "label " + col + " found in test set but not in train set");
+    return FIELD_NEW_LABEL;
+  }
+
+  int CSVInputFileConn::category_num(const std::string &col_name,
+                                     const std::string &col) const
+  {
+    int cnum = _categoricals.find(col_name)->second.get_cat_num(col);
+    if (cnum < 0)
+      throw InputConnectorBadParamException("unknown category " + col
+                                            + " for variable " + col_name);
+    return cnum;
+  }
+
   void CSVInputFileConn::read_header(std::string &hline)
   {
     hline.erase(std::remove(hline.begin(), hline.end(), '\r'),
@@ -489,15 +503,456 @@ namespace dd
     std::getline(csv_file, hline); // skip header line
   }
 
+  /**
+   * \brief CSV columns, by position in the file
+   */
+  class CSVLayout
+  {
+  public:
+    enum
+    {
+      VALUE = -1,  /**< numerical column. */
+      IGNORED = -2 /**< ignored column. */
+    };
+
+    std::vector<std::string> _names; /**< column names. */
+    std::vector<int> _kinds; /**< VALUE, IGNORED or categorical index. */
+    std::vector<std::string> _cat_names; /**< categorical column names. */
+  };
+
+  /**
+   * \brief contiguous range of CSV lines, parsed independently of the other
+   *        chunks of the file and merged in file order
+   */
+  class CSVChunk
+  {
+  public:
+    enum
+    {
+      VALUE = -1, /**< numerical value. */
+      LABEL = -2  /**< string label, chunk local id. */
+    };
+
+    /**
+     * \brief chunk local id of a value, in order of appearance
+     */
+    static int local_id(std::unordered_map<std::string, int> &ids,
+                        std::vector<std::string> &names,
+                        const std::string &v)
+    {
+      auto hit = ids.find(v);
+      if (hit != ids.end())
+        return (*hit).second;
+      int id = names.size();
+      ids.insert(std::pair<std::string, int>(v, id));
+      names.push_back(v);
+      return id;
+    }
+
+    /**
+     * \brief accumulates per column bounds of a line
+     */
+    void add_bounds(const std::vector<double> &vals)
+    {
+      for (size_t j = 0; j < vals.size(); ++j)
+        {
+          if (j == _min.size())
+            {
+              _min.push_back(vals[j]);
+              _max.push_back(vals[j]);
+              _sum.push_back(0.0);
+            }
+          _min[j] = std::min(vals[j], _min[j]);
+          _max[j] = std::max(vals[j], _max[j]);
+          _sum[j] += vals[j];
+        }
+    }
+
+    const char *_begin = nullptr;
+    const char *_end = nullptr;
+
+    // parsed fields, one-hot vectors and labels are expanded once all chunks
+    // categorical values are known
+    std::vector<size_t> _lines; /**< line offsets into fields. */
+    std::vector<double> _fields;
+    std::vector<int> _tags; /**< VALUE, LABEL or categorical index. */
+    std::vector<std::string> _ids;
+
+    // values first seen in this chunk
+    std::vector<std::unordered_map<std::string, int>> _cat_index;
+    std::vector<std::vector<std::string>> _cats;
+    std::unordered_map<std::string, int> _label_index;
+    std::vector<std::string> _labels;
+    std::vector<std::vector<int>> _cat_ids; /**< local to global ids. */
+    std::vector<int> _label_ids;            /**< local to global ids. */
+
+    std::vector<std::vector<double>> _vals; /**< final line values. */
+    std::vector<double> _min;
+    std::vector<double> _max;
+    std::vector<double> _sum;
+    std::vector<double> _sqdev; /**< sum of squared deviations to mean. */
+
+    std::exception_ptr _error;
+    size_t _error_line = 0; /**< chunk line of the error. */
+    std::string _error_hline;
+  };
+
+  void CSVInputFileConn::parse_csv_chunk(CSVChunk &chunk,
+                                         const CSVLayout &layout,
+                                         const bool &collect,
+                                         const bool &test) const
+  {
+    std::string hline;
+    std::string field;
+    std::string cid;
+    int c = -1;
+    const int ncols = layout._kinds.size();
+
+    auto add_field = [&](const std::string &col) {
+      ++c;
+      int kind = CSVLayout::VALUE;
+      std::string col_name;
+      if (c < ncols)
+        {
+          kind = layout._kinds[c];
+          if (kind == CSVLayout::IGNORED)
+            return;
+          col_name = layout._names[c];
+        }
+      else if (!_columns.empty())
+        throw InputConnectorBadParamException(
+            "line has more columns than headers");
+      if (_id_pos == c)
+        cid = col;
+
+      if (kind >= 0)
+        {
+          // categorical value, one-hot encoded once all values are known
+          if (col.empty())
+            return;
+          if (collect)
+            chunk._fields.push_back(CSVChunk::local_id(
+                chunk._cat_index[kind], chunk._cats[kind], col));
+          else
+            chunk._fields.push_back(category_num(col_name, col));
+          chunk._tags.push_back(kind);
+          return;
+        }
+
+      double val = 0.0;
+      CSVField fkind = csv_field(col, c, col_name, cid, test, val);
+      if (fkind == FIELD_NEW_LABEL)
+        {
+          chunk._fields.push_back(
+              CSVChunk::local_id(chunk._label_index, chunk._labels, col));
+          chunk._tags.push_back(CSVChunk::LABEL);
+        }
+      else if (fkind == FIELD_VALUE)
+        {
+          chunk._fields.push_back(val);
+          chunk._tags.push_back(CSVChunk::VALUE);
+        }
+    };
+
+    try
+      {
+        const char *p = chunk._begin;
+        while (p < chunk._end)
+          {
+            const char *eol = static_cast<const char *>(
+                std::memchr(p, '\n', chunk._end - p));
+            if (!eol)
+              eol = chunk._end;
+            hline.assign(p, eol);
+            p = eol + 1;
+            if (hline.find('\r') != std::string::npos)
+              hline.erase(std::remove(hline.begin(), hline.end(), '\r'),
+                          hline.end());
+
+            chunk._lines.push_back(chunk._fields.size());
+            cid.clear();
+            c = -1;
+            if (hline.find(_quote[0]) == std::string::npos)
+              {
+                // no quoting, plain split
+                size_t start = 0;
+                while (start < hline.size())
+                  {
+                    size_t stop = hline.find(_delim[0], start);
+                    if (stop == std::string::npos)
+                      stop = hline.size();
+                    field.assign(hline, start, stop - start);
+                    add_field(field);
+                    start = stop + 1;
+                  }
+              }
+            else
+              {
+                std::stringstream sh(hline);
+                aria::csv::CsvParser parser
+                    = aria::csv::CsvParser(sh)
+                          .delimiter(_delim[0]) // default is ,
+                          .quote(_quote[0]);    // default is"
+                for (auto &row : parser)
+                  for (auto &col : row)
+                    add_field(col);
+              }
+            if (!_id.empty())
+              chunk._ids.push_back(cid);
+          }
+      }
+    catch (...)
+      {
+        chunk._error = std::current_exception();
+        chunk._error_line = chunk._lines.size();
+        chunk._error_hline = hline;
+      }
+  }
+
+  size_t CSVInputFileConn::read_csv_chunks(const char *begin, const char *end,
+                                           const bool &test,
+                                           std::vector<CSVChunk> &chunks)
+  {
+    // columns layout
+    CSVLayout layout;
+    auto lit = _columns.begin();
+    for (int c = 0; c < _detect_cols; ++c)
+      {
+        if (_ignored_columns_pos.find(c) != _ignored_columns_pos.end()
+            || lit == _columns.end())
+          {
+            layout._names.push_back("");
+            layout._kinds.push_back(CSVLayout::IGNORED);
+            continue;
+          }
+        layout._names.push_back((*lit));
+        if (is_category((*lit)))
+          {
+            layout._kinds.push_back(layout._cat_names.size());
+            layout._cat_names.push_back((*lit));
+          }
+        else
+          layout._kinds.push_back(CSVLayout::VALUE);
+        ++lit;
+      }
+    const int ncats = layout._cat_names.size();
+
+    // chunks end on line boundaries
+    size_t nchunks = std::max(
+        size_t(1), (size_t(end - begin) + _chunk_size - 1) / _chunk_size);
+    chunks.clear();
+    chunks.resize(nchunks);
+    const char *p = begin;
+    for (size_t i = 0; i < nchunks; ++i)
+      {
+        const char *stop = end;
+        if (i < nchunks - 1 && size_t(end - p) > _chunk_size)
+          {
+            stop = p + _chunk_size;
+            if (*(stop - 1) != '\n')
+              {
+                const char *eol = static_cast<const char *>(
+                    std::memchr(stop, '\n', end - stop));
+                stop = eol ? eol + 1 : end;
+              }
+          }
+        chunks[i]._begin = p;
+        chunks[i]._end = stop;
+        chunks[i]._cat_index.resize(ncats);
+        chunks[i]._cats.resize(ncats);
+        p = stop;
+      }
+
+    auto check_errors = [&]() {
+      size_t nlines = 0;
+      for (CSVChunk &chunk : chunks)
+        {
+          if (chunk._error)
+            {
+              _logger->error("line {}: {}", nlines + chunk._error_line,
+                             chunk._error_hline);
+              std::rethrow_exception(chunk._error);
+            }
+          nlines += chunk._lines.size();
+        }
+      return nlines;
+    };
+
+    // parsing
+    bool collect = _train && !_categoricals.empty() && !test;
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < nchunks; ++i)
+      parse_csv_chunk(chunks[i], layout, collect, test);
+    size_t nlines = check_errors();
+
+    // merge categorical values and string labels, in order of appearance
+    // so that ids do not depend on chunking
+    for (CSVChunk &chunk : chunks)
+      {
+        chunk._cat_ids.resize(ncats);
+        for (int k = 0; k < ncats; ++k)
+          {
+            CCategorical &cat = _categoricals[layout._cat_names[k]];
+            for (const std::string &v : chunk._cats[k])
+              {
+                cat.add_cat(v);
+                chunk._cat_ids[k].push_back(cat.get_cat_num(v));
+              }
+          }
+        for (const std::string &l : chunk._labels)
+          {
+            auto uit = _hcorresp_r.find(l);
+            if (uit != _hcorresp_r.end())
+              chunk._label_ids.push_back((*uit).second);
+            else
+              {
+                int clsn = _hcorresp_r.size();
+                _hcorresp_r.insert(std::pair<std::string, int>(l, clsn));
+                _hcorresp.insert(std::pair<int, std::string>(clsn, l));
+                chunk._label_ids.push_back(clsn);
+              }
+          }
+      }
+    std::vector<int> cat_sizes;
+    for (const std::string &name : layout._cat_names)
+      cat_sizes.push_back(_categoricals[name]._vals.size());
+
+    // line values, with scaling bounds when missing
+    bool minmax = !test && _scale && _scale_type == MINMAX
+                  && (_min_vals.empty() || _max_vals.empty());
+    bool znorm = !test && _scale && _scale_type == ZNORM
+                 && (_mean_vals.empty() || _variance_vals.empty());
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < nchunks; ++i)
+      {
+        CSVChunk &chunk = chunks[i];
+        size_t nclines = chunk._lines.size();
+        chunk._vals.resize(nclines);
+        size_t l = 0;
+        try
+          {
+            for (; l < nclines; ++l)
+              {
+                size_t fend = l + 1 < nclines ? chunk._lines[l + 1]
+                                              : chunk._fields.size();
+                std::vector<double> &vals = chunk._vals[l];
+                for (size_t f = chunk._lines[l]; f < fend; ++f)
+                  {
+                    int tag = chunk._tags[f];
+                    if (tag == CSVChunk::VALUE)
+                      vals.push_back(chunk._fields[f]);
+                    else if (tag == CSVChunk::LABEL)
+                      vals.push_back(chunk._label_ids.at(
+                          static_cast<size_t>(chunk._fields[f])));
+                    else
+                      {
+                        // one-hot vector encoding
+                        int cnum = static_cast<int>(chunk._fields[f]);
+                        if (collect)
+                          cnum = chunk._cat_ids[tag].at(cnum);
+                        size_t offset = vals.size();
+                        vals.resize(offset + cat_sizes[tag], 0.0);
+                        vals.at(offset + cnum) = 1.0;
+                      }
+                  }
+                if (minmax || znorm)
+                  chunk.add_bounds(vals);
+              }
+          }
+        catch (...)
+          {
+            chunk._error = std::current_exception();
+            chunk._error_line = l + 1;
+          }
+        chunk._fields = std::vector<double>();
+        chunk._tags = std::vector<int>();
+      }
+    check_errors();
+
+    if (minmax || znorm)
+      {
+        std::vector<double> min_vals, max_vals, sum_vals;
+        for (CSVChunk &chunk : chunks)
+          for (size_t j = 0; j < chunk._min.size(); ++j)
+            {
+              if (j == min_vals.size())
+                {
+                  min_vals.push_back(chunk._min[j]);
+                  max_vals.push_back(chunk._max[j]);
+                  sum_vals.push_back(0.0);
+                }
+              min_vals[j] = std::min(chunk._min[j], min_vals[j]);
+              max_vals[j] = std::max(chunk._max[j], max_vals[j]);
+              sum_vals[j] += chunk._sum[j];
+            }
+        if (minmax)
+          {
+            _min_vals = min_vals;
+            _max_vals = max_vals;
+          }
+        if (znorm)
+          {
+            _mean_vals = sum_vals;
+            for (double &m : _mean_vals)
+              m /= nlines;
+#pragma omp parallel for schedule(dynamic)
+            for (size_t i = 0; i < nchunks; ++i)
+              {
+                CSVChunk &chunk = chunks[i];
+                chunk._sqdev.resize(_mean_vals.size(), 0.0);
+                for (const std::vector<double> &vals : chunk._vals)
+                  for (size_t j = 0; j < vals.size(); ++j)
+                    chunk._sqdev[j] += (vals[j] - _mean_vals[j])
+                                       * (vals[j] - _mean_vals[j]);
+              }
+            _variance_vals.clear();
+            _variance_vals.resize(_mean_vals.size(), 0.0);
+            for (CSVChunk &chunk : chunks)
+              for (size_t j = 0; j < chunk._sqdev.size(); ++j)
+                _variance_vals[j] += chunk._sqdev[j];
+            for (double &v : _variance_vals)
+              v /= nlines;
+          }
+      }
+
+    if (_scale)
+      {
+#pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < nchunks; ++i)
+          {
+            CSVChunk &chunk = chunks[i];
+            size_t l = 0;
+            try
+              {
+                for (; l < chunk._vals.size(); ++l)
+                  scale_vals(chunk._vals[l]);
+              }
+            catch (...)
+              {
+                chunk._error = std::current_exception();
+                chunk._error_line = l + 1;
+              }
+          }
+        check_errors();
+      }
+    return nlines;
+  }
+
   void CSVInputFileConn::read_csv(const std::string &fname,
                                   const bool &forbid_shuffle)
   {
-    std::ifstream csv_file(fname, std::ios::binary);
+    MappedFile csv_file(fname);
     _logger->info("fname={} / open={}", fname, csv_file.is_open());
     if (!csv_file.is_open())
       throw InputConnectorBadParamException("cannot open file " + fname);
-    std::string hline;
-    std::getline(csv_file, hline);
+    const char *begin = csv_file.data();
+    const char *end = begin + csv_file.size();
+    const char *eoh = begin ? static_cast<const char *>(
+                          std::memchr(begin, '\n', end - begin))
+                            : nullptr;
+    if (!eoh)
+      eoh = end;
+    std::string hline(begin, eoh);
     read_header(hline);
 
     // debug
@@ -509,54 +964,24 @@ namespace dd
               std::cout << std::endl;*/
     // debug
 
-    // categorical variables
-    if (_train && !_categoricals.empty())
-      {
-        fillup_categoricals(csv_file);
-      }
-
-    // scaling to [0,1]
-    int nlines = 0;
-    if (_scale && _scale_type == MINMAX
-        && (_min_vals.empty() || _max_vals.empty()))
-      {
-        find_min_max(csv_file);
-      }
-    if (_scale && _scale_type == ZNORM
-        && (_mean_vals.empty() || _variance_vals.empty()))
-      {
-        find_mean(csv_file);
-        find_variance(csv_file, _mean_vals);
-      }
-
     // read data
-    while (std::getline(csv_file, hline))
+    std::vector<CSVChunk> chunks;
+    size_t nlines
+        = read_csv_chunks(eoh < end ? eoh + 1 : end, end, false, chunks);
+    size_t l = 0;
+    for (CSVChunk &chunk : chunks)
       {
-        hline.erase(std::remove(hline.begin(), hline.end(), '\r'),
-                    hline.end());
-        std::vector<double> vals;
-        std::string cid;
-        read_csv_line(hline, _delim, vals, cid, nlines, false);
-        if (_scale)
-          {
-            scale_vals(vals);
-          }
-        if (!_id.empty())
+        for (size_t i = 0; i < chunk._vals.size(); ++i)
           {
-            add_train_csvline(cid, vals);
+            ++l;
+            if (!_id.empty())
+              add_train_csvline(chunk._ids[i], chunk._vals[i]);
+            else
+              add_train_csvline(std::to_string(l), chunk._vals[i]);
           }
-        else
-          add_train_csvline(std::to_string(nlines), vals);
-
-        // debug
-        /*std::cout << "csv data line #" << nlines << "= " << vals.size() <<
-          std::endl;
-          std::copy(vals.begin(),vals.end(),std::ostream_iterator<double>(std::cout,""));
-          std::cout << std::endl;*/
-        // debug
+        chunk = CSVChunk();
       }
     _logger->info("read {} lines from {}", nlines, fname);
-    csv_file.close();
 
     // test file, if any.
     if (!_csv_test_fnames.empty())
@@ -564,37 +989,33 @@ namespace dd
         unsigned int test_set_id = 0;
         for (std::string csv_test_fname : _csv_test_fnames)
           {
-            nlines = 0;
-            std::ifstream csv_test_file(csv_test_fname, std::ios::binary);
+            MappedFile csv_test_file(csv_test_fname);
             if (!csv_test_file.is_open())
               throw InputConnectorBadParamException("cannot open test file "
-                                                    + fname);
-            std::getline(csv_test_file, hline); // skip header line
-            while (std::getline(csv_test_file, hline))
+                                                    + csv_test_fname);
+            begin = csv_test_file.data();
+            end = begin + csv_test_file.size();
+            eoh = begin ? static_cast<const char *>(
+                      std::memchr(begin, '\n', end - begin))
+                        : nullptr; // skip header line
+            nlines = read_csv_chunks(eoh ? eoh + 1 : end, end, true, chunks);
+            l = 0;
+            for (CSVChunk &chunk : chunks)
               {
-                hline.erase(std::remove(hline.begin(), hline.end(), '\r'),
-                            hline.end());
-                std::vector<double> vals;
-                std::string cid;
-                read_csv_line(hline, _delim, vals, cid, nlines, true);
-                if (_scale)
+                for (size_t i = 0; i < chunk._vals.size(); ++i)
                   {
-                    scale_vals(vals);
+                    ++l;
+                    if (!_id.empty())
+                      add_test_csvline(test_set_id, chunk._ids[i],
+                                       chunk._vals[i]);
+                    else
+                      add_test_csvline(test_set_id, std::to_string(l),
+                                       chunk._vals[i]);
                   }
-                if (!_id.empty())
-                  add_test_csvline(test_set_id, cid, vals);
-                else
-                  add_test_csvline(test_set_id, std::to_string(nlines), vals);
-
-                // debug
-                /*std::cout << "csv test data line=";
-                  std::copy(vals.begin(),vals.end(),std::ostream_iterator<double>(std::cout,"
-                  ")); std::cout << std::endl;*/
-                // debug
+                chunk = CSVChunk();
               }
             _logger->info("read {} lines from {}", nlines,
                           _csv_test_fnames[test_set_id]);
-            csv_test_file.close();
             test_set_id++;
           }
       }
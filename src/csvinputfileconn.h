@@ -72,6 +72,10 @@ namespace dd
         : _str(str), _v(v)
     {
     }
+    CSVline(const std::string &str, std::vector<double> &&v)
+        : _str(str), _v(std::move(v))
+    {
+    }
     ~CSVline()
     {
     }
@@ -79,6 +83,9 @@ namespace dd
     std::vector<double> _v; /**< csv line data */
   };
 
+  class CSVChunk;
+  class CSVLayout;
+
   /**
    * \brief Categorical values mapper.
    *        Categorical values are discrete sets that are converted to int
@@ -693,13 +700,71 @@ namespace dd
                        int &nlines, const bool &test);
 
     /**
-     * \brief reads a full CSV data file, calls read_csv_line
+     * \brief reads a full CSV data file in a single pass: the memory mapped
+     *        file is cut into chunks that are parsed in parallel, categorical
+     *        values and scaling bounds are gathered per chunk and merged
      * @param fname the CSV file name
      * @param forbid_shuffle whether shuffle is forbidden
      */
     void read_csv(const std::string &fname,
                   const bool &forbid_shuffle = false);
 
+    /**
+     * \brief parses CSV data lines, without header, into scaled values
+     * @param begin start of the data
+     * @param end end of the data
+     * @param test whether the data is from the test set
+     * @param chunks filled up with parsed chunks, in file order
+     * @return number of lines
+     */
+    size_t read_csv_chunks(const char *begin, const char *end,
+                           const bool &test, std::vector<CSVChunk> &chunks);
+
+    /**
+     * \brief parses the lines of a chunk, thread-safe
+     * @param chunk the chunk to parse
+     * @param layout CSV columns layout
+     * @param collect whether to gather new categorical values
+     * @param test whether the chunk is from the test set
+     */
+    void parse_csv_chunk(CSVChunk &chunk, const CSVLayout &layout,
+                         const bool &collect, const bool &test) const;
+
+    /**
+     * \brief kinds of non categorical CSV fields
+     */
+    enum CSVField
+    {
+      FIELD_EMPTY,    /**< empty field, no value. */
+      FIELD_VALUE,    /**< number, string id or known label. */
+      FIELD_NEW_LABEL /**< label not seen yet, to be registered. */
+    };
+
+    /**
+     * \brief classifies a non categorical CSV field, shared by line and
+     *        chunk parsing, thread-safe
+     * @param col field
+     * @param c column position
+     * @param col_name column name
+     * @param column_id id of the line, a string id is replaced with c
+     * @param test whether the field is from the test set
+     * @param val filled up with the field value
+     * @return kind of the field
+     */
+    CSVField csv_field(const std::string &col, const int &c,
+                       const std::string &col_name,
+                       const std::string &column_id, const bool &test,
+                       double &val) const;
+
+    /**
+     * \brief index of a value of a categorical variable, throws if unknown
+     * @param col_name categorical variable name
+     * @param col value
+     * @return category index
+     */
+    int category_num(const std::string &col_name,
+                     const std::string &col) const;
+
     int batch_size() const
     {
       return _csvdata.size();
@@ -956,6 +1021,8 @@ namespace dd
     std::string _correspname = "corresp.txt";
     std::string _boundsfname
         = "bounds.dat"; /**< variables min/max bounds filename. */
+    size_t _chunk_size
+        = 16 * 1024 * 1024; /**< CSV file bytes per parsing chunk. */
 
     // data
     std::vector<CSVline> _csvdata;
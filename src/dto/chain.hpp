@@ -242,6 +242,35 @@ namespace dd
       DTO_INIT(ChainHead, DTO)
     };
 
+    class ChainCallTime : public oatpp::DTO
+    {
+      DTO_INIT(ChainCallTime, DTO)
+
+      DTO_FIELD_INFO(id)
+      {
+        info->description = "Chain call id";
+      }
+      DTO_FIELD(String, id);
+
+      DTO_FIELD_INFO(name)
+      {
+        info->description = "Service name or action type";
+      }
+      DTO_FIELD(String, name);
+
+      DTO_FIELD_INFO(start)
+      {
+        info->description = "Call start time from the chain start, in ms";
+      }
+      DTO_FIELD(Float64, start);
+
+      DTO_FIELD_INFO(time)
+      {
+        info->description = "Call duration in ms";
+      }
+      DTO_FIELD(Float64, time);
+    };
+
     // TODO rename chain output body
     class ChainBody : public oatpp::DTO
     {
@@ -250,6 +279,13 @@ namespace dd
       DTO_FIELD(Vector<UnorderedFields<Any>>, predictions)
           = Vector<UnorderedFields<Any>>::createShared();
       DTO_FIELD(Float64, time);
+
+      DTO_FIELD_INFO(calls_time)
+      {
+        info->description = "Timings of the calls that ran, independent "
+                            "calls run concurrently";
+      }
+      DTO_FIELD(Vector<Object<ChainCallTime>>, calls_time);
     };
 
     class ChainResponse : public GenericResponse
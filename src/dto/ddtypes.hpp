@@ -318,6 +318,11 @@ namespace dd
       return static_cast<uint8_t>(caret.parseUnsignedInt());
     }
 
+    template <> inline int readVecElement<int>(oatpp::parser::Caret &caret)
+    {
+      return static_cast<int>(caret.parseInt());
+    }
+
     template <> inline bool readVecElement<bool>(oatpp::parser::Caret &caret)
     {
       if (caret.isAtText("true"))
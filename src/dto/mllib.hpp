@@ -43,6 +43,84 @@ namespace dd
         info->description = "Testing batch size";
       }
       DTO_FIELD(Int32, test_batch_size) = 1;
+
+      DTO_FIELD_INFO(prefetch_batches)
+      {
+        info->description
+            = "Number of predict batches read and moved to device ahead of "
+              "the forward pass, 0 reads batches synchronously (torch only)";
+      }
+      DTO_FIELD(Int32, prefetch_batches) = 2;
+    };
+
+    class Batching : public oatpp::DTO
+    {
+      DTO_INIT(Batching, DTO)
+
+      DTO_FIELD_INFO(max_batch_size)
+      {
+        info->description = "Max number of data elements coalesced from "
+                            "concurrent predict calls into a single batch";
+      }
+      DTO_FIELD(Int32, max_batch_size) = 16;
+
+      DTO_FIELD_INFO(max_latency_ms)
+      {
+        info->description = "Max time in milliseconds a predict call waits "
+                            "for other calls to join its batch";
+      }
+      DTO_FIELD(Int32, max_latency_ms) = 5;
+    };
+
+    class Generate : public oatpp::DTO
+    {
+      DTO_INIT(Generate, DTO)
+
+      DTO_FIELD_INFO(max_tokens)
+      {
+        info->description = "Max number of generated tokens";
+      }
+      DTO_FIELD(Int32, max_tokens) = 32;
+
+      DTO_FIELD_INFO(top_k)
+      {
+        info->description = "Next token is sampled among the k most likely "
+                            "tokens, 0 samples among all tokens";
+      }
+      DTO_FIELD(Int32, top_k) = 5;
+
+      DTO_FIELD_INFO(temperature)
+      {
+        info->description = "Sampling temperature, higher values give more "
+                            "random text, 0 always picks the most likely "
+                            "token";
+      }
+      DTO_FIELD(Float32, temperature) = 1.0;
+
+      DTO_FIELD_INFO(stop)
+      {
+        info->description = "Vocabulary tokens that end the generation, in "
+                            "addition to the end of text token";
+      }
+      DTO_FIELD(Vector<String>, stop) = Vector<String>::createShared();
+
+      DTO_FIELD_INFO(seed)
+      {
+        info->description = "Sampling seed, -1 for random seeding";
+      }
+      DTO_FIELD(Int32, seed) = -1;
+    };
+
+    class PredictCache : public oatpp::DTO
+    {
+      DTO_INIT(PredictCache, DTO)
+
+      DTO_FIELD_INFO(max_size_mb)
+      {
+        info->description
+            = "Memory budget of cached predict outputs, in megabytes";
+      }
+      DTO_FIELD(Int32, max_size_mb) = 64;
     };
 
     class MLLib : public oatpp::DTO
@@ -189,6 +267,30 @@ namespace dd
       }
       DTO_FIELD(Boolean, concurrent_predict) = true;
 
+      DTO_FIELD_INFO(batching)
+      {
+        info->description
+            = "Server-side dynamic batching of concurrent predict calls, "
+              "disabled if not set (service creation only)";
+      }
+      DTO_FIELD(Object<Batching>, batching);
+
+      DTO_FIELD_INFO(predict_workers)
+      {
+        info->description
+            = "Number of independent model instances serving concurrent "
+              "predict calls (service creation only)";
+      }
+      DTO_FIELD(Int32, predict_workers) = 1;
+
+      DTO_FIELD_INFO(predict_cache)
+      {
+        info->description
+            = "Cache of predict outputs for identical calls, disabled if not "
+              "set (service creation only)";
+      }
+      DTO_FIELD(Object<PredictCache>, predict_cache);
+
       // Libtorch predict options
       DTO_FIELD_INFO(forward_method)
       {
@@ -198,6 +300,15 @@ namespace dd
       }
       DTO_FIELD(String, forward_method) = "";
 
+      DTO_FIELD_INFO(generate)
+      {
+        info->description
+            = "Generates text from the input sequences in a single call, "
+              "next token distributions are returned if not set (gpt2 "
+              "template only)";
+      }
+      DTO_FIELD(Object<Generate>, generate);
+
       // =====
       // TensorRT Options
       DTO_FIELD_INFO(calibration)
@@ -49,6 +49,15 @@ namespace dd
       DTO_FIELD(Vector<String>, confidences);
       DTO_FIELD(Int32, top_k) = -1;
 
+      DTO_FIELD_INFO(mask_format)
+      {
+        info->description
+            = "Segmentation only: returns the class map (and \"best\" "
+              "confidence map) encoded as \"rle\" run lengths or as a "
+              "\"png\" image instead of the vals array";
+      }
+      DTO_FIELD(String, mask_format) = "";
+
       DTO_FIELD_INFO(image)
       {
         info->description = "wether to convert result to a cv::Mat (e.g. for "
@@ -94,6 +103,14 @@ namespace dd
       DTO_FIELD(Boolean, search) = false;
       DTO_FIELD(Int32, search_nn);
 
+      DTO_FIELD_INFO(search_k)
+      {
+        info->description
+            = "annoy backend: number of tree nodes inspected per search, "
+              "default is search_nn x number of trees";
+      }
+      DTO_FIELD(Int32, search_k);
+
       // model parameters
       DTO_FIELD(Int32, nprobe);
       DTO_FIELD(String, index_type);
@@ -132,6 +132,42 @@ namespace dd
       DTO_FIELD(String, class_id);
     };
 
+    class SegmentationMask : public oatpp::DTO
+    {
+      DTO_INIT(SegmentationMask, DTO)
+
+      DTO_FIELD_INFO(format)
+      {
+        info->description = "Mask encoding, \"rle\" or \"png\"";
+      }
+      DTO_FIELD(String, format);
+
+      DTO_FIELD(Int32, width);
+      DTO_FIELD(Int32, height);
+
+      DTO_FIELD_INFO(data)
+      {
+        info->description
+            = "[png] Base64 grayscale PNG image, 8-bit, or 16-bit when the "
+              "model has more than 256 classes";
+      }
+      DTO_FIELD(String, data);
+
+      DTO_FIELD_INFO(values)
+      {
+        info->description = "[rle] Value of each run";
+      }
+      DTO_FIELD(DTOVector<int>, values);
+
+      DTO_FIELD_INFO(counts)
+      {
+        info->description
+            = "[rle] Length of each run, runs follow the row-major order "
+              "of the pixels";
+      }
+      DTO_FIELD(DTOVector<int>, counts);
+    };
+
     class Prediction : public oatpp::DTO
     {
       DTO_INIT(Prediction, DTO)
@@ -212,6 +248,21 @@ namespace dd
       }
       DTO_FIELD(UnorderedFields<DTOVector<double>>, confidences);
 
+      DTO_FIELD_INFO(mask)
+      {
+        info->description
+            = "[Segmentation] Encoded class map, with output.mask_format";
+      }
+      DTO_FIELD(Object<SegmentationMask>, mask);
+
+      DTO_FIELD_INFO(mask_confidence)
+      {
+        info->description
+            = "[Segmentation] Encoded \"best\" confidence map, with "
+              "output.mask_format, confidences are scaled to [0,255]";
+      }
+      DTO_FIELD(Object<SegmentationMask>, mask_confidence);
+
       DTO_FIELD_INFO(indexed)
       {
         info->description
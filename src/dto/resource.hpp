@@ -61,6 +61,20 @@ namespace dd
         info->description = "Id of current frame";
       }
       DTO_FIELD(Int32, current_frame) = -1;
+
+      DTO_FIELD_INFO(decoded_frames)
+      {
+        info->description = "Number of decoded frames";
+      }
+      DTO_FIELD(Int64, decoded_frames) = 0;
+
+      DTO_FIELD_INFO(dropped_frames)
+      {
+        info->description
+            = "Number of decoded frames that were never processed, with "
+              "\"latest\" frame policy";
+      }
+      DTO_FIELD(Int64, dropped_frames) = 0;
     };
 
     /** Video requirements for cameras */
@@ -129,6 +143,24 @@ namespace dd
       }
       DTO_FIELD(Object<VideoRequirements>, video_requirements)
           = VideoRequirements::createShared();
+
+      DTO_FIELD_INFO(frame_policy)
+      {
+        info->description
+            = "For video sources, how frames are decoded: \"sync\" decodes "
+              "a frame within each predict call, \"latest\" decodes in the "
+              "background and only keeps the latest frame (stale frames are "
+              "dropped), \"every_frame\" decodes in the background and "
+              "processes every frame";
+      }
+      DTO_FIELD(String, frame_policy) = "sync";
+
+      DTO_FIELD_INFO(frame_buffer_size)
+      {
+        info->description = "For video sources with background decoding, "
+                            "size of the decoded frames buffer";
+      }
+      DTO_FIELD(Int32, frame_buffer_size) = 8;
     };
 
     // OUTPUT
@@ -65,6 +65,20 @@ namespace dd
                             "custom gstreamer pipeline.";
       }
       DTO_FIELD(String, video_out);
+
+      DTO_FIELD_INFO(draw_bbox)
+      {
+        info->description
+            = "(video only) Draw predicted bboxes on the output frames";
+      }
+      DTO_FIELD(Boolean, draw_bbox) = true;
+
+      DTO_FIELD_INFO(queue_size)
+      {
+        info->description = "Max number of frames waiting between two "
+                            "stages of the stream pipeline";
+      }
+      DTO_FIELD(Int32, queue_size) = 4;
     };
 
     class Stream : public oatpp::DTO
@@ -102,6 +116,77 @@ namespace dd
     class StreamResponseBody : public oatpp::DTO
     {
       DTO_INIT(StreamResponseBody, DTO)
+
+      DTO_FIELD_INFO(name)
+      {
+        info->description = "Name of the stream";
+      }
+      DTO_FIELD(String, name);
+
+      DTO_FIELD_INFO(status)
+      {
+        info->description = "Stream status: running, ended, error";
+      }
+      DTO_FIELD(String, status);
+
+      DTO_FIELD_INFO(message)
+      {
+        info->description = "Message that can go with an \"error\" status";
+      }
+      DTO_FIELD(String, message);
+
+      DTO_FIELD_INFO(frames)
+      {
+        info->description = "Number of frames processed and written out";
+      }
+      DTO_FIELD(Int64, frames) = 0;
+
+      DTO_FIELD_INFO(fps)
+      {
+        info->description = "Current processing rate, in frames per second";
+      }
+      DTO_FIELD(Float64, fps) = 0;
+
+      DTO_FIELD_INFO(latency)
+      {
+        info->description = "Mean time in milliseconds from frame decoding "
+                            "to frame writing";
+      }
+      DTO_FIELD(Float64, latency) = 0;
+
+      DTO_FIELD_INFO(last_latency)
+      {
+        info->description
+            = "Time in milliseconds from decoding to writing of the last "
+              "frame";
+      }
+      DTO_FIELD(Float64, last_latency) = 0;
+
+      DTO_FIELD_INFO(decode_time)
+      {
+        info->description = "Mean frame decoding time in milliseconds";
+      }
+      DTO_FIELD(Float64, decode_time) = 0;
+
+      DTO_FIELD_INFO(infer_time)
+      {
+        info->description
+            = "Mean predict or chain call time per frame in milliseconds";
+      }
+      DTO_FIELD(Float64, infer_time) = 0;
+
+      DTO_FIELD_INFO(render_time)
+      {
+        info->description
+            = "Mean time in milliseconds to draw predictions on a frame";
+      }
+      DTO_FIELD(Float64, render_time) = 0;
+
+      DTO_FIELD_INFO(encode_time)
+      {
+        info->description = "Mean frame encoding time in milliseconds";
+      }
+      DTO_FIELD(Float64, encode_time) = 0;
     };
 
     class StreamResponse : public GenericResponse
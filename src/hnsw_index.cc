@@ -0,0 +1,536 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hnsw_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace dd
+{
+  namespace
+  {
+    /** on-disk header, followed by the level 0 records then the upper
+     * levels links of each node */
+    struct HNSWHeader
+    {
+      char _magic[8];
+      int32_t _version;
+      int32_t _dim;
+      int32_t _M;
+      int32_t _ef_construction;
+      int32_t _storage;
+      int32_t _count;
+      int32_t _entry;
+      int32_t _max_level;
+      int32_t _reserved[6];
+    };
+
+    const char hnsw_magic[8] = { 'D', 'D', 'H', 'N', 'S', 'W', 0, 0 };
+    const int32_t hnsw_version = 1;
+
+    /** visited marks, reset in O(1) by bumping the tag */
+    class VisitedTags
+    {
+    public:
+      void reset(const size_t &n)
+      {
+        if (_tags.size() < n)
+          _tags.resize(n, 0);
+        if (++_tag == 0)
+          {
+            std::fill(_tags.begin(), _tags.end(), 0);
+            _tag = 1;
+          }
+      }
+
+      bool visit(const int &id)
+      {
+        if (_tags[id] == _tag)
+          return false;
+        _tags[id] = _tag;
+        return true;
+      }
+
+    private:
+      std::vector<uint32_t> _tags;
+      uint32_t _tag = 0;
+    };
+
+    thread_local VisitedTags visited;
+
+    float l2(const float *u, const float *v, const int &dim)
+    {
+      float d = 0.0;
+      for (int i = 0; i < dim; ++i)
+        {
+          float diff = u[i] - v[i];
+          d += diff * diff;
+        }
+      return d;
+    }
+
+    typedef std::pair<float, int> DistId;
+  }
+
+  HNSWIndex::HNSWIndex(const int &dim, const int &M,
+                       const int &ef_construction, const Storage &storage)
+      : _dim(dim), _M(M), _M0(2 * M), _ef_construction(ef_construction),
+        _storage(storage), _level_mult(1.0 / std::log(std::max(M, 2))),
+        _rng(100)
+  {
+    _vec_offset = (3 + _M0) * sizeof(int);
+    size_t vec_size = _storage == INT8 ? sizeof(float) + _dim
+                                       : _dim * sizeof(float);
+    _rec_size = _vec_offset + ((vec_size + 3) / 4) * 4;
+  }
+
+  HNSWIndex::~HNSWIndex()
+  {
+  }
+
+  int *HNSWIndex::links(const int &id, const int &level) const
+  {
+    if (level == 0)
+      return links0(id);
+    return const_cast<int *>(_upper[id].data()) + (level - 1) * (1 + _M);
+  }
+
+  void HNSWIndex::encode(const float *vec, char *code) const
+  {
+    if (_storage == FLOAT32)
+      {
+        std::memcpy(code, vec, _dim * sizeof(float));
+        return;
+      }
+    // symmetric per-vector scale
+    float amax = 0.0;
+    for (int i = 0; i < _dim; ++i)
+      amax = std::max(amax, std::fabs(vec[i]));
+    float scale = amax > 0.0 ? amax / 127.0 : 1.0;
+    std::memcpy(code, &scale, sizeof(float));
+    int8_t *q = reinterpret_cast<int8_t *>(code + sizeof(float));
+    for (int i = 0; i < _dim; ++i)
+      q[i] = static_cast<int8_t>(std::lround(vec[i] / scale));
+  }
+
+  void HNSWIndex::decode(const int &id, float *vec) const
+  {
+    const char *code = node_vector(id);
+    if (_storage == FLOAT32)
+      {
+        std::memcpy(vec, code, _dim * sizeof(float));
+        return;
+      }
+    float scale;
+    std::memcpy(&scale, code, sizeof(float));
+    const int8_t *q = reinterpret_cast<const int8_t *>(code + sizeof(float));
+    for (int i = 0; i < _dim; ++i)
+      vec[i] = q[i] * scale;
+  }
+
+  float HNSWIndex::distance(const float *query, const int &id) const
+  {
+    const char *code = node_vector(id);
+    if (_storage == FLOAT32)
+      return l2(query, reinterpret_cast<const float *>(code), _dim);
+    float scale;
+    std::memcpy(&scale, code, sizeof(float));
+    const int8_t *q = reinterpret_cast<const int8_t *>(code + sizeof(float));
+    float d = 0.0;
+    for (int i = 0; i < _dim; ++i)
+      {
+        float diff = query[i] - q[i] * scale;
+        d += diff * diff;
+      }
+    return d;
+  }
+
+  int HNSWIndex::random_level()
+  {
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    return static_cast<int>(-std::log(1.0 - u(_rng)) * _level_mult);
+  }
+
+  void HNSWIndex::reserve(const int &capacity)
+  {
+    _level0_buf.resize(capacity * _rec_size);
+    _level0 = _level0_buf.data();
+    _upper.resize(capacity);
+    _node_mutexes.reset(new std::mutex[capacity]);
+    _capacity = capacity;
+  }
+
+  void HNSWIndex::make_writable()
+  {
+    if (!_mapped)
+      return;
+    _level0_buf.assign(_level0, _level0 + _count * _rec_size);
+    _level0 = _level0_buf.data();
+    _mapped.reset();
+  }
+
+  int HNSWIndex::add(const float *vecs, const int &n)
+  {
+    int first = 0;
+    {
+      // records are allocated and filled first, links are built next
+      boost::unique_lock<boost::shared_mutex> lock(_resize_mutex);
+      make_writable();
+      if (_count + n > _capacity)
+        reserve(std::max(_count + n, 2 * _capacity));
+      first = _count;
+      for (int i = 0; i < n; ++i)
+        {
+          int id = first + i;
+          std::memset(links0(id), 0, _rec_size);
+          encode(vecs + static_cast<size_t>(i) * _dim, node_vector(id));
+          int level = random_level();
+          node_level(id) = level;
+          _upper[id].assign(level * (1 + _M), 0);
+        }
+      _count += n;
+    }
+
+    boost::shared_lock<boost::shared_mutex> lock(_resize_mutex);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < n; ++i)
+      insert(first + i);
+    return first;
+  }
+
+  void HNSWIndex::insert(const int &id)
+  {
+    int level = node_level(id);
+    std::unique_lock<std::mutex> entry_lock(_entry_mutex);
+    int entry = _entry;
+    int max_level = _max_level;
+    if (entry == -1)
+      {
+        _entry = id;
+        _max_level = level;
+        return;
+      }
+    // the entry point lock is only kept when this node becomes the new
+    // entry point
+    if (level <= max_level)
+      entry_lock.unlock();
+
+    std::vector<float> vec(_dim);
+    decode(id, vec.data());
+    int cur = entry;
+    if (level < max_level)
+      cur = greedy_search(vec.data(), cur, max_level, level + 1);
+    for (int l = std::min(level, max_level); l >= 0; --l)
+      {
+        std::vector<DistId> candidates
+            = search_level(vec.data(), cur, _ef_construction, l, false);
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [id](const DistId &c) {
+                                          return c.second == id;
+                                        }),
+                         candidates.end());
+        if (candidates.empty())
+          continue;
+        std::vector<DistId> neighbors = select_neighbors(candidates, _M);
+        {
+          std::lock_guard<std::mutex> lock(_node_mutexes[id]);
+          int *lk = links(id, l);
+          lk[0] = neighbors.size();
+          for (size_t j = 0; j < neighbors.size(); ++j)
+            lk[1 + j] = neighbors[j].second;
+        }
+        for (const DistId &nb : neighbors)
+          connect(nb.second, id, nb.first, l);
+        cur = candidates.front().second;
+      }
+
+    if (level > max_level)
+      {
+        _max_level = level;
+        _entry = id;
+      }
+  }
+
+  void HNSWIndex::connect(const int &id, const int &neighbor,
+                          const float &dist, const int &level)
+  {
+    std::lock_guard<std::mutex> lock(_node_mutexes[id]);
+    int *lk = links(id, level);
+    int max_links = level == 0 ? _M0 : _M;
+    if (lk[0] < max_links)
+      {
+        lk[1 + lk[0]] = neighbor;
+        ++lk[0];
+        return;
+      }
+
+    // full, the new link competes with the existing ones
+    std::vector<float> vec(_dim);
+    decode(id, vec.data());
+    std::vector<DistId> candidates;
+    candidates.emplace_back(dist, neighbor);
+    for (int j = 0; j < lk[0]; ++j)
+      candidates.emplace_back(distance(vec.data(), lk[1 + j]), lk[1 + j]);
+    std::sort(candidates.begin(), candidates.end());
+    std::vector<DistId> selected = select_neighbors(candidates, max_links);
+    lk[0] = selected.size();
+    for (size_t j = 0; j < selected.size(); ++j)
+      lk[1 + j] = selected[j].second;
+  }
+
+  std::vector<DistId>
+  HNSWIndex::select_neighbors(const std::vector<DistId> &candidates,
+                              const int &M) const
+  {
+    if (static_cast<int>(candidates.size()) <= M)
+      return candidates;
+    // a candidate is kept if it is closer to the node than to any kept
+    // candidate, which spreads links across directions
+    std::vector<DistId> selected;
+    std::vector<float> vec(_dim);
+    for (const DistId &c : candidates)
+      {
+        decode(c.second, vec.data());
+        bool keep = true;
+        for (const DistId &s : selected)
+          if (distance(vec.data(), s.second) < c.first)
+            {
+              keep = false;
+              break;
+            }
+        if (keep)
+          {
+            selected.push_back(c);
+            if (static_cast<int>(selected.size()) >= M)
+              break;
+          }
+      }
+    return selected;
+  }
+
+  int HNSWIndex::greedy_search(const float *query, int entry,
+                               const int &from_level,
+                               const int &to_level) const
+  {
+    float dist = distance(query, entry);
+    std::vector<int> nbrs;
+    for (int l = from_level; l >= to_level; --l)
+      {
+        bool changed = true;
+        while (changed)
+          {
+            changed = false;
+            {
+              std::lock_guard<std::mutex> lock(_node_mutexes[entry]);
+              int *lk = links(entry, l);
+              nbrs.assign(lk + 1, lk + 1 + lk[0]);
+            }
+            for (int n : nbrs)
+              {
+                float d = distance(query, n);
+                if (d < dist)
+                  {
+                    dist = d;
+                    entry = n;
+                    changed = true;
+                  }
+              }
+          }
+      }
+    return entry;
+  }
+
+  std::vector<DistId> HNSWIndex::search_level(const float *query,
+                                              const int &entry, const int &ef,
+                                              const int &level,
+                                              const bool &skip_removed) const
+  {
+    visited.reset(_count);
+    std::priority_queue<DistId, std::vector<DistId>, std::greater<DistId>>
+        candidates; // closest first
+    std::priority_queue<DistId> results; // farthest first
+
+    float d = distance(query, entry);
+    visited.visit(entry);
+    candidates.emplace(d, entry);
+    if (!skip_removed || !removed(entry))
+      results.emplace(d, entry);
+    float bound = results.empty() ? std::numeric_limits<float>::max() : d;
+
+    std::vector<int> nbrs;
+    while (!candidates.empty())
+      {
+        DistId c = candidates.top();
+        if (c.first > bound && static_cast<int>(results.size()) >= ef)
+          break;
+        candidates.pop();
+        {
+          std::lock_guard<std::mutex> lock(_node_mutexes[c.second]);
+          int *lk = links(c.second, level);
+          nbrs.assign(lk + 1, lk + 1 + lk[0]);
+        }
+        for (int n : nbrs)
+          {
+            if (!visited.visit(n))
+              continue;
+            float dn = distance(query, n);
+            if (static_cast<int>(results.size()) < ef || dn < bound)
+              {
+                candidates.emplace(dn, n);
+                if (!skip_removed || !removed(n))
+                  {
+                    results.emplace(dn, n);
+                    if (static_cast<int>(results.size()) > ef)
+                      results.pop();
+                  }
+                if (!results.empty())
+                  bound = results.top().first;
+              }
+          }
+      }
+
+    std::vector<DistId> out(results.size());
+    for (int i = results.size() - 1; i >= 0; --i)
+      {
+        out[i] = results.top();
+        results.pop();
+      }
+    return out;
+  }
+
+  std::vector<DistId> HNSWIndex::search(const float *query, const int &k,
+                                        const int &ef) const
+  {
+    boost::shared_lock<boost::shared_mutex> lock(_resize_mutex);
+    int entry = _entry;
+    if (entry == -1)
+      return std::vector<DistId>();
+    entry = greedy_search(query, entry, node_level(entry), 1);
+    std::vector<DistId> out
+        = search_level(query, entry, std::max(ef, k), 0, true);
+    if (static_cast<int>(out.size()) > k)
+      out.resize(k);
+    return out;
+  }
+
+  void HNSWIndex::remove(const int &id)
+  {
+    boost::unique_lock<boost::shared_mutex> lock(_resize_mutex);
+    if (id < 0 || id >= _count)
+      return;
+    make_writable();
+    node_flags(id) |= 1;
+  }
+
+  bool HNSWIndex::removed(const int &id) const
+  {
+    return node_flags(id) & 1;
+  }
+
+  bool HNSWIndex::save(const std::string &path)
+  {
+    boost::unique_lock<boost::shared_mutex> lock(_resize_mutex);
+    HNSWHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h._magic, hnsw_magic, sizeof(h._magic));
+    h._version = hnsw_version;
+    h._dim = _dim;
+    h._M = _M;
+    h._ef_construction = _ef_construction;
+    h._storage = _storage;
+    h._count = _count;
+    h._entry = _entry;
+    h._max_level = _max_level;
+
+    std::string tmp_path = path + ".tmp";
+    {
+      std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+      out.write(_level0, _count * _rec_size);
+      for (int id = 0; id < _count; ++id)
+        out.write(reinterpret_cast<const char *>(_upper[id].data()),
+                  _upper[id].size() * sizeof(int));
+      if (!out.good())
+        return false;
+    }
+    // a mapping of the previous file remains valid after the rename
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+  }
+
+  std::unique_ptr<HNSWIndex> HNSWIndex::load(const std::string &path,
+                                             const bool &mmap)
+  {
+    // graph searches read records at random
+    std::unique_ptr<MappedFile> file(new MappedFile(path, false));
+    if (!file->is_open() || file->size() < sizeof(HNSWHeader))
+      return nullptr;
+    HNSWHeader h;
+    std::memcpy(&h, file->data(), sizeof(h));
+    if (std::memcmp(h._magic, hnsw_magic, sizeof(h._magic)) != 0
+        || h._version != hnsw_version)
+      return nullptr;
+
+    std::unique_ptr<HNSWIndex> index(new HNSWIndex(
+        h._dim, h._M, h._ef_construction, static_cast<Storage>(h._storage)));
+    size_t level0_size = h._count * index->_rec_size;
+    if (file->size() < sizeof(h) + level0_size)
+      return nullptr;
+    const char *level0 = file->data() + sizeof(h);
+    const char *p = level0 + level0_size;
+    const char *end = file->data() + file->size();
+
+    if (mmap)
+      {
+        index->_level0 = const_cast<char *>(level0);
+        index->_upper.resize(h._count);
+        index->_node_mutexes.reset(new std::mutex[h._count]);
+        index->_capacity = h._count;
+      }
+    else
+      {
+        index->reserve(h._count);
+        std::memcpy(index->_level0, level0, level0_size);
+      }
+    index->_count = h._count;
+    index->_entry = h._entry;
+    index->_max_level = h._max_level;
+
+    for (int id = 0; id < h._count; ++id)
+      {
+        size_t n = index->node_level(id) * (1 + h._M);
+        if (p + n * sizeof(int) > end)
+          return nullptr;
+        index->_upper[id].resize(n);
+        std::memcpy(index->_upper[id].data(), p, n * sizeof(int));
+        p += n * sizeof(int);
+      }
+
+    if (mmap)
+      index->_mapped = std::move(file);
+    return index;
+  }
+}
@@ -0,0 +1,207 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "utils/mapped_file.hpp"
+
+namespace dd
+{
+  /**
+   * \brief Hierarchical Navigable Small World graph index, L2 distance.
+   *
+   * Vectors get consecutive ids in insertion order. Inserts run
+   * concurrently with each other and with searches, removals are
+   * tombstones: removed vectors still route searches but are never
+   * returned. The saved layout stores fixed-size level 0 records that are
+   * searched in place from a memory mapping.
+   */
+  class HNSWIndex
+  {
+  public:
+    /**
+     * \brief vector storage
+     */
+    enum Storage
+    {
+      FLOAT32 = 0,
+      INT8 = 1 /**< per-vector scaled 8-bit codes. */
+    };
+
+    /**
+     * \brief empty index
+     * @param dim vector length
+     * @param M max links per node on upper levels, twice as many on level 0
+     * @param ef_construction candidate list size when inserting
+     * @param storage vector storage
+     */
+    HNSWIndex(const int &dim, const int &M = 16,
+              const int &ef_construction = 200,
+              const Storage &storage = FLOAT32);
+
+    ~HNSWIndex();
+
+    HNSWIndex(const HNSWIndex &) = delete;
+    HNSWIndex &operator=(const HNSWIndex &) = delete;
+
+    /**
+     * \brief inserts vectors, in parallel
+     * @param vecs n x dim row-major vectors
+     * @param n number of vectors
+     * @return id of the first inserted vector
+     */
+    int add(const float *vecs, const int &n);
+
+    /**
+     * \brief k nearest neighbors
+     * @param query dim-long query vector
+     * @param k number of neighbors
+     * @param ef candidate list size, larger values increase recall
+     * @return (squared L2 distance, id) pairs, closest first
+     */
+    std::vector<std::pair<float, int>> search(const float *query, const int &k,
+                                              const int &ef) const;
+
+    /**
+     * \brief marks a vector as removed, it is no longer returned by
+     *        searches
+     */
+    void remove(const int &id);
+
+    /** Whether a vector has been removed */
+    bool removed(const int &id) const;
+
+    /** Number of vectors, removed ones included */
+    int size() const
+    {
+      return _count;
+    }
+
+    int dim() const
+    {
+      return _dim;
+    }
+
+    /**
+     * \brief saves the index, written aside then renamed
+     * @return false if the file cannot be written
+     */
+    bool save(const std::string &path);
+
+    /**
+     * \brief loads an index saved with save()
+     * @param path index file
+     * @param mmap searches level 0 in place from the file mapping, it is
+     *        copied to memory on the first insertion or removal
+     * @return the index, nullptr if the file cannot be read
+     */
+    static std::unique_ptr<HNSWIndex> load(const std::string &path,
+                                           const bool &mmap = true);
+
+  private:
+    // level 0 record: [nlinks][links x _M0][level][flags][vector]
+    int *links0(const int &id) const
+    {
+      return reinterpret_cast<int *>(_level0 + id * _rec_size);
+    }
+
+    int *links(const int &id, const int &level) const;
+
+    int &node_level(const int &id) const
+    {
+      return links0(id)[1 + _M0];
+    }
+
+    uint32_t &node_flags(const int &id) const
+    {
+      return reinterpret_cast<uint32_t *>(links0(id))[2 + _M0];
+    }
+
+    char *node_vector(const int &id) const
+    {
+      return _level0 + id * _rec_size + _vec_offset;
+    }
+
+    void encode(const float *vec, char *code) const;
+
+    void decode(const int &id, float *vec) const;
+
+    float distance(const float *query, const int &id) const;
+
+    int random_level();
+
+    void reserve(const int &capacity);
+
+    void make_writable();
+
+    void insert(const int &id);
+
+    /** closest first */
+    std::vector<std::pair<float, int>>
+    search_level(const float *query, const int &entry, const int &ef,
+                 const int &level, const bool &skip_removed) const;
+
+    int greedy_search(const float *query, int entry, const int &from_level,
+                      const int &to_level) const;
+
+    std::vector<std::pair<float, int>>
+    select_neighbors(const std::vector<std::pair<float, int>> &candidates,
+                     const int &M) const;
+
+    void connect(const int &id, const int &neighbor, const float &dist,
+                 const int &level);
+
+    int _dim;
+    int _M;  /**< max links per node, upper levels. */
+    int _M0; /**< max links per node, level 0. */
+    int _ef_construction;
+    Storage _storage;
+    double _level_mult;   /**< 1/ln(M), level distribution. */
+    size_t _vec_offset;   /**< vector offset in level 0 records. */
+    size_t _rec_size;     /**< level 0 record size. */
+    int _count = 0;       /**< number of vectors. */
+    int _capacity = 0;    /**< number of allocated records. */
+    std::atomic<int> _entry = { -1 }; /**< entry point id. */
+    int _max_level = -1;  /**< entry point level. */
+    char *_level0 = nullptr; /**< level 0 records. */
+    std::vector<char> _level0_buf; /**< level 0 records, when not mapped. */
+    std::unique_ptr<MappedFile> _mapped; /**< level 0 mapping, if any. */
+    std::vector<std::vector<int>>
+        _upper; /**< per node, upper levels links as [nlinks][links x _M]. */
+    std::unique_ptr<std::mutex[]> _node_mutexes; /**< per node links. */
+    mutable boost::shared_mutex
+        _resize_mutex; /**< exclusive on reallocation. */
+    std::mutex _entry_mutex; /**< guards the entry point and max level. */
+    std::mt19937 _rng;
+  };
+}
+
+#endif
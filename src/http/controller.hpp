@@ -98,6 +98,18 @@ public:
     return createDtoResponse(Status::CODE_200, info_resp);
   }
 
+  ENDPOINT_INFO(get_metrics)
+  {
+    info->summary = "Retrieve services metrics in Prometheus text format";
+    info->addResponse<String>(Status::CODE_200, "text/plain");
+  }
+  ENDPOINT("GET", "metrics", get_metrics)
+  {
+    auto response = createResponse(Status::CODE_200, _oja->metrics());
+    response->putHeader(Header::CONTENT_TYPE, "text/plain; version=0.0.4");
+    return response;
+  }
+
   ENDPOINT_INFO(get_service)
   {
     info->summary = "Retrieve a service detail";
@@ -186,6 +198,19 @@ public:
     return _oja->jdoc_to_response(janswer);
   }
 
+  ENDPOINT_INFO(predict_binary)
+  {
+    info->summary = "Predict from binary data: a \"call\" part with the "
+                    "JSON call, and one part per encoded image or raw pixels";
+    info->addConsumes<String>("multipart/form-data");
+  }
+  ENDPOINT("POST", "predict/binary", predict_binary,
+           REQUEST(std::shared_ptr<IncomingRequest>, request))
+  {
+    auto janswer = _oja->service_predict_multipart(request);
+    return _oja->jdoc_to_response(janswer);
+  }
+
   ENDPOINT_INFO(get_train)
   {
     info->summary = "Retrieve a training status";
@@ -346,8 +371,28 @@ public:
            PATH(oatpp::String, stream_name, "stream-name"),
            BODY_DTO(Object<dd::DTO::Stream>, stream_data))
   {
-    return createDtoResponse(Status::CODE_201,
-                             _oja->create_stream(stream_name, stream_data));
+    try
+      {
+        return _oja->dto_to_response(
+            _oja->create_stream(stream_name, stream_data), 201, "Created");
+      }
+    catch (dd::StreamBadParamException &e)
+      {
+        return _oja->response_bad_request_400(e.what());
+      }
+    catch (dd::ResourceNotFoundException &e)
+      {
+        return _oja->response_bad_request_400(e.what());
+      }
+    catch (dd::StreamForbiddenException &e)
+      {
+        return _oja->response_stream_already_exists_1017();
+      }
+    catch (std::exception &e)
+      {
+        return _oja->response_internal_error_500(e.what());
+      }
+    return _oja->response_internal_error_500();
   }
 
   ENDPOINT_INFO(get_stream_info)
@@ -359,7 +404,20 @@ public:
   ENDPOINT("GET", "stream/{stream-name}", get_stream_info,
            PATH(oatpp::String, stream_name, "stream-name"))
   {
-    return _oja->dto_to_response(_oja->get_stream_info(stream_name), 200, "");
+    try
+      {
+        return _oja->dto_to_response(_oja->get_stream_info(stream_name), 200,
+                                     "OK");
+      }
+    catch (dd::StreamNotFoundException &e)
+      {
+        return _oja->response_not_found_404();
+      }
+    catch (std::exception &e)
+      {
+        return _oja->response_internal_error_500(e.what());
+      }
+    return _oja->response_internal_error_500();
   }
 
   ENDPOINT_INFO(delete_stream)
@@ -371,9 +429,21 @@ public:
   ENDPOINT("DELETE", "stream/{stream-name}", delete_stream,
            PATH(oatpp::String, stream_name, "stream-name"))
   {
-    int status = _oja->delete_stream(stream_name);
-    return _oja->dto_to_response(dd::DTO::GenericResponse::createShared(),
-                                 status, "");
+    try
+      {
+        int status = _oja->delete_stream(stream_name);
+        return _oja->dto_to_response(dd::DTO::GenericResponse::createShared(),
+                                     status, "OK");
+      }
+    catch (dd::StreamNotFoundException &e)
+      {
+        return _oja->response_not_found_404();
+      }
+    catch (std::exception &e)
+      {
+        return _oja->response_internal_error_500(e.what());
+      }
+    return _oja->response_internal_error_500();
   }
 };
 
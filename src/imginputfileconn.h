@@ -105,8 +105,12 @@ namespace dd
               if (_width < 0 && _height < 0)
                 {
                   // Do nothing and keep native resolution. May cause issues if
-                  // batched images are different resolutions
-                  dst = src;
+                  // batched images are different resolutions. Shared or
+                  // external buffers, e.g. chain crops, even of the whole
+                  // frame, are copied since color adjustments below run in
+                  // place
+                  bool shared = !src.u || src.u->refcount > 1;
+                  dst = shared ? src.clone() : src;
                 }
               else
                 {
@@ -204,8 +208,10 @@ namespace dd
               if (_width < 0 && _height < 0)
                 {
                   // Do nothing and keep native resolution. May cause issues if
-                  // batched images are different resolutions
-                  dst = src;
+                  // batched images are different resolutions. Shared or
+                  // external buffers are copied, as on CPU
+                  bool shared = !src.refcount || *src.refcount > 1;
+                  dst = shared ? src.clone() : src;
                 }
               else
                 {
@@ -370,29 +376,16 @@ namespace dd
     // decode image
     void decode(const std::string &str)
     {
-      std::vector<unsigned char> vdat(str.begin(), str.end());
+      // the encoded buffer is wrapped, not copied
       cv::Mat img = cv::Mat(cv::imdecode(
-          cv::Mat(vdat, false),
+          cv::Mat(1, static_cast<int>(str.size()), CV_8UC1,
+                  const_cast<char *>(str.data())),
           _unchanged_data
               ? CV_LOAD_IMAGE_UNCHANGED
               : (_bw ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR)));
       add_image(img, "base64 image");
     }
 
-    // deserialize image, independent of format
-    void deserialize(std::stringstream &input)
-    {
-      size_t size = 0;
-      input.seekg(0, input.end);
-      size = input.tellg();
-      input.seekg(0, input.beg);
-      char *data = new char[size];
-      input.read(data, size);
-      std::string str(data, data + size);
-      delete[] data;
-      decode(str);
-    }
-
     // data acquisition
     int read_file(const std::string &fname, int test_id)
     {
@@ -419,9 +412,7 @@ namespace dd
         {
           std::string ccontent;
           Base64::Decode(content, &ccontent);
-          std::stringstream sstr;
-          sstr << ccontent;
-          deserialize(sstr);
+          decode(ccontent);
         }
       else
         {
@@ -897,18 +888,19 @@ namespace dd
         {
           return;
         }
-      int catch_read = 0;
-      std::string catch_msg;
-      std::vector<std::string> uris;
-      std::vector<std::string> meta_uris;
-      std::vector<std::string> index_uris;
-      std::vector<std::string> failed_uris;
-#pragma omp parallel for
-      for (size_t i = 0; i < _uris.size(); i++)
+      // every uri is decoded into its own slot, so that decoding runs
+      // without synchronization and results keep the input order
+      size_t nuris = _uris.size();
+      std::vector<std::unique_ptr<DataEl<DDImg>>> dimgs(nuris);
+      std::vector<std::string> read_errors(nuris);
+      std::vector<char> read_failed(nuris, 0);
+      std::vector<char> no_imgs(nuris, 0);
+#pragma omp parallel for schedule(dynamic)
+      for (size_t i = 0; i < nuris; i++)
         {
-          bool no_img = false;
-          std::string u = _uris.at(i);
-          DataEl<DDImg> dimg(this->_input_timeout);
+          const std::string &u = _uris.at(i);
+          dimgs[i].reset(new DataEl<DDImg>(this->_input_timeout));
+          DataEl<DDImg> &dimg = *dimgs[i];
           copy_parameters_to(dimg._ctype);
 
           try
@@ -916,81 +908,92 @@ namespace dd
               if (dimg.read_element(u, this->_logger))
                 {
                   _logger->error("no data for image {}", u);
-                  no_img = true;
+                  no_imgs[i] = 1;
                 }
-              if (!dimg._ctype._db_fname.empty())
-                _db_fname = dimg._ctype._db_fname;
             }
           catch (std::exception &e)
             {
-#pragma omp critical
-              {
-                ++catch_read;
-                catch_msg = e.what();
-                failed_uris.push_back(u);
-                no_img = true;
-              }
+              read_errors[i] = e.what();
+              read_failed[i] = 1;
+              no_imgs[i] = 1;
             }
-          if (no_img)
-            continue;
-          if (!_db_fname.empty())
-            continue;
+        }
 
-#pragma omp critical
-          {
+      int catch_read = 0;
+      std::string catch_msg;
+      std::vector<std::string> failed_uris;
+      for (size_t i = 0; i < nuris; i++)
+        {
+          if (read_failed[i])
+            {
+              if (!catch_read++)
+                catch_msg = read_errors[i];
+              failed_uris.push_back(_uris.at(i));
+            }
+          else if (!dimgs[i]->_ctype._db_fname.empty())
+            _db_fname = dimgs[i]->_ctype._db_fname;
+        }
+
+      std::vector<std::string> uris;
+      std::vector<std::string> meta_uris;
+      std::vector<std::string> index_uris;
+      for (size_t i = 0; i < nuris && !catch_read && _db_fname.empty(); i++)
+        {
+          if (no_imgs[i])
+            continue;
+          const std::string &u = _uris.at(i);
+          DataEl<DDImg> &dimg = *dimgs[i];
 #ifdef USE_CUDA_CV
-            if (_cuda)
-              {
-                _cuda_images.insert(
-                    _cuda_images.end(),
-                    std::make_move_iterator(dimg._ctype._cuda_imgs.begin()),
-                    std::make_move_iterator(dimg._ctype._cuda_imgs.end()));
-                _cuda_orig_images.insert(
-                    _cuda_orig_images.end(),
-                    std::make_move_iterator(
-                        dimg._ctype._cuda_orig_imgs.begin()),
-                    std::make_move_iterator(
-                        dimg._ctype._cuda_orig_imgs.end()));
-              }
-            else
+          if (_cuda)
+            {
+              _cuda_images.insert(
+                  _cuda_images.end(),
+                  std::make_move_iterator(dimg._ctype._cuda_imgs.begin()),
+                  std::make_move_iterator(dimg._ctype._cuda_imgs.end()));
+              _cuda_orig_images.insert(
+                  _cuda_orig_images.end(),
+                  std::make_move_iterator(dimg._ctype._cuda_orig_imgs.begin()),
+                  std::make_move_iterator(dimg._ctype._cuda_orig_imgs.end()));
+            }
+          else
 #endif
-              {
-                _images.insert(
-                    _images.end(),
-                    std::make_move_iterator(dimg._ctype._imgs.begin()),
-                    std::make_move_iterator(dimg._ctype._imgs.end()));
-                if (_keep_orig)
-                  _orig_images.insert(
-                      _orig_images.end(),
-                      std::make_move_iterator(dimg._ctype._orig_imgs.begin()),
-                      std::make_move_iterator(dimg._ctype._orig_imgs.end()));
-              }
-
-            _images_size.insert(
-                _images_size.end(),
-                std::make_move_iterator(dimg._ctype._imgs_size.begin()),
-                std::make_move_iterator(dimg._ctype._imgs_size.end()));
-            if (!dimg._ctype._labels.empty())
-              _test_labels.insert(
-                  _test_labels.end(),
-                  std::make_move_iterator(dimg._ctype._labels.begin()),
-                  std::make_move_iterator(dimg._ctype._labels.end()));
-            if (!_ids.empty())
-              uris.push_back(_ids.at(i));
-            else if (!dimg._ctype._b64 && dimg._ctype._imgs.size() == 1)
-              uris.push_back(u);
-            else if (!dimg._ctype._img_files.empty())
-              uris.insert(
-                  uris.end(),
-                  std::make_move_iterator(dimg._ctype._img_files.begin()),
-                  std::make_move_iterator(dimg._ctype._img_files.end()));
-            else
-              uris.push_back(std::to_string(i));
-            if (!_meta_uris.empty())
-              meta_uris.push_back(_meta_uris.at(i));
-            if (!_index_uris.empty())
-              index_uris.push_back(_index_uris.at(i));
-          }
+            {
+              _images.insert(
+                  _images.end(),
+                  std::make_move_iterator(dimg._ctype._imgs.begin()),
+                  std::make_move_iterator(dimg._ctype._imgs.end()));
+              if (_keep_orig)
+                _orig_images.insert(
+                    _orig_images.end(),
+                    std::make_move_iterator(dimg._ctype._orig_imgs.begin()),
+                    std::make_move_iterator(dimg._ctype._orig_imgs.end()));
+            }
+
+          _images_size.insert(
+              _images_size.end(),
+              std::make_move_iterator(dimg._ctype._imgs_size.begin()),
+              std::make_move_iterator(dimg._ctype._imgs_size.end()));
+          if (!dimg._ctype._labels.empty())
+            _test_labels.insert(
+                _test_labels.end(),
+                std::make_move_iterator(dimg._ctype._labels.begin()),
+                std::make_move_iterator(dimg._ctype._labels.end()));
+          if (!_ids.empty())
+            uris.push_back(_ids.at(i));
+          else if (!dimg._ctype._b64 && dimg._ctype._imgs.size() == 1)
+            uris.push_back(u);
+          else if (!dimg._ctype._img_files.empty())
+            uris.insert(
+                uris.end(),
+                std::make_move_iterator(dimg._ctype._img_files.begin()),
+                std::make_move_iterator(dimg._ctype._img_files.end()));
+          else
+            uris.push_back(std::to_string(i));
+          if (!_meta_uris.empty())
+            meta_uris.push_back(_meta_uris.at(i));
+          if (!_index_uris.empty())
+            index_uris.push_back(_index_uris.at(i));
+          dimgs[i].reset();
         }
       if (catch_read)
         {
@@ -999,8 +1002,8 @@ namespace dd
           throw InputConnectorBadParamException(catch_msg);
         }
       _uris = uris;
-      _ids = _uris; // since uris may be in different order than before
-                    // transform
+      _ids = _uris; // a single uri may expand into several images, e.g.
+                    // a directory
       _meta_uris = meta_uris;
       _index_uris = index_uris;
       if (!_db_fname.empty())
@@ -1030,6 +1030,14 @@ namespace dd
   }
 
   JDoc JsonAPI::service_predict(const std::string &jstr)
+  {
+    return service_predict(jstr, std::vector<cv::Mat>(),
+                           std::vector<std::string>());
+  }
+
+  JDoc JsonAPI::service_predict(const std::string &jstr,
+                                const std::vector<cv::Mat> &imgs,
+                                const std::vector<std::string> &ids)
   {
     rapidjson::Document d;
     d.Parse<rapidjson::kParseNanAndInfFlag>(jstr.c_str());
@@ -1068,6 +1076,12 @@ namespace dd
       {
         return dd_bad_request_400();
       }
+    if (!imgs.empty())
+      {
+        ad_data.erase("data");
+        ad_data.add("data_raw_img", imgs);
+        ad_data.add("ids", ids);
+      }
 
     // prediction
     oatpp::Object<DTO::PredictBody> pred_dto;
@@ -1535,6 +1549,10 @@ namespace dd
       {
         return dd_action_internal_error_1013(e.what());
       }
+    catch (ChainBadParamException &e)
+      {
+        return dd_bad_request_400(e.what());
+      }
     catch (std::exception &e)
       {
         return dd_internal_mllib_error_1007(e.what());
@@ -1551,6 +1569,8 @@ namespace dd
     if (jout.HasMember("predictions"))
       jbody.AddMember("predictions", jout["predictions"],
                       jpred.GetAllocator());
+    if (jout.HasMember("calls_time"))
+      jbody.AddMember("calls_time", jout["calls_time"], jpred.GetAllocator());
     jpred.AddMember("body", jbody, jpred.GetAllocator());
     return jpred;
   }
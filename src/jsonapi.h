@@ -101,6 +101,17 @@ namespace dd
     JDoc service_delete(const std::string &sname, const std::string &jstr);
     JDoc service_predict(const std::string &jstr);
 
+    /**
+     * \brief prediction on images that are already decoded, e.g. from a
+     *        binary upload
+     * @param jstr JSON predict call, data are ignored
+     * @param imgs decoded images
+     * @param ids image ids, returned as prediction uris
+     */
+    JDoc service_predict(const std::string &jstr,
+                         const std::vector<cv::Mat> &imgs,
+                         const std::vector<std::string> &ids);
+
     JDoc service_train(const std::string &jstr);
     JDoc service_train_status(const std::string &jstr);
     JDoc service_train_delete(const std::string &jstr);
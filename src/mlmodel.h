@@ -123,6 +123,15 @@ namespace dd
           _se = new SearchEngine<AnnoySE>(dim, _repo);
           _se->_tse->_map_populate = _index_preload;
 #endif
+#ifdef USE_HNSW
+          _se = new SearchEngine<HnswSE>(dim, _repo);
+          if (output_params->index_type != nullptr)
+            _se->_tse->_index_key = output_params->index_type;
+          if (output_params->ondisk != nullptr)
+            _se->_tse->_ondisk = output_params->ondisk;
+          if (output_params->nprobe != nullptr)
+            _se->_tse->_nprobe = output_params->nprobe;
+#endif
 #ifdef USE_FAISS
           _se = new SearchEngine<FaissSE>(dim, _repo);
           if (output_params->index_type != nullptr)
@@ -185,6 +194,8 @@ namespace dd
 #ifdef USE_SIMSEARCH
 #ifdef USE_ANNOY
     SearchEngine<AnnoySE> *_se = nullptr;
+#elif USE_HNSW
+    SearchEngine<HnswSE> *_se = nullptr;
 #elif USE_FAISS
     SearchEngine<FaissSE> *_se = nullptr;
 #endif
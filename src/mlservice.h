@@ -36,10 +36,13 @@
 #include <unordered_map>
 #include <chrono>
 #include <iostream>
+#include <condition_variable>
+#include <vector>
 
 #include "mllibstrategy.h"
 #include "mlmodel.h"
 #include "outputconnectorstrategy.h"
+#include "predict_cache.h"
 #include "dto/info.hpp"
 
 namespace dd
@@ -117,6 +120,24 @@ namespace dd
       this->_logger = DD_SPDLOG_LOGGER(_sname);
     }
 
+    /**
+     * \brief predict worker replica creation, shares the service logger
+     * @param sname service name
+     * @param mlmodel model object
+     * @param description optional string
+     * @param logger service logger
+     */
+    MLService(const std::string &sname, const TMLModel &mlmodel,
+              const std::string &description,
+              const std::shared_ptr<spdlog::logger> &logger)
+        : TMLLib<TInputConnectorStrategy, TOutputConnectorStrategy, TMLModel>(
+            mlmodel),
+          _sname(sname), _description(description), _tjobs_counter(0),
+          _replica(true)
+    {
+      this->_logger = logger;
+    }
+
     /**
      * \brief move-constructor
      * @param mls ML service
@@ -128,8 +149,14 @@ namespace dd
           _description(std::move(mls._description)),
           _init_parameters(std::move(mls._init_parameters)),
           _tjobs_counter(mls._tjobs_counter.load()),
-          _training_jobs(std::move(mls._training_jobs))
+          _training_jobs(std::move(mls._training_jobs)),
+          _replica(mls._replica), _init_ad(std::move(mls._init_ad)),
+          _predict_workers(std::move(mls._predict_workers)),
+          _predict_workers_busy(std::move(mls._predict_workers_busy)),
+          _predict_cache(std::move(mls._predict_cache))
     {
+      for (auto &worker : _predict_workers)
+        worker->_stats._parent = &this->_stats;
     }
 
     /**
@@ -138,7 +165,8 @@ namespace dd
     ~MLService()
     {
       kill_jobs();
-      spdlog::drop(_sname);
+      if (!_replica)
+        spdlog::drop(_sname);
     }
 
     /**
@@ -162,6 +190,78 @@ namespace dd
       this->_outputc.init(_init_parameters.getobj("output"));
       this->init_mllib(_init_parameters.getobj("mllib"));
       this->fillup_measures_history(ad);
+
+      APIData ad_mllib = _init_parameters.getobj("mllib");
+      if (!_replica && ad_mllib.has("predict_workers"))
+        {
+          int nworkers = ad_mllib.get("predict_workers").get<int>();
+          if (nworkers <= 0)
+            throw MLLibBadParamException(
+                "predict_workers must be strictly positive");
+          if (nworkers > 1)
+            {
+              _init_ad = ad;
+              init_predict_workers(nworkers);
+            }
+        }
+      if (!_replica && ad_mllib.has("predict_cache"))
+        {
+          APIData ad_cache = ad_mllib.getobj("predict_cache");
+          int max_size_mb = 64;
+          if (ad_cache.has("max_size_mb"))
+            max_size_mb = ad_cache.get("max_size_mb").get<int>();
+          if (max_size_mb <= 0)
+            throw MLLibBadParamException(
+                "predict_cache requires max_size_mb > 0");
+          _predict_cache.reset(new PredictCache(
+              static_cast<size_t>(max_size_mb) * 1024 * 1024));
+          this->_logger->info("predict cache: max_size_mb={}", max_size_mb);
+        }
+    }
+
+    /**
+     * \brief creates the predict worker replicas, each replica is an
+     *        independent instance of the model, so that concurrent predict
+     *        calls on the service do not contend on a single backend object.
+     *        The service itself acts as the first worker.
+     * @param nworkers total number of predict workers
+     */
+    void init_predict_workers(const int &nworkers)
+    {
+      std::vector<std::unique_ptr<MLService>> workers;
+      for (int w = 1; w < nworkers; ++w)
+        {
+          std::unique_ptr<MLService> mls(new MLService(
+              _sname, this->_mlmodel, _description, this->_logger));
+          mls->init(_init_ad);
+          mls->_stats._parent = &this->_stats;
+          workers.push_back(std::move(mls));
+        }
+      std::unique_ptr<std::atomic<bool>[]> busy(
+          new std::atomic<bool>[nworkers]);
+      for (int w = 0; w < nworkers; ++w)
+        busy[w].store(false);
+
+      std::lock_guard<std::mutex> lock(_workers_mutex);
+      _predict_workers = std::move(workers);
+      _predict_workers_busy = std::move(busy);
+      this->_logger->info("predict workers: {}", nworkers);
+    }
+
+    /**
+     * \brief reloads the predict worker replicas from the repository,
+     *        e.g. after a training job has updated the model.
+     *        Requires the training lock.
+     */
+    void reload_predict_workers()
+    {
+      if (_predict_workers.empty())
+        return;
+      _predict_workers.clear();
+      init_predict_workers(_init_ad.getobj("parameters")
+                               .getobj("mllib")
+                               .get("predict_workers")
+                               .get<int>());
     }
 
     /**
@@ -326,6 +426,9 @@ namespace dd
                                    _train_mutex);
                                APIData out;
                                int run_code = this->train(ad, out);
+                               if (run_code == 0)
+                                 reload_predict_workers();
+                               clear_predict_cache();
                                std::pair<int, APIData> p(local_tcounter,
                                                          std::move(out));
                                _training_out.insert(std::move(p));
@@ -339,6 +442,9 @@ namespace dd
           boost::unique_lock<boost::shared_mutex> lock(_train_mutex);
           this->_has_predict = false;
           int status = this->train(ad, out);
+          if (status == 0)
+            reload_predict_workers();
+          clear_predict_cache();
           APIData ad_params_out = ad.getobj("parameters").getobj("output");
           if (ad_params_out.has("measure_hist")
               && ad_params_out.get("measure_hist").get<bool>())
@@ -502,6 +608,33 @@ namespace dd
         throw MLServiceLockException(
             "Predict call while training with an offline learning algorithm");
 
+      // outputs of identical calls are served from the cache
+      std::string cache_key;
+      if (_predict_cache)
+        {
+          try
+            {
+              if (PredictCache::cacheable(ad, chain))
+                cache_key = PredictCache::key(ad);
+            }
+          catch (...)
+            {
+              // malformed calls go through predict and get its error
+            }
+          if (!cache_key.empty())
+            {
+              oatpp::Object<DTO::PredictBody> cached
+                  = _predict_cache->get(cache_key);
+              if (cached)
+                {
+                  this->_stats.cache_hit();
+                  _train_mutex.unlock_shared();
+                  return cached;
+                }
+              this->_stats.cache_miss();
+            }
+        }
+
       this->_stats.predict_start();
 
       oatpp::Object<DTO::PredictBody> out = nullptr;
@@ -509,7 +642,10 @@ namespace dd
         {
           if (chain)
             const_cast<APIData &>(ad).add("chain", true);
-          out = this->predict(ad);
+          if (_predict_workers.empty())
+            out = this->predict(ad);
+          else
+            out = predict_on_worker(ad);
         }
       catch (std::exception &e)
         {
@@ -518,11 +654,93 @@ namespace dd
           throw;
         }
       this->_stats.predict_end(true);
+      if (!cache_key.empty())
+        _predict_cache->put(cache_key, out);
 
       _train_mutex.unlock_shared();
       return out;
     }
 
+    /**
+     * \brief drops cached predict outputs, e.g. once a training job has
+     *        updated the model
+     */
+    void clear_predict_cache()
+    {
+      if (_predict_cache)
+        _predict_cache->clear();
+    }
+
+    /**
+     * \brief runs a predict call on the first idle predict worker, waits
+     *        for a worker to become idle if all are busy.
+     *        Requires the shared training lock.
+     * @param ad root input call object
+     * @return predict output object
+     */
+    oatpp::Object<DTO::PredictBody> predict_on_worker(const APIData &ad)
+    {
+      size_t nworkers = _predict_workers.size() + 1;
+      size_t w = acquire_predict_worker(nworkers);
+      oatpp::Object<DTO::PredictBody> out = nullptr;
+      try
+        {
+          if (w == 0)
+            out = this->predict(ad);
+          else
+            out = _predict_workers.at(w - 1)->predict(ad);
+        }
+      catch (...)
+        {
+          release_predict_worker(w);
+          throw;
+        }
+      release_predict_worker(w);
+      return out;
+    }
+
+    /**
+     * \brief grabs an idle predict worker, lock-free unless all workers
+     *        are busy
+     * @param nworkers total number of predict workers
+     * @return worker index, 0 is the service itself
+     */
+    size_t acquire_predict_worker(const size_t &nworkers)
+    {
+      auto try_acquire = [this, nworkers](size_t &w) {
+        size_t start = _next_worker.fetch_add(1) % nworkers;
+        for (size_t i = 0; i < nworkers; ++i)
+          {
+            w = (start + i) % nworkers;
+            bool expected = false;
+            if (_predict_workers_busy[w].compare_exchange_strong(expected,
+                                                                 true))
+              return true;
+          }
+        return false;
+      };
+
+      size_t w = 0;
+      if (try_acquire(w))
+        return w;
+      std::unique_lock<std::mutex> lock(_workers_mutex);
+      _workers_cv.wait(lock, [&try_acquire, &w]() { return try_acquire(w); });
+      return w;
+    }
+
+    /**
+     * \brief hands a predict worker back to the pool
+     * @param w worker index
+     */
+    void release_predict_worker(const size_t &w)
+    {
+      _predict_workers_busy[w].store(false);
+      {
+        std::lock_guard<std::mutex> lock(_workers_mutex);
+      }
+      _workers_cv.notify_one();
+    }
+
     std::string _sname;       /**< service name. */
     std::string _description; /**< optional description of the service. */
     APIData _init_parameters; /**< service creation parameters. */
@@ -534,6 +752,19 @@ namespace dd
                         // terminated
     std::unordered_map<int, APIData> _training_out;
     boost::shared_mutex _train_mutex;
+
+    bool _replica = false; /**< whether this is a predict worker replica. */
+    APIData _init_ad;      /**< creation object, for predict workers. */
+    std::vector<std::unique_ptr<MLService>>
+        _predict_workers; /**< predict worker replicas. */
+    std::unique_ptr<std::atomic<bool>[]>
+        _predict_workers_busy; /**< predict workers status, the service
+                                  itself is worker 0. */
+    std::atomic<size_t> _next_worker = { 0 }; /**< round-robin start. */
+    std::mutex _workers_mutex; /**< only used to wait for an idle worker. */
+    std::condition_variable _workers_cv;
+    std::unique_ptr<PredictCache>
+        _predict_cache; /**< predict outputs cache, if enabled. */
   };
 
 }
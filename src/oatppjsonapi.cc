@@ -32,6 +32,9 @@
 #include "oatpp/network/Server.hpp"
 #include "oatpp/web/protocol/http/Http.hpp"
 #include "oatpp/web/protocol/http/outgoing/ResponseFactory.hpp"
+#include "oatpp/web/mime/multipart/PartList.hpp"
+#include "oatpp/web/mime/multipart/PartReader.hpp"
+#include "oatpp/web/mime/multipart/Reader.hpp"
 #include "oatpp/web/server/HttpConnectionHandler.hpp"
 #include "oatpp/web/server/HttpRouter.hpp"
 #include "oatpp/web/server/api/ApiController.hpp"
@@ -245,6 +248,144 @@ namespace dd
     return response;
   }
 
+  /** max size of a single part of a multipart predict call, 128MB */
+  static const v_int64 max_predict_part_size = 128 * 1024 * 1024;
+
+  /** parses a raw image shape, e.g. 480x640x3 */
+  static bool parse_raw_shape(const std::string &str, int &height, int &width,
+                              int &channels)
+  {
+    std::vector<std::string> elts = dd::dd_utils::split(str, 'x');
+    if (elts.size() != 2 && elts.size() != 3)
+      return false;
+    try
+      {
+        height = std::stoi(elts.at(0));
+        width = std::stoi(elts.at(1));
+        channels = elts.size() == 3 ? std::stoi(elts.at(2)) : 1;
+      }
+    catch (...)
+      {
+        return false;
+      }
+    return height > 0 && width > 0 && channels >= 1 && channels <= 4;
+  }
+
+  JDoc OatppJsonAPI::service_predict_multipart(
+      const std::shared_ptr<oatpp::web::protocol::http::incoming::Request>
+          &request)
+  {
+    namespace multipart = oatpp::web::mime::multipart;
+    std::shared_ptr<multipart::PartList> parts;
+    try
+      {
+        parts = std::make_shared<multipart::PartList>(request->getHeaders());
+        multipart::Reader reader(parts.get());
+        reader.setDefaultPartReader(
+            multipart::createInMemoryPartReader(max_predict_part_size));
+        request->transferBody(&reader);
+      }
+    catch (std::exception &e)
+      {
+        _logger->error("multipart predict error: {}", e.what());
+        return dd_bad_request_400(e.what());
+      }
+
+    auto call_part = parts->getNamedPart("call");
+    if (!call_part || !call_part->getPayload())
+      return dd_bad_request_400("missing \"call\" part");
+    oatpp::String jstr = call_part->getPayload()->getInMemoryData();
+    if (!jstr)
+      return dd_bad_request_400("empty \"call\" part");
+
+    // decoding flags from the call, service level flags are applied by the
+    // input connector afterwards
+    int imread_flags = cv::IMREAD_COLOR;
+    rapidjson::Document d;
+    d.Parse<rapidjson::kParseNanAndInfFlag>(jstr->c_str());
+    if (!d.HasParseError() && d.IsObject() && d.HasMember("parameters")
+        && d["parameters"].IsObject() && d["parameters"].HasMember("input")
+        && d["parameters"]["input"].IsObject())
+      {
+        const JVal &jinput = d["parameters"]["input"];
+        if (jinput.HasMember("unchanged_data")
+            && jinput["unchanged_data"].IsBool()
+            && jinput["unchanged_data"].GetBool())
+          imread_flags = cv::IMREAD_UNCHANGED;
+        else if (jinput.HasMember("bw") && jinput["bw"].IsBool()
+                 && jinput["bw"].GetBool())
+          imread_flags = cv::IMREAD_GRAYSCALE;
+      }
+
+    std::vector<std::shared_ptr<multipart::Part>> data_parts;
+    for (auto &part : parts->getAllParts())
+      if (part != call_part)
+        data_parts.push_back(part);
+    if (data_parts.empty())
+      return dd_bad_request_400("no data part");
+
+    // every part is decoded into its own slot, buffers are wrapped and not
+    // copied
+    std::vector<cv::Mat> imgs(data_parts.size());
+    std::vector<std::string> ids(data_parts.size());
+    std::vector<std::string> errors(data_parts.size());
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < data_parts.size(); ++i)
+      {
+        auto &part = data_parts.at(i);
+        oatpp::String fname = part->getFilename();
+        ids[i] = fname ? fname->c_str() : std::to_string(i);
+        oatpp::String data = part->getPayload()
+                                 ? part->getPayload()->getInMemoryData()
+                                 : nullptr;
+        if (!data || data->empty())
+          {
+            errors[i] = "empty data part " + ids[i];
+            continue;
+          }
+        char *buf = const_cast<char *>(data->data());
+
+        oatpp::String shape = part->getHeader("X-Raw-Shape");
+        try
+          {
+            if (shape)
+              {
+                int height = 0, width = 0, channels = 0;
+                if (!parse_raw_shape(shape, height, width, channels))
+                  errors[i] = "invalid X-Raw-Shape " + *shape;
+                else if (static_cast<size_t>(height) * width * channels
+                         != data->size())
+                  errors[i] = "X-Raw-Shape " + *shape
+                              + " does not match data size of part "
+                              + ids[i];
+                else
+                  // the part buffer outlives the predict call
+                  imgs[i] = cv::Mat(height, width, CV_8UC(channels), buf);
+              }
+            else
+              {
+                imgs[i] = cv::imdecode(
+                    cv::Mat(1, static_cast<int>(data->size()), CV_8UC1, buf),
+                    imread_flags);
+                if (imgs[i].empty())
+                  errors[i] = "failed decoding image " + ids[i];
+              }
+          }
+        catch (cv::Exception &e)
+          {
+            errors[i] = "failed decoding image " + ids[i] + ": " + e.what();
+          }
+      }
+    for (const std::string &err : errors)
+      if (!err.empty())
+        {
+          _logger->error(err);
+          return dd_service_input_bad_request_1005(err);
+        }
+
+    return service_predict(jstr, imgs, ids);
+  }
+
   oatpp::Object<DTO::Status>
   OatppJsonAPI::create_status_dto(const uint32_t &code, const std::string &msg,
                                   const uint32_t &dd_code,
@@ -325,6 +466,13 @@ namespace dd
                            "Conflict", 1015, "Resource already exists!");
   }
 
+  OatppJsonAPI::Response_ptr
+  OatppJsonAPI::response_stream_already_exists_1017() const
+  {
+    return dto_to_response(dd::DTO::GenericResponse::createShared(), 409,
+                           "Conflict", 1017, "Stream already exists!");
+  }
+
   void OatppJsonAPI::terminate(int signal)
   {
     (void)signal;
@@ -25,6 +25,7 @@
 #include "jsonapi.h"
 #include "oatpp/network/Server.hpp"
 #include "oatpp/web/protocol/http/Http.hpp"
+#include "oatpp/web/protocol/http/incoming/Request.hpp"
 #include "oatpp/web/protocol/http/outgoing/Response.hpp"
 #include "oatpp/web/server/api/ApiController.hpp"
 #include "dto/common.hpp"
@@ -48,6 +49,19 @@ namespace dd
     uri_query_to_json(oatpp::web::protocol::http::QueryParams queryParams);
     Response_ptr jdoc_to_response(const JDoc &janswer) const;
 
+    /**
+     * \brief prediction from a multipart/form-data upload: the "call" part
+     *        holds the JSON predict call, every other part is an encoded
+     *        image, or raw 8-bit pixels when the part has an X-Raw-Shape
+     *        header with height, width and channels, e.g. 480x640x3.
+     *        Part buffers are decoded in place, with no base64 or JSON
+     *        round trip.
+     * @param request incoming request
+     */
+    JDoc service_predict_multipart(
+        const std::shared_ptr<oatpp::web::protocol::http::incoming::Request>
+            &request);
+
     oatpp::Object<DTO::Status>
     create_status_dto(const uint32_t &code, const std::string &msg,
                       const uint32_t &dd_code = 0,
@@ -69,6 +83,7 @@ namespace dd
 
     // dede error responses
     Response_ptr response_resource_already_exists_1015() const;
+    Response_ptr response_stream_already_exists_1017() const;
   };
 }
 
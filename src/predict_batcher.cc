@@ -0,0 +1,298 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "predict_batcher.h"
+
+#include <unordered_map>
+
+#include "mllibstrategy.h"
+
+namespace dd
+{
+  PredictBatcher::PredictBatcher(const std::string &sname,
+                                 const predict_fn &predict,
+                                 const int &max_batch_size,
+                                 const int &max_latency_ms)
+      : _predict(predict)
+  {
+    _logger = spdlog::get(sname);
+    if (max_batch_size > 0)
+      _max_batch_size = max_batch_size;
+    if (max_latency_ms >= 0)
+      _max_latency = std::chrono::milliseconds(max_latency_ms);
+    _thread = std::thread([this]() { run(); });
+  }
+
+  PredictBatcher::~PredictBatcher()
+  {
+    stop();
+  }
+
+  void PredictBatcher::stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_queue_mutex);
+      _stop = true;
+    }
+    _queue_cv.notify_all();
+    if (_thread.joinable())
+      _thread.join();
+
+    // fail calls that did not make it before the service went away
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    for (auto &pp : _queue)
+      pp->_promise.set_exception(std::make_exception_ptr(
+          MLLibInternalException("service terminated before predict")));
+    _queue.clear();
+  }
+
+  bool PredictBatcher::batchable(const APIData &ad)
+  {
+    if (ad.has("dto") || ad.has("chain") || ad.has("data_raw_img")
+        || !ad.has("data"))
+      return false;
+    APIData ad_output = ad.getobj("parameters").getobj("output");
+    if (ad_output.has("measure"))
+      return false;
+    return true;
+  }
+
+  oatpp::Object<DTO::PredictBody>
+  PredictBatcher::predict(const APIData &ad)
+  {
+    auto pp = std::make_shared<PendingPredict>();
+    try
+      {
+        pp->_data = ad.get("data").get<std::vector<std::string>>();
+      }
+    catch (...)
+      {
+        return _predict(ad); // let the input connector report the error
+      }
+
+    // calls that already fill up a batch gain nothing from waiting
+    if (pp->_data.empty()
+        || static_cast<int>(pp->_data.size()) >= _max_batch_size)
+      return _predict(ad);
+
+    pp->_ad = ad;
+    pp->_key = ad.getobj("parameters").toJSONString();
+    pp->_tqueue = std::chrono::steady_clock::now();
+    std::future<oatpp::Object<DTO::PredictBody>> fut
+        = pp->_promise.get_future();
+    {
+      std::lock_guard<std::mutex> lock(_queue_mutex);
+      if (_stop)
+        throw MLLibInternalException("service terminated before predict");
+      _queue.push_back(pp);
+    }
+    _queue_cv.notify_all();
+    return fut.get();
+  }
+
+  void PredictBatcher::run()
+  {
+    std::unique_lock<std::mutex> lock(_queue_mutex);
+    while (true)
+      {
+        _queue_cv.wait(lock, [this]() { return _stop || !_queue.empty(); });
+        if (_stop)
+          break;
+
+        // wait for more calls to join the head of the queue, until the
+        // batch is full or the oldest call reaches its max latency
+        auto deadline = _queue.front()->_tqueue + _max_latency;
+        _queue_cv.wait_until(lock, deadline,
+                             [this]() { return _stop || head_batch_full(); });
+        if (_stop)
+          break;
+
+        std::vector<std::shared_ptr<PendingPredict>> batch = pop_batch();
+        lock.unlock();
+        process(batch);
+        lock.lock();
+      }
+  }
+
+  bool PredictBatcher::head_batch_full() const
+  {
+    if (_queue.empty())
+      return false;
+    const std::string &key = _queue.front()->_key;
+    int nelts = 0;
+    for (const auto &pp : _queue)
+      {
+        if (pp->_key != key)
+          continue;
+        nelts += pp->_data.size();
+        if (nelts >= _max_batch_size)
+          return true;
+      }
+    return false;
+  }
+
+  std::vector<std::shared_ptr<PredictBatcher::PendingPredict>>
+  PredictBatcher::pop_batch()
+  {
+    std::vector<std::shared_ptr<PendingPredict>> batch;
+    std::shared_ptr<PendingPredict> head = _queue.front();
+    _queue.pop_front();
+    batch.push_back(head);
+    int nelts = head->_data.size();
+
+    auto qit = _queue.begin();
+    while (qit != _queue.end() && nelts < _max_batch_size)
+      {
+        if ((*qit)->_key == head->_key
+            && nelts + static_cast<int>((*qit)->_data.size())
+                   <= _max_batch_size)
+          {
+            nelts += (*qit)->_data.size();
+            batch.push_back(*qit);
+            qit = _queue.erase(qit);
+          }
+        else
+          ++qit;
+      }
+    return batch;
+  }
+
+  void PredictBatcher::process(
+      std::vector<std::shared_ptr<PendingPredict>> &batch)
+  {
+    if (batch.size() == 1)
+      {
+        process_single(batch);
+        return;
+      }
+
+    std::vector<std::string> data;
+    for (const auto &pp : batch)
+      data.insert(data.end(), pp->_data.begin(), pp->_data.end());
+
+    // merged call, with a batch size that fits all data in one pass
+    APIData ad_batch = batch.at(0)->_ad;
+    ad_batch.add("data", data);
+    APIData ad_params = ad_batch.getobj("parameters");
+    APIData ad_mllib = ad_params.getobj("mllib");
+    APIData ad_net = ad_mllib.getobj("net");
+    ad_net.add("test_batch_size", static_cast<int>(data.size()));
+    ad_mllib.add("net", ad_net);
+    ad_params.add("mllib", ad_mllib);
+    ad_batch.add("parameters", ad_params);
+    ad_batch.add("batched", true); // merged calls are not cached
+
+    oatpp::Object<DTO::PredictBody> batch_out;
+    try
+      {
+        batch_out = _predict(ad_batch);
+      }
+    catch (...)
+      {
+        // a single faulty call must not fail the others: each call is
+        // replayed on its own and gets its own error
+        _logger->warn("batched predict of {} calls failed, replaying calls "
+                      "one by one",
+                      batch.size());
+        process_single(batch);
+        return;
+      }
+
+    std::vector<oatpp::Object<DTO::PredictBody>> outs;
+    if (!scatter(batch, batch_out, outs))
+      {
+        _logger->warn("could not match batched predictions with calls, "
+                      "replaying calls one by one");
+        process_single(batch);
+        return;
+      }
+
+    _logger->debug("batched predict: {} calls, {} elements", batch.size(),
+                   data.size());
+    for (size_t r = 0; r < batch.size(); ++r)
+      batch.at(r)->_promise.set_value(outs.at(r));
+  }
+
+  void PredictBatcher::process_single(
+      std::vector<std::shared_ptr<PendingPredict>> &batch)
+  {
+    for (auto &pp : batch)
+      {
+        try
+          {
+            pp->_promise.set_value(_predict(pp->_ad));
+          }
+        catch (...)
+          {
+            pp->_promise.set_exception(std::current_exception());
+          }
+      }
+  }
+
+  bool PredictBatcher::scatter(
+      const std::vector<std::shared_ptr<PendingPredict>> &batch,
+      const oatpp::Object<DTO::PredictBody> &batch_out,
+      std::vector<oatpp::Object<DTO::PredictBody>> &outs) const
+  {
+    // predictions are matched by uri, that is either the data element
+    // itself (files, urls) or its position in the batch (e.g. base64)
+    std::vector<size_t> owner;
+    std::vector<size_t> local_pos;
+    std::unordered_map<std::string, std::deque<size_t>> data_pos;
+    std::unordered_map<std::string, size_t> index_pos;
+    for (size_t r = 0; r < batch.size(); ++r)
+      {
+        for (size_t j = 0; j < batch.at(r)->_data.size(); ++j)
+          {
+            size_t k = owner.size();
+            owner.push_back(r);
+            local_pos.push_back(j);
+            data_pos[batch.at(r)->_data.at(j)].push_back(k);
+            index_pos[std::to_string(k)] = k;
+          }
+      }
+
+    outs.clear();
+    for (size_t r = 0; r < batch.size(); ++r)
+      outs.push_back(DTO::PredictBody::createShared());
+
+    for (auto pred : *batch_out->predictions)
+      {
+        if (pred->uri == nullptr)
+          return false;
+        std::string uri = pred->uri;
+        auto dit = data_pos.find(uri);
+        if (dit != data_pos.end() && !dit->second.empty())
+          {
+            size_t k = dit->second.front();
+            dit->second.pop_front();
+            outs.at(owner.at(k))->predictions->push_back(pred);
+            continue;
+          }
+        auto iit = index_pos.find(uri);
+        if (iit == index_pos.end())
+          return false;
+        size_t k = iit->second;
+        pred->uri = std::to_string(local_pos.at(k));
+        outs.at(owner.at(k))->predictions->push_back(pred);
+      }
+    return true;
+  }
+}
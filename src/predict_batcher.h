@@ -0,0 +1,151 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREDICT_BATCHER_H
+#define PREDICT_BATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "apidata.h"
+#include "dd_spdlog.h"
+#include "dto/predict_out.hpp"
+
+namespace dd
+{
+  /**
+   * \brief server-side dynamic batching of concurrent predict calls.
+   *        Predict calls that share the same parameters are queued for at
+   *        most max_latency_ms, coalesced into a single predict call of at
+   *        most max_batch_size data elements, and the predictions are
+   *        scattered back to their respective callers.
+   */
+  class PredictBatcher
+  {
+  public:
+    typedef std::function<oatpp::Object<DTO::PredictBody>(const APIData &)>
+        predict_fn;
+
+    /**
+     * \brief batcher creation, starts the batching thread
+     * @param sname service name, for logging
+     * @param predict service predict function
+     * @param max_batch_size max number of data elements per batched call
+     * @param max_latency_ms max time a call waits for others to join
+     */
+    PredictBatcher(const std::string &sname, const predict_fn &predict,
+                   const int &max_batch_size, const int &max_latency_ms);
+
+    /**
+     * \brief stops the batching thread, pending calls fail
+     */
+    ~PredictBatcher();
+
+    /**
+     * \brief stops the batching thread once the running batch is done,
+     *        pending and later calls fail
+     */
+    void stop();
+
+    /**
+     * \brief whether a predict call can be coalesced with others: calls
+     *        from chains, resources, DTOs or measure calls run unbatched.
+     * @param ad root input call object
+     */
+    static bool batchable(const APIData &ad);
+
+    /**
+     * \brief queues a predict call and blocks until its results are ready
+     * @param ad root input call object
+     * @return predict output object for this call only
+     */
+    oatpp::Object<DTO::PredictBody> predict(const APIData &ad);
+
+    int _max_batch_size = 16; /**< max data elements per batched call. */
+    std::chrono::milliseconds _max_latency
+        = std::chrono::milliseconds(5); /**< max queuing time. */
+
+  private:
+    /**
+     * \brief a queued predict call
+     */
+    class PendingPredict
+    {
+    public:
+      APIData _ad;                     /**< original call object. */
+      std::vector<std::string> _data;  /**< call data. */
+      std::string _key;                /**< batching key (call parameters). */
+      std::chrono::steady_clock::time_point _tqueue; /**< queuing date. */
+      std::promise<oatpp::Object<DTO::PredictBody>> _promise;
+    };
+
+    /**
+     * \brief batching thread main loop
+     */
+    void run();
+
+    /**
+     * \brief whether enough data is queued to fill up a batch with the
+     *        same key as the queue head. Requires the queue lock.
+     */
+    bool head_batch_full() const;
+
+    /**
+     * \brief pops the queue head along with compatible calls.
+     *        Requires the queue lock.
+     */
+    std::vector<std::shared_ptr<PendingPredict>> pop_batch();
+
+    /**
+     * \brief runs a batch and dispatches the results to callers
+     */
+    void process(std::vector<std::shared_ptr<PendingPredict>> &batch);
+
+    /**
+     * \brief runs every call of the batch on its own, used as fallback
+     */
+    void process_single(std::vector<std::shared_ptr<PendingPredict>> &batch);
+
+    /**
+     * \brief splits the batched predictions back into one output per call
+     * @return false if some predictions cannot be matched with a call
+     */
+    bool scatter(const std::vector<std::shared_ptr<PendingPredict>> &batch,
+                 const oatpp::Object<DTO::PredictBody> &batch_out,
+                 std::vector<oatpp::Object<DTO::PredictBody>> &outs) const;
+
+    predict_fn _predict; /**< service predict function. */
+    std::shared_ptr<spdlog::logger> _logger;
+
+    std::deque<std::shared_ptr<PendingPredict>> _queue;
+    std::mutex _queue_mutex; /**< mutex around the queue. */
+    std::condition_variable _queue_cv;
+    bool _stop = false;
+    std::thread _thread; /**< batching thread. */
+  };
+}
+
+#endif
@@ -0,0 +1,202 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "predict_cache.h"
+
+#include <cstring>
+#include <functional>
+#include <sys/stat.h>
+
+#include "utils/oatpp.hpp"
+
+namespace dd
+{
+  /** FNV-1a 64-bit hash, completes std::hash into a 128-bit key */
+  static uint64_t fnv1a(const std::string &s)
+  {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : s)
+      {
+        h ^= c;
+        h *= 1099511628211ULL;
+      }
+    return h;
+  }
+
+  /** Appends a length-prefixed field to a key, so that fields cannot be
+   * confused with each other */
+  static void add_field(std::string &k, const char *data, const size_t &size)
+  {
+    k.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    k.append(data, size);
+  }
+
+  /** Whether data is a reference to its content, an URL or a file path,
+   * whose content may change while the data stays the same */
+  static bool is_reference(const std::string &d)
+  {
+    for (auto scheme : { "http://", "https://", "file://" })
+      if (d.compare(0, strlen(scheme), scheme) == 0)
+        return true;
+    struct stat st;
+    return stat(d.c_str(), &st) == 0;
+  }
+
+  /** Copy with its own predictions, callers update the time and resources
+   * fields */
+  static oatpp::Object<DTO::PredictBody>
+  copy_output(const oatpp::Object<DTO::PredictBody> &out)
+  {
+    auto copy = DTO::PredictBody::createShared();
+    copy->predictions
+        = oatpp_utils::staticCast<oatpp::Vector<oatpp::Object<
+            DTO::Prediction>>>(oatpp_utils::dtoDeepCopy(out->predictions));
+    copy->time = out->time;
+    copy->measure = out->measure;
+    copy->resources = out->resources;
+    return copy;
+  }
+
+  bool PredictCache::cacheable(const APIData &ad, const bool &chain)
+  {
+    if (chain || ad.has("chain") || ad.has("dto") || ad.has("batched"))
+      return false;
+    if (!ad.has("data") && !ad.has("data_raw_img"))
+      return false;
+    // only inline data is keyed by its content
+    if (!ad.has("data_raw_img"))
+      for (const std::string &d :
+           ad.get("data").get<std::vector<std::string>>())
+        if (is_reference(d))
+          return false;
+    // randomly seeded text generations differ from call to call
+    APIData ad_mllib = ad.getobj("parameters").getobj("mllib");
+    if (ad_mllib.has("generate"))
+      {
+        APIData ad_generate = ad_mllib.getobj("generate");
+        if (!ad_generate.has("seed") || ad_generate.get("seed").get<int>() < 0)
+          return false;
+      }
+    APIData ad_output = ad.getobj("parameters").getobj("output");
+    if (ad_output.has("measure"))
+      return false;
+    for (auto s : { "index", "build_index", "search" })
+      if (ad_output.has(s) && ad_output.get(s).get<bool>())
+        return false;
+    return true;
+  }
+
+  std::string PredictCache::key(const APIData &ad)
+  {
+    // all parameters are part of the key, as input, mllib and output
+    // parameters all may change the predictions
+    std::string k = ad.getobj("parameters").toJSONString();
+    if (ad.has("data_raw_img"))
+      {
+        std::vector<cv::Mat> imgs
+            = ad.get("data_raw_img").get<std::vector<cv::Mat>>();
+        for (const cv::Mat &img : imgs)
+          {
+            int dims[3] = { img.rows, img.cols, img.type() };
+            add_field(k, reinterpret_cast<const char *>(dims), sizeof(dims));
+            size_t row_bytes = img.cols * img.elemSize();
+            for (int r = 0; r < img.rows; ++r)
+              add_field(k, reinterpret_cast<const char *>(img.ptr(r)),
+                        row_bytes);
+          }
+        if (ad.has("ids"))
+          for (const std::string &id :
+               ad.get("ids").get<std::vector<std::string>>())
+            add_field(k, id.c_str(), id.size());
+      }
+    else
+      {
+        for (const std::string &d :
+             ad.get("data").get<std::vector<std::string>>())
+          add_field(k, d.c_str(), d.size());
+      }
+
+    uint64_t h[2] = { std::hash<std::string>()(k), fnv1a(k) };
+    return std::string(reinterpret_cast<const char *>(h), sizeof(h));
+  }
+
+  oatpp::Object<DTO::PredictBody> PredictCache::get(const std::string &key)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto hit = _index.find(key);
+    if (hit == _index.end())
+      return nullptr;
+    _lru.splice(_lru.begin(), _lru, (*hit).second);
+    return copy_output((*hit).second->_out);
+  }
+
+  void PredictCache::put(const std::string &key,
+                         const oatpp::Object<DTO::PredictBody> &out)
+  {
+    // footprint estimated from the JSON rendering of the output
+    size_t bytes = sizeof(CacheEntry) + key.size()
+                   + oatpp_utils::dtoToJSONString(out).size();
+    if (bytes > _max_bytes)
+      return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto hit = _index.find(key);
+    if (hit != _index.end())
+      {
+        _bytes -= (*hit).second->_bytes;
+        _lru.erase((*hit).second);
+        _index.erase(hit);
+      }
+    while (!_lru.empty() && _bytes + bytes > _max_bytes)
+      {
+        _bytes -= _lru.back()._bytes;
+        _index.erase(_lru.back()._key);
+        _lru.pop_back();
+      }
+
+    CacheEntry entry;
+    entry._key = key;
+    entry._out = copy_output(out);
+    entry._bytes = bytes;
+    _lru.push_front(std::move(entry));
+    _index[key] = _lru.begin();
+    _bytes += bytes;
+  }
+
+  void PredictCache::clear()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _lru.clear();
+    _index.clear();
+    _bytes = 0;
+  }
+
+  size_t PredictCache::size() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _lru.size();
+  }
+
+  size_t PredictCache::bytes() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _bytes;
+  }
+}
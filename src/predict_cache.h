@@ -0,0 +1,112 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREDICT_CACHE_H
+#define PREDICT_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "apidata.h"
+#include "dto/predict_out.hpp"
+
+namespace dd
+{
+  /**
+   * \brief LRU cache of predict call outputs, keyed by a hash of the call
+   *        data and parameters, within a memory budget.
+   */
+  class PredictCache
+  {
+  public:
+    /**
+     * \brief cache creation
+     * @param max_bytes memory budget of cached outputs
+     */
+    PredictCache(const size_t &max_bytes) : _max_bytes(max_bytes)
+    {
+    }
+
+    /**
+     * \brief whether the output of a predict call can be cached: calls from
+     *        chains, measure calls, calls that read or write a similarity
+     *        search index, coalesced batches, randomly seeded text
+     *        generations and calls on files or URLs, whose content may
+     *        change, are never cached.
+     * @param ad root input call object
+     * @param chain whether the call is part of a chain call
+     */
+    static bool cacheable(const APIData &ad, const bool &chain);
+
+    /**
+     * \brief cache key of a predict call, 128-bit hash of the call
+     *        parameters and data, raw image pixels included
+     * @param ad root input call object
+     */
+    static std::string key(const APIData &ad);
+
+    /**
+     * \brief looks up a predict call output
+     * @param key call cache key
+     * @return a copy of the cached output, nullptr if not in cache
+     */
+    oatpp::Object<DTO::PredictBody> get(const std::string &key);
+
+    /**
+     * \brief stores a predict call output, evicts least recently used
+     *        outputs to stay within the memory budget
+     * @param key call cache key
+     * @param out predict output
+     */
+    void put(const std::string &key,
+             const oatpp::Object<DTO::PredictBody> &out);
+
+    /** Removes all entries, e.g. after the model has changed. */
+    void clear();
+
+    /** Number of cached outputs. */
+    size_t size() const;
+
+    /** Memory used by cached outputs, in bytes. */
+    size_t bytes() const;
+
+  private:
+    /**
+     * \brief a cached predict output
+     */
+    class CacheEntry
+    {
+    public:
+      std::string _key;
+      oatpp::Object<DTO::PredictBody> _out;
+      size_t _bytes = 0; /**< estimated memory footprint. */
+    };
+
+    size_t _max_bytes; /**< memory budget. */
+    size_t _bytes = 0; /**< memory used. */
+    std::list<CacheEntry> _lru; /**< most recently used first. */
+    std::unordered_map<std::string, std::list<CacheEntry>::iterator> _index;
+    mutable std::mutex _mutex;
+  };
+}
+
+#endif
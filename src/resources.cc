@@ -21,6 +21,7 @@
 
 #include "resources.h"
 
+#include <algorithm>
 #include <boost/algorithm/string/predicate.hpp>
 
 #include "utils/cv_utils.hpp"
@@ -60,6 +61,140 @@ namespace dd
       return cv::CAP_ANY;
   }
 
+  FramePolicy
+  VideoResource::get_frame_policy_by_name(const std::string &policy)
+  {
+    if (policy == "sync")
+      return FramePolicy::SYNC;
+    else if (policy == "latest")
+      return FramePolicy::LATEST;
+    else if (policy == "every_frame")
+      return FramePolicy::EVERY_FRAME;
+    else
+      throw ResourceBadParamException("Unknown frame policy: " + policy);
+  }
+
+  FrameGrabber::FrameGrabber(cv::VideoCapture &capture,
+                             const FramePolicy &policy,
+                             const size_t &buffer_size,
+                             const std::shared_ptr<spdlog::logger> &logger)
+      : _capture(capture), _policy(policy), _logger(logger),
+        _ring(std::max(buffer_size, size_t(1))),
+        _ring_ids(std::max(buffer_size, size_t(1)), 0)
+  {
+  }
+
+  FrameGrabber::~FrameGrabber()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _not_full.notify_all();
+    _not_empty.notify_all();
+    if (_thread.joinable())
+      _thread.join();
+  }
+
+  void FrameGrabber::start()
+  {
+    _thread = std::thread([this]() { run(); });
+  }
+
+  void FrameGrabber::run()
+  {
+    int frame_count = (int)_capture.get(cv::CAP_PROP_FRAME_COUNT);
+    int frame_id = 0;
+    while (true)
+      {
+        cv::Mat frame;
+        bool success = _capture.read(frame);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_stop)
+          return;
+        if (!success || frame.empty())
+          {
+            if (frame_id == 0)
+              {
+                _logger->error("Could not read frame");
+                _error = true;
+              }
+            _ended = true;
+            _not_empty.notify_all();
+            return;
+          }
+        ++frame_id;
+        ++_decoded_frames;
+
+        if (_count == _ring.size())
+          {
+            if (_policy == FramePolicy::EVERY_FRAME)
+              {
+                // backpressure, the decoder waits for predict calls
+                _not_full.wait(lock, [this]() {
+                  return _stop || _count < _ring.size();
+                });
+                if (_stop)
+                  return;
+              }
+            else
+              {
+                // latest frame policy, overwrite the oldest frame
+                _head = (_head + 1) % _ring.size();
+                --_count;
+                ++_dropped_frames;
+              }
+          }
+        size_t pos = (_head + _count) % _ring.size();
+        _ring[pos] = std::move(frame);
+        _ring_ids[pos] = frame_id;
+        ++_count;
+
+        if (frame_count > 0 && frame_id == frame_count)
+          _ended = true;
+        _not_empty.notify_one();
+        if (_ended)
+          return;
+      }
+  }
+
+  bool FrameGrabber::pop(cv::Mat &frame, int &frame_id)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_empty.wait(lock,
+                    [this]() { return _stop || _count > 0 || _ended; });
+    if (_count == 0)
+      return false;
+
+    if (_policy == FramePolicy::LATEST)
+      {
+        // stale frames are dropped
+        _dropped_frames += _count - 1;
+        _head = (_head + _count - 1) % _ring.size();
+        _count = 1;
+      }
+    frame = std::move(_ring[_head]);
+    frame_id = _ring_ids[_head];
+    _ring[_head] = cv::Mat();
+    _head = (_head + 1) % _ring.size();
+    --_count;
+    _not_full.notify_one();
+    return true;
+  }
+
+  bool FrameGrabber::exhausted()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _ended && _count == 0;
+  }
+
+  bool FrameGrabber::error()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _error;
+  }
+
   VideoResource::VideoResource(const std::string &name) : Resource(name)
   {
   }
@@ -68,6 +203,11 @@ namespace dd
   {
     std::string reader_backend_str = res_data->video_backend;
     std::string uri = res_data->source;
+    _frame_policy = get_frame_policy_by_name(res_data->frame_policy);
+    if (res_data->frame_buffer_size <= 0)
+      throw ResourceBadParamException(
+          "frame_buffer_size must be strictly positive");
+    _frame_buffer_size = res_data->frame_buffer_size;
     this->_logger->info("Creating resource \"{}\" with backend \"{}\"", uri,
                         reader_backend_str);
     auto reader_backend = get_video_backend_by_name(reader_backend_str);
@@ -159,14 +299,20 @@ namespace dd
                                         + "\" could not be opened");
       }
 
-    int fps = _capture.get(cv::CAP_PROP_FPS);
-    cv::Size dims((int)_capture.get(cv::CAP_PROP_FRAME_WIDTH),
-                  (int)_capture.get(cv::CAP_PROP_FRAME_HEIGHT));
-    auto frame_count = uint32_t(_capture.get(cv::CAP_PROP_FRAME_COUNT));
-    int fourcc = static_cast<int>(_capture.get(cv::CAP_PROP_FOURCC));
+    _fps = (float)_capture.get(cv::CAP_PROP_FPS);
+    _dims = cv::Size((int)_capture.get(cv::CAP_PROP_FRAME_WIDTH),
+                     (int)_capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    _frame_count = (int)_capture.get(cv::CAP_PROP_FRAME_COUNT);
+    _fourcc = static_cast<int>(_capture.get(cv::CAP_PROP_FOURCC));
     this->_logger->info("Video properties: {}x{} - {} fps, {} frames, enc={}",
-                        dims.width, dims.height, fps, frame_count,
-                        cv_utils::fourcc_to_string(fourcc));
+                        _dims.width, _dims.height, (int)_fps,
+                        uint32_t(_frame_count),
+                        cv_utils::fourcc_to_string(_fourcc));
+    if (_frame_policy != FramePolicy::SYNC)
+      this->_logger->info("Background decoding with policy \"{}\", buffer "
+                          "of {} frames",
+                          std::string(res_data->frame_policy),
+                          _frame_buffer_size);
   }
 
   cv::Mat VideoResource::get_image()
@@ -174,6 +320,31 @@ namespace dd
     if (_stream_ended)
       throw ResourceForbiddenException("Resource is exhausted");
 
+    if (_frame_policy != FramePolicy::SYNC)
+      {
+        if (!_grabber)
+          {
+            _grabber = std::unique_ptr<FrameGrabber>(new FrameGrabber(
+                _capture, _frame_policy, _frame_buffer_size, this->_logger));
+            _grabber->start();
+          }
+
+        cv::Mat frame;
+        if (!_grabber->pop(frame, _frame_counter))
+          {
+            if (_grabber->error())
+              {
+                _stream_error = true;
+                throw ResourceInternalException("Could not read frame");
+              }
+            _stream_ended = true;
+            throw ResourceForbiddenException("Resource is exhausted");
+          }
+        if (_grabber->exhausted())
+          _stream_ended = true;
+        return frame;
+      }
+
     cv::Mat frame;
     bool success = _capture.read(frame);
 
@@ -218,14 +389,23 @@ namespace dd
     res->status = Resource::to_str(get_status()).c_str();
 
     res->video = DTO::VideoInfo::createShared();
-    res->video->width = (int)_capture.get(cv::CAP_PROP_FRAME_WIDTH);
-    res->video->height = (int)_capture.get(cv::CAP_PROP_FRAME_HEIGHT);
-    res->video->fps = (float)_capture.get(cv::CAP_PROP_FPS);
-    auto fourcc_str = cv_utils::fourcc_to_string(
-        static_cast<int>(_capture.get(cv::CAP_PROP_FOURCC)));
+    res->video->width = _dims.width;
+    res->video->height = _dims.height;
+    res->video->fps = _fps;
+    auto fourcc_str = cv_utils::fourcc_to_string(_fourcc);
     res->video->fourcc = fourcc_str.c_str();
-    res->video->frame_count = (int)_capture.get(cv::CAP_PROP_FRAME_COUNT);
+    res->video->frame_count = _frame_count;
     res->video->current_frame = _frame_counter;
+    if (_grabber)
+      {
+        res->video->decoded_frames = _grabber->_decoded_frames.load();
+        res->video->dropped_frames = _grabber->_dropped_frames.load();
+      }
+    else
+      {
+        res->video->decoded_frames = _frame_counter;
+        res->video->dropped_frames = 0;
+      }
   }
 
   res_variant_type
@@ -23,6 +23,10 @@
 #define RESOURCES_H
 
 #include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <mapbox/variant.hpp>
 #include <opencv2/opencv.hpp>
 #include "dd_spdlog.h"
@@ -154,6 +158,71 @@ namespace dd
     std::shared_ptr<spdlog::logger> _logger;
   };
 
+  /**
+   * \brief how decoded frames are handed to predict calls
+   */
+  enum class FramePolicy
+  {
+    SYNC,       /**< frames are decoded within predict calls */
+    LATEST,     /**< background decoding, only the latest frame is kept */
+    EVERY_FRAME /**< background decoding, every frame is processed */
+  };
+
+  /**
+   * \brief background video decoder filling up a bounded ring buffer
+   */
+  class FrameGrabber
+  {
+  public:
+    FrameGrabber(cv::VideoCapture &capture, const FramePolicy &policy,
+                 const size_t &buffer_size,
+                 const std::shared_ptr<spdlog::logger> &logger);
+
+    /** Stops and joins the decoding thread. */
+    ~FrameGrabber();
+
+    /** Starts the decoding thread. */
+    void start();
+
+    /**
+     * \brief blocks until a frame is available
+     * @param frame decoded frame
+     * @param frame_id frame number, starting at 1
+     * @return false if the stream has ended and all frames were consumed
+     */
+    bool pop(cv::Mat &frame, int &frame_id);
+
+    /** Whether the stream has ended and all frames were consumed. */
+    bool exhausted();
+
+    /** Whether the stream failed before any frame was decoded. */
+    bool error();
+
+  public:
+    std::atomic<int64_t> _decoded_frames = { 0 };
+    std::atomic<int64_t> _dropped_frames = { 0 };
+
+  private:
+    void run();
+
+    cv::VideoCapture &_capture;
+    FramePolicy _policy;
+    std::shared_ptr<spdlog::logger> _logger;
+
+    std::vector<cv::Mat> _ring; /**< frames ring buffer. */
+    std::vector<int> _ring_ids; /**< frame numbers of the ring buffer. */
+    size_t _head = 0;           /**< oldest frame position. */
+    size_t _count = 0;          /**< number of frames in the buffer. */
+
+    std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    bool _stop = false;
+    bool _ended = false;
+    bool _error = false;
+    std::thread _thread;
+  };
+
   class VideoResource : public Resource
   {
   public:
@@ -170,6 +239,9 @@ namespace dd
 
     ResourceStatus get_status() const override;
 
+    /** Convert string to frame policy. */
+    static FramePolicy get_frame_policy_by_name(const std::string &policy);
+
     void fill_info(oatpp::Object<DTO::ResourceResponseBody> &resource);
 
   public:
@@ -177,6 +249,18 @@ namespace dd
     bool _stream_ended = false;
     bool _stream_error = false;
     int _frame_counter = 0;
+
+    // video properties, read once as the capture is not thread-safe
+    cv::Size _dims;
+    float _fps = -1;
+    int _fourcc = 0;
+    int _frame_count = -1;
+
+    FramePolicy _frame_policy = FramePolicy::SYNC;
+    size_t _frame_buffer_size = 8;
+    std::unique_ptr<FrameGrabber>
+        _grabber; /**< background decoder, started on first frame request so
+                     that the resource is in place. */
   };
 
   typedef mapbox::util::variant<VideoResource> res_variant_type;
@@ -240,6 +324,21 @@ namespace dd
       mapbox::util::apply_visitor(v, resource);
     }
 
+    class v_get_image
+    {
+    public:
+      cv::Mat operator()(VideoResource &resource)
+      {
+        return resource.get_image();
+      }
+    };
+
+    template <typename T> static inline cv::Mat get_image(T &resource)
+    {
+      visitor_resources::v_get_image v;
+      return mapbox::util::apply_visitor(v, resource);
+    }
+
     class v_get_info
     {
     public:
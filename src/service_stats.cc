@@ -20,35 +20,145 @@
  * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <sstream>
 
 #include "apidata.h"
 #include "service_stats.h"
 
 namespace dd
 {
+  LatencyHistogram::LatencyHistogram()
+  {
+    for (int b = 0; b < _nbuckets; ++b)
+      _buckets[b].store(0, std::memory_order_relaxed);
+  }
+
+  LatencyHistogram::LatencyHistogram(const LatencyHistogram &h)
+  {
+    for (int b = 0; b < _nbuckets; ++b)
+      _buckets[b].store(h._buckets[b].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    _count.store(h._count.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+    _sum_us.store(h._sum_us.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+  }
+
+  double LatencyHistogram::bucket_bound(const int &b)
+  {
+    return 0.01 * std::pow(2.0, b / 8.0);
+  }
+
+  void LatencyHistogram::add(const double &ms)
+  {
+    int b = 0;
+    if (ms > 0.01)
+      b = std::min(_nbuckets - 1,
+                   static_cast<int>(std::ceil(8.0 * std::log2(ms / 0.01))));
+    _buckets[b].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum_us.fetch_add(static_cast<uint64_t>(std::max(ms, 0.0) * 1000.0),
+                      std::memory_order_relaxed);
+  }
+
+  double LatencyHistogram::quantile(const double &q) const
+  {
+    // buckets are read one by one while others may be written to, so the
+    // total is recomputed from the buckets themselves
+    uint64_t counts[_nbuckets];
+    uint64_t total = 0;
+    for (int b = 0; b < _nbuckets; ++b)
+      {
+        counts[b] = _buckets[b].load(std::memory_order_relaxed);
+        total += counts[b];
+      }
+    if (total == 0)
+      return -1;
+
+    uint64_t rank = std::max(
+        static_cast<uint64_t>(1),
+        static_cast<uint64_t>(std::ceil(q * static_cast<double>(total))));
+    uint64_t cumul = 0;
+    for (int b = 0; b < _nbuckets; ++b)
+      {
+        cumul += counts[b];
+        if (cumul >= rank)
+          return bucket_bound(b);
+      }
+    return bucket_bound(_nbuckets - 1);
+  }
+
+  /**
+   * \brief timers of the predict call running on the current thread
+   */
+  struct PredictTimers
+  {
+    std::chrono::steady_clock::time_point _predict_tstart;
+    std::chrono::steady_clock::time_point _transform_tstart;
+    std::chrono::steady_clock::time_point _output_tstart;
+    double _transform_ms = 0.0;
+    double _output_ms = 0.0;
+  };
+
+  static thread_local PredictTimers predict_timers;
+
+  static double ms_since(const std::chrono::steady_clock::time_point &tstart)
+  {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - tstart)
+        .count();
+  }
 
   void ServiceStats::inc_inference_count(const int &l)
   {
-    _inference_count += l;
+    if (_parent)
+      _parent->inc_inference_count(l);
+    else
+      _inference_count += l;
   }
   void ServiceStats::transform_start()
   {
-    _transform_tstart = std::chrono::steady_clock::now();
+    predict_timers._transform_tstart = std::chrono::steady_clock::now();
   }
   void ServiceStats::transform_end()
   {
-    auto tend = std::chrono::steady_clock::now();
-    _transform_total_duration_ms += tend - _transform_tstart;
+    predict_timers._transform_ms += ms_since(predict_timers._transform_tstart);
+  }
+
+  void ServiceStats::output_start()
+  {
+    predict_timers._output_tstart = std::chrono::steady_clock::now();
+  }
+  void ServiceStats::output_end()
+  {
+    predict_timers._output_ms += ms_since(predict_timers._output_tstart);
   }
 
   void ServiceStats::predict_start()
   {
-    _predict_tstart = std::chrono::steady_clock::now();
+    predict_timers._predict_tstart = std::chrono::steady_clock::now();
+    predict_timers._transform_ms = 0.0;
+    predict_timers._output_ms = 0.0;
   }
 
   void ServiceStats::predict_end(bool succeed)
   {
+    double predict_ms = ms_since(predict_timers._predict_tstart);
+    double transform_ms = predict_timers._transform_ms;
+    double output_ms = predict_timers._output_ms;
+
+    _predict_hist.add(predict_ms);
+    if (succeed)
+      {
+        _transform_hist.add(transform_ms);
+        _output_hist.add(output_ms);
+        _inference_hist.add(
+            std::max(0.0, predict_ms - transform_ms - output_ms));
+      }
+
     std::lock_guard<std::mutex> lock(_mutex);
 
     if (succeed)
@@ -56,8 +166,10 @@ namespace dd
     else
       _predict_failure++;
 
-    auto tend = std::chrono::steady_clock::now();
-    _predict_total_duration_ms += tend - _predict_tstart;
+    _predict_total_duration_ms
+        += std::chrono::duration<double, std::milli>(predict_ms);
+    _transform_total_duration_ms
+        += std::chrono::duration<double, std::milli>(transform_ms);
 
     int _predict_count = _predict_success + _predict_failure;
     _avg_batch_size = _inference_count / static_cast<double>(_predict_count);
@@ -67,13 +179,33 @@ namespace dd
                                / static_cast<double>(_predict_count);
   }
 
+  void ServiceStats::cache_hit()
+  {
+    _cache_hits.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void ServiceStats::cache_miss()
+  {
+    _cache_misses.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static APIData quantiles_to_apidata(const LatencyHistogram &hist)
+  {
+    APIData ad;
+    ad.add("p50", hist.quantile(0.5));
+    ad.add("p90", hist.quantile(0.9));
+    ad.add("p99", hist.quantile(0.99));
+    ad.add("p999", hist.quantile(0.999));
+    return ad;
+  }
+
   void ServiceStats::to(oatpp::Object<DTO::Service> &dto) const
   {
     std::lock_guard<std::mutex> lock(_mutex);
 
     APIData stats;
 
-    stats.add("inference_count", _inference_count);
+    stats.add("inference_count", _inference_count.load());
     stats.add("predict_success", _predict_success);
     stats.add("predict_failure", _predict_failure);
     stats.add("predict_count", _predict_success + _predict_failure);
@@ -85,6 +217,14 @@ namespace dd
     stats.add("total_predict_duration_ms", _predict_total_duration_ms.count());
     stats.add("total_transform_duration_ms",
               _transform_total_duration_ms.count());
+    stats.add("cache_hits", static_cast<long int>(_cache_hits.load()));
+    stats.add("cache_misses", static_cast<long int>(_cache_misses.load()));
+
+    // latency quantiles in ms, -1 until the first predict call
+    stats.add("predict_latency_ms", quantiles_to_apidata(_predict_hist));
+    stats.add("transform_latency_ms", quantiles_to_apidata(_transform_hist));
+    stats.add("inference_latency_ms", quantiles_to_apidata(_inference_hist));
+    stats.add("output_latency_ms", quantiles_to_apidata(_output_hist));
 
     // FIXME(sileht): to deprecate
     stats.add("avg_predict_duration", _avg_predict_duration_ms / 1000.0);
@@ -92,4 +232,92 @@ namespace dd
 
     dto->service_stats = stats;
   }
+
+  static std::string prometheus_label(const std::string &val)
+  {
+    std::string escaped;
+    for (char c : val)
+      {
+        if (c == '\\' || c == '"')
+          escaped += '\\';
+        if (c == '\n')
+          escaped += "\\n";
+        else
+          escaped += c;
+      }
+    return escaped;
+  }
+
+  std::string ServiceStats::to_prometheus(
+      const std::vector<std::pair<std::string, const ServiceStats *>> &stats)
+  {
+    std::stringstream out;
+
+    out << "# HELP dd_predict_calls_total Number of predict calls\n"
+        << "# TYPE dd_predict_calls_total counter\n";
+    for (auto &st : stats)
+      {
+        std::lock_guard<std::mutex> lock(st.second->_mutex);
+        std::string sname = prometheus_label(st.first);
+        out << "dd_predict_calls_total{service=\"" << sname
+            << "\",status=\"success\"} " << st.second->_predict_success
+            << "\n";
+        out << "dd_predict_calls_total{service=\"" << sname
+            << "\",status=\"failure\"} " << st.second->_predict_failure
+            << "\n";
+      }
+
+    out << "# HELP dd_inference_total Number of predicted data elements\n"
+        << "# TYPE dd_inference_total counter\n";
+    for (auto &st : stats)
+      out << "dd_inference_total{service=\"" << prometheus_label(st.first)
+          << "\"} " << st.second->_inference_count.load() << "\n";
+
+    out << "# HELP dd_predict_cache_lookups_total Number of predict cache "
+           "lookups\n"
+        << "# TYPE dd_predict_cache_lookups_total counter\n";
+    for (auto &st : stats)
+      {
+        std::string sname = prometheus_label(st.first);
+        out << "dd_predict_cache_lookups_total{service=\"" << sname
+            << "\",result=\"hit\"} " << st.second->_cache_hits.load() << "\n";
+        out << "dd_predict_cache_lookups_total{service=\"" << sname
+            << "\",result=\"miss\"} " << st.second->_cache_misses.load()
+            << "\n";
+      }
+
+    out << "# HELP dd_predict_duration_seconds Predict call duration, per "
+           "phase\n"
+        << "# TYPE dd_predict_duration_seconds summary\n";
+    const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    for (auto &st : stats)
+      {
+        std::string sname = prometheus_label(st.first);
+        std::vector<std::pair<std::string, const LatencyHistogram *>> phases
+            = { { "predict", &st.second->_predict_hist },
+                { "transform", &st.second->_transform_hist },
+                { "inference", &st.second->_inference_hist },
+                { "output", &st.second->_output_hist } };
+        for (auto &ph : phases)
+          {
+            std::string labels
+                = "service=\"" + sname + "\",phase=\"" + ph.first + "\"";
+            for (double q : quantiles)
+              {
+                out << "dd_predict_duration_seconds{" << labels
+                    << ",quantile=\"" << q << "\"} ";
+                double v = ph.second->quantile(q);
+                if (v < 0)
+                  out << "NaN\n";
+                else
+                  out << v / 1000.0 << "\n";
+              }
+            out << "dd_predict_duration_seconds_sum{" << labels << "} "
+                << ph.second->sum() / 1000.0 << "\n";
+            out << "dd_predict_duration_seconds_count{" << labels << "} "
+                << ph.second->count() << "\n";
+          }
+      }
+    return out.str();
+  }
 }
@@ -22,14 +22,62 @@
 #ifndef STATISTICS_H
 #define STATISTICS_H
 
+#include <atomic>
 #include <chrono>
 #include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "apidata.h"
 #include "dto/info.hpp"
 
 namespace dd
 {
+  /**
+   * \brief lock-free latency histogram, with log-scale buckets of 8 buckets
+   *        per octave from 10us to ~3min, i.e. quantiles within 9%.
+   */
+  class LatencyHistogram
+  {
+  public:
+    static const int _nbuckets = 192;
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram &h);
+
+    /** Records a duration in milliseconds. */
+    void add(const double &ms);
+
+    /**
+     * \brief quantile of recorded durations
+     * @param q quantile in [0,1]
+     * @return upper bound of the quantile bucket in ms, -1 if empty
+     */
+    double quantile(const double &q) const;
+
+    /** Number of recorded durations. */
+    uint64_t count() const
+    {
+      return _count.load(std::memory_order_relaxed);
+    }
+
+    /** Sum of recorded durations in ms. */
+    double sum() const
+    {
+      return _sum_us.load(std::memory_order_relaxed) / 1000.0;
+    }
+
+    /** Upper bound of a bucket in ms. */
+    static double bucket_bound(const int &b);
+
+  private:
+    std::atomic<uint64_t> _buckets[_nbuckets];
+    std::atomic<uint64_t> _count = { 0 };
+    std::atomic<uint64_t> _sum_us = { 0 }; /**< sum in microseconds. */
+  };
+
   class ServiceStats
   {
 
@@ -39,15 +87,18 @@ namespace dd
     }
 
     ServiceStats(ServiceStats &stats)
+        : _predict_hist(stats._predict_hist),
+          _transform_hist(stats._transform_hist),
+          _inference_hist(stats._inference_hist),
+          _output_hist(stats._output_hist)
     {
       // NOTE(sileht) : Do we really want to have all stats copied ?
-      _inference_count = stats._inference_count;
+      _inference_count = stats._inference_count.load();
+      _cache_hits = stats._cache_hits.load();
+      _cache_misses = stats._cache_misses.load();
 
       _predict_success = stats._predict_success;
       _predict_failure = stats._predict_failure;
-      _predict_tstart = stats._predict_tstart;
-
-      _transform_tstart = stats._transform_tstart;
 
       _avg_batch_size = stats._avg_batch_size;
       _avg_predict_duration_ms = stats._avg_predict_duration_ms;
@@ -60,25 +111,45 @@ namespace dd
 
     void inc_inference_count(const int &l);
 
+    // timers are per thread, so that concurrent predict calls do not
+    // overwrite each other's start dates
     void transform_start();
     void transform_end();
 
+    void output_start();
+    void output_end();
+
     void predict_start();
     void predict_end(bool succeed);
 
+    // predict cache lookups, hits do not count as predict calls
+    void cache_hit();
+    void cache_miss();
+
     void to(oatpp::Object<DTO::Service> &dto) const;
 
+    /**
+     * \brief renders services metrics in Prometheus text format
+     * @param stats service names and their statistics
+     */
+    static std::string
+    to_prometheus(const std::vector<std::pair<std::string,
+                                              const ServiceStats *>> &stats);
+
+    ServiceStats *_parent
+        = nullptr; /**< stats of the service, for its predict worker
+                      replicas that count inferences on its behalf. */
+
   private:
-    int _inference_count = 0;
+    std::atomic<int> _inference_count = { 0 };
+    std::atomic<uint64_t> _cache_hits = { 0 };
+    std::atomic<uint64_t> _cache_misses = { 0 };
 
     int _predict_success = 0;
     int _predict_failure = 0;
 
-    std::chrono::steady_clock::time_point _predict_tstart;
     std::chrono::duration<double, std::milli> _predict_total_duration_ms
         = std::chrono::milliseconds(0);
-
-    std::chrono::steady_clock::time_point _transform_tstart;
     std::chrono::duration<double, std::milli> _transform_total_duration_ms
         = std::chrono::milliseconds(0);
 
@@ -86,6 +157,11 @@ namespace dd
     double _avg_predict_duration_ms = -1;
     double _avg_transform_duration_ms = -1;
 
+    LatencyHistogram _predict_hist;   /**< whole predict call. */
+    LatencyHistogram _transform_hist; /**< input connector transform. */
+    LatencyHistogram _inference_hist; /**< model forward and the rest. */
+    LatencyHistogram _output_hist;    /**< output connector formatting. */
+
     mutable std::mutex _mutex; /**< mutex for converting to APIData. */
   };
 };
@@ -40,6 +40,8 @@
 #include "chain.h"
 #include "chain_actions.h"
 #include "resources.h"
+#include "predict_batcher.h"
+#include "stream.h"
 #include "dto/service_predict.hpp"
 #include "dto/chain.hpp"
 #include "dto/stream.hpp"
@@ -72,6 +74,7 @@
 #include "backends/tensorrt/tensorrtlib.h"
 #endif
 #include "dd_spdlog.h"
+#include <atomic>
 #include <vector>
 #include <mutex>
 #include <chrono>
@@ -233,6 +236,23 @@ namespace dd
       return mapbox::util::apply_visitor(v, mllib);
     }
 
+    /**
+     * \brief service statistics visitor class
+     */
+    class v_get_stats
+    {
+    public:
+      template <typename T> const ServiceStats *operator()(T &mllib)
+      {
+        return &mllib._stats;
+      }
+    };
+    template <typename T> static const ServiceStats *get_stats(T &mllib)
+    {
+      visitor_mllib::v_get_stats v;
+      return mapbox::util::apply_visitor(v, mllib);
+    }
+
     /**
      * \brief service mllib.train_job() visitor class
      */
@@ -374,6 +394,10 @@ namespace dd
     }
     ~Services()
     {
+      // streams call into services and resources, stop them first
+      std::lock_guard<std::mutex> lock(_streams_mtx);
+      for (auto &st : _streams)
+        st.second->stop();
     }
 
     /**
@@ -385,6 +409,19 @@ namespace dd
       return _mlservices.size();
     }
 
+    /**
+     * \brief services statistics in Prometheus text format
+     * @return metrics text
+     */
+    std::string metrics()
+    {
+      std::vector<std::pair<std::string, const ServiceStats *>> stats;
+      std::lock_guard<std::mutex> lock(_mlservices_mtx);
+      for (auto &mls : _mlservices)
+        stats.push_back({ mls.first, visitor_mllib::get_stats(mls.second) });
+      return ServiceStats::to_prometheus(stats);
+    }
+
     /**
      * \brief add a new service
      * @param sname service name
@@ -404,6 +441,10 @@ namespace dd
       try
         {
           visitor_mllib::init(mls, ad);
+          APIData ad_batching
+              = ad.getobj("parameters").getobj("mllib").getobj("batching");
+          if (!ad_batching.empty())
+            add_batcher(sname, ad_batching);
           std::lock_guard<std::mutex> lock(_mlservices_mtx);
           _mlservices.insert(
               std::pair<std::string, mls_variant_type>(sname, std::move(mls)));
@@ -432,6 +473,59 @@ namespace dd
         }
     }
 
+    /**
+     * \brief sets up dynamic batching of concurrent predict calls
+     * @param sname service name
+     * @param ad_batching data object for "parameters/mllib/batching"
+     */
+    void add_batcher(const std::string &sname, const APIData &ad_batching)
+    {
+      int max_batch_size = 16;
+      int max_latency_ms = 5;
+      if (ad_batching.has("max_batch_size"))
+        max_batch_size = ad_batching.get("max_batch_size").get<int>();
+      if (ad_batching.has("max_latency_ms"))
+        max_latency_ms = ad_batching.get("max_latency_ms").get<int>();
+      if (max_batch_size <= 0 || max_latency_ms < 0)
+        throw MLLibBadParamException(
+            "batching requires max_batch_size > 0 and max_latency_ms >= 0");
+
+      auto batcher = std::make_shared<PredictBatcher>(
+          sname,
+          [this, sname](const APIData &ad) {
+            std::unique_lock<std::mutex> lock(_mlservices_mtx);
+            auto hit = _mlservices.find(sname);
+            if (hit == _mlservices.end())
+              throw ServiceNotFoundException("Service " + sname
+                                             + " does not exist");
+            // the service outlives the batch, remove_service stops the
+            // batcher before erasing it
+            auto &mls = (*hit).second;
+            lock.unlock();
+            return visitor_mllib::predict_job(mls, ad, false);
+          },
+          max_batch_size, max_latency_ms);
+      std::lock_guard<std::mutex> lock(_batchers_mtx);
+      _batchers[sname] = batcher;
+      spdlog::get(sname)->info(
+          "dynamic batching enabled: max_batch_size={} max_latency_ms={}",
+          max_batch_size, max_latency_ms);
+    }
+
+    /**
+     * \brief get a service predict batcher
+     * @param sname service name
+     * @return batcher, nullptr if batching is not enabled for this service
+     */
+    std::shared_ptr<PredictBatcher> get_batcher(const std::string &sname)
+    {
+      std::lock_guard<std::mutex> lock(_batchers_mtx);
+      auto bit = _batchers.find(sname);
+      if (bit == _batchers.end())
+        return nullptr;
+      return (*bit).second;
+    }
+
     /**
      * \brief removes and destroys a service
      * @param sname service name
@@ -441,6 +535,22 @@ namespace dd
      */
     bool remove_service(const std::string &sname, const APIData &ad)
     {
+      // the batching thread finishes its running batch and fails pending
+      // calls before the service goes away, without the services lock
+      // that the batch needs
+      std::shared_ptr<PredictBatcher> batcher;
+      {
+        std::lock_guard<std::mutex> block(_batchers_mtx);
+        auto bit = _batchers.find(sname);
+        if (bit != _batchers.end())
+          {
+            batcher = (*bit).second;
+            _batchers.erase(bit);
+          }
+      }
+      if (batcher)
+        batcher->stop();
+
       std::lock_guard<std::mutex> lock(_mlservices_mtx);
       auto hit = _mlservices.begin();
       if ((hit = _mlservices.find(sname)) != _mlservices.end())
@@ -666,8 +776,13 @@ namespace dd
                 }
             }
 
-          // predict call
-          pred_dto = visitor_mllib::predict_job(mllib, ad_in, chain);
+          // predict call, possibly coalesced with concurrent calls
+          std::shared_ptr<PredictBatcher> batcher = get_batcher(sname);
+          if (batcher && !chain && res_infos->empty()
+              && PredictBatcher::batchable(ad_in))
+            pred_dto = batcher->predict(ad_in);
+          else
+            pred_dto = visitor_mllib::predict_job(mllib, ad_in, chain);
 
           // update result with resource info
           if (!res_infos->empty())
@@ -773,10 +888,6 @@ namespace dd
           adc.add("meta_uris", meta_uris);
           adc.add("index_uris", index_uris);
         }
-      else
-        {
-          cdata._first_id = pred_id;
-        }
 
       oatpp::Object<DTO::PredictBody> pred_dto;
       try
@@ -942,68 +1053,87 @@ namespace dd
             std::cerr << s << std::endl;*/
           // debug
 
-          ChainData cdata;
-          std::vector<std::string> meta_uris;
-          std::vector<std::string> index_uris;
-          std::unordered_map<std::string, std::vector<std::string>>
-              um_meta_uris;
-          std::unordered_map<std::string, std::vector<std::string>>
-              um_index_uris;
-          int npredicts = 0;
-          std::string prec_pred_id;
-          std::string prec_action_id;
-          int aid = 0;
+          ChainGraph graph;
           for (size_t i = 0; i < ad_calls.size(); i++)
             {
-              APIData adc = ad_calls.at(i);
+              APIData &adc = ad_calls.at(i);
+              std::string call_id;
+              if (adc.has("id"))
+                call_id = adc.get("id").get<std::string>();
               if (adc.has("service"))
                 {
-                  std::string pred_id;
-                  if (adc.has("id"))
-                    pred_id = adc.get("id").get<std::string>();
-                  else
-                    pred_id = std::to_string(i);
-
                   std::string parent_id;
                   if (adc.has("parent_id"))
                     parent_id = adc.get("parent_id").get<std::string>();
-                  else
-                    parent_id = prec_action_id;
+                  graph.add_service(call_id, parent_id,
+                                    adc.get("service").get<std::string>());
+                }
+              else if (adc.has("action"))
+                {
+                  graph.add_action(
+                      call_id,
+                      adc.getobj("action").get("type").get<std::string>());
+                  // actions store their output under their id
+                  adc.add("id", graph._nodes.back()._id);
+                }
+              else
+                {
+                  throw ChainBadParamException(
+                      "no services nor action found in chain call #"
+                      + std::to_string(i));
+                }
+            }
 
-                  auto hit = um_meta_uris.find(parent_id);
+          ChainData cdata;
+          cdata._first_id = graph.first_service_id();
+          std::mutex uris_mutex;
+          std::unordered_map<std::string, std::vector<std::string>>
+              um_meta_uris;
+          std::unordered_map<std::string, std::vector<std::string>>
+              um_index_uris;
+          std::unordered_map<std::string, std::vector<std::string>>
+              service_meta_uris;
+          std::unordered_map<std::string, std::vector<std::string>>
+              service_index_uris;
+          std::atomic<int> npredicts(0);
+          graph.run([&](const int &i, const ChainGraph::Node &node) {
+            APIData adc = ad_calls.at(i);
+            if (!node._action)
+              {
+                std::vector<std::string> meta_uris;
+                std::vector<std::string> index_uris;
+                {
+                  std::lock_guard<std::mutex> lock(uris_mutex);
+                  auto hit = um_meta_uris.find(node._input_id);
                   if (hit != um_meta_uris.end())
                     meta_uris = (*hit).second;
-                  hit = um_index_uris.find(parent_id);
+                  hit = um_index_uris.find(node._input_id);
                   if (hit != um_index_uris.end())
                     index_uris = (*hit).second;
-                  cdata.add_model_sname(pred_id,
-                                        adc.get("service").get<std::string>());
-                  if (chain_service(cname, chain_logger, adc, cdata, pred_id,
-                                    meta_uris, index_uris, parent_id, i,
-                                    npredicts))
-                    break;
-                  prec_pred_id = pred_id;
-                }
-              else if (adc.has("action"))
-                {
-                  if (chain_action(chain_logger, adc, cdata, i, prec_pred_id))
-                    break;
-                  if (adc.has("id"))
-                    prec_action_id = adc.get("id").get<std::string>();
-                  else
-                    prec_action_id = std::to_string(aid);
-                  um_meta_uris.insert(
-                      std::pair<std::string, std::vector<std::string>>(
-                          prec_action_id, meta_uris));
-                  um_index_uris.insert(
-                      std::pair<std::string, std::vector<std::string>>(
-                          prec_action_id, index_uris));
-                  ++aid;
                 }
-            }
+                cdata.add_model_sname(node._id, node._name);
+                int np = 0;
+                if (chain_service(cname, chain_logger, adc, cdata, node._id,
+                                  meta_uris, index_uris, node._input_id, i,
+                                  np))
+                  return 1;
+                npredicts += np;
+                std::lock_guard<std::mutex> lock(uris_mutex);
+                service_meta_uris[node._id] = meta_uris;
+                service_index_uris[node._id] = index_uris;
+                return 0;
+              }
+            if (chain_action(chain_logger, adc, cdata, i, node._input_id))
+              return 1;
+            std::lock_guard<std::mutex> lock(uris_mutex);
+            um_meta_uris[node._id] = service_meta_uris[node._input_id];
+            um_index_uris[node._id] = service_index_uris[node._input_id];
+            return 0;
+          });
 
           // producing a nested output
           chain_dto = cdata.nested_chain_output();
+          chain_dto->calls_time = graph.timings();
 
           std::chrono::time_point<std::chrono::system_clock> tstop
               = std::chrono::system_clock::now();
@@ -1099,10 +1229,6 @@ namespace dd
           call_dto->_meta_uris = meta_uris;
           call_dto->_index_uris = index_uris;
         }
-      else
-        {
-          cdata._first_id = pred_id;
-        }
 
       call_dto->_chain = true;
 
@@ -1262,62 +1388,32 @@ namespace dd
           chain_logger->info("number of calls="
                              + std::to_string(calls_vec->size()));
 
-          ChainData cdata;
-          std::vector<std::string> meta_uris;
-          std::vector<std::string> index_uris;
-          std::unordered_map<std::string, std::vector<std::string>>
-              um_meta_uris;
-          std::unordered_map<std::string, std::vector<std::string>>
-              um_index_uris;
-          int npredicts = 0;
-          std::string prec_pred_id;
-          std::string prec_action_id;
-          int aid = 0;
-
+          ChainGraph graph;
           for (size_t i = 0; i < calls_vec->size(); i++)
             {
               auto call = calls_vec->at(i);
-              std::string call_id = call->id != nullptr ? std::string(call->id)
-                                                        : std::to_string(i);
-              std::string parent_id = call->parent_id != nullptr
-                                          ? std::string(call->parent_id)
-                                          : prec_action_id;
-
+              std::string call_id
+                  = call->id != nullptr ? std::string(call->id) : "";
               if (call->service != nullptr)
                 {
                   if (call->action != nullptr)
                     {
                       throw ChainBadParamException(
-                          "Chain call #" + call_id
+                          "Chain call #"
+                          + (call_id.empty() ? std::to_string(i) : call_id)
                           + " defines both a service and an action");
                     }
-
-                  auto hit = um_meta_uris.find(parent_id);
-                  if (hit != um_meta_uris.end())
-                    meta_uris = (*hit).second;
-                  hit = um_index_uris.find(parent_id);
-                  if (hit != um_index_uris.end())
-                    index_uris = (*hit).second;
-                  cdata.add_model_sname(call_id, call->service);
-                  if (chain_service(cname, chain_logger, call, cdata, call_id,
-                                    meta_uris, index_uris, parent_id, i,
-                                    npredicts))
-                    break;
-                  prec_pred_id = call_id;
+                  graph.add_service(call_id,
+                                    call->parent_id != nullptr
+                                        ? std::string(call->parent_id)
+                                        : "",
+                                    call->service);
                 }
               else if (call->action != nullptr)
                 {
-                  if (chain_action(chain_logger, call, cdata, i, prec_pred_id))
-                    break;
-
-                  prec_action_id = call_id;
-                  um_meta_uris.insert(
-                      std::pair<std::string, std::vector<std::string>>(
-                          prec_action_id, meta_uris));
-                  um_index_uris.insert(
-                      std::pair<std::string, std::vector<std::string>>(
-                          prec_action_id, index_uris));
-                  ++aid;
+                  graph.add_action(call_id, call->action->type);
+                  // actions store their output under their id
+                  call->id = graph._nodes.back()._id.c_str();
                 }
               else
                 {
@@ -1327,6 +1423,53 @@ namespace dd
                 }
             }
 
+          ChainData cdata;
+          cdata._first_id = graph.first_service_id();
+          std::mutex uris_mutex;
+          std::unordered_map<std::string, std::vector<std::string>>
+              um_meta_uris;
+          std::unordered_map<std::string, std::vector<std::string>>
+              um_index_uris;
+          std::unordered_map<std::string, std::vector<std::string>>
+              service_meta_uris;
+          std::unordered_map<std::string, std::vector<std::string>>
+              service_index_uris;
+          std::atomic<int> npredicts(0);
+          graph.run([&](const int &i, const ChainGraph::Node &node) {
+            auto call = calls_vec->at(i);
+            if (!node._action)
+              {
+                std::vector<std::string> meta_uris;
+                std::vector<std::string> index_uris;
+                {
+                  std::lock_guard<std::mutex> lock(uris_mutex);
+                  auto hit = um_meta_uris.find(node._input_id);
+                  if (hit != um_meta_uris.end())
+                    meta_uris = (*hit).second;
+                  hit = um_index_uris.find(node._input_id);
+                  if (hit != um_index_uris.end())
+                    index_uris = (*hit).second;
+                }
+                cdata.add_model_sname(node._id, node._name);
+                int np = 0;
+                if (chain_service(cname, chain_logger, call, cdata, node._id,
+                                  meta_uris, index_uris, node._input_id, i,
+                                  np))
+                  return 1;
+                npredicts += np;
+                std::lock_guard<std::mutex> lock(uris_mutex);
+                service_meta_uris[node._id] = meta_uris;
+                service_index_uris[node._id] = index_uris;
+                return 0;
+              }
+            if (chain_action(chain_logger, call, cdata, i, node._input_id))
+              return 1;
+            std::lock_guard<std::mutex> lock(uris_mutex);
+            um_meta_uris[node._id] = service_meta_uris[node._input_id];
+            um_index_uris[node._id] = service_index_uris[node._input_id];
+            return 0;
+          });
+
           // producing a nested output
           if (npredicts > 1)
             out_dto = cdata.nested_chain_output();
@@ -1349,6 +1492,7 @@ namespace dd
                                                                       - tstart)
                     .count();
           out_dto->time = elapsed;
+          out_dto->calls_time = graph.timings();
         }
       catch (...)
         {
@@ -1435,23 +1579,135 @@ namespace dd
     create_stream(std::string stream_name,
                   oatpp::Object<DTO::Stream> stream_data)
     {
-      (void)stream_name;
-      (void)stream_data;
+      {
+        std::lock_guard<std::mutex> lock(_streams_mtx);
+        if (_streams.find(stream_name) != _streams.end())
+          throw StreamForbiddenException("Stream already exists");
+      }
+      bool has_predict = stream_data->predict != nullptr;
+      if (has_predict == (stream_data->chain != nullptr))
+        throw StreamBadParamException(
+            "Stream requires either a predict or a chain call");
+      if (stream_data->output->type != "video")
+        throw StreamBadParamException("Unknown stream output type: "
+                                      + stream_data->output->type);
+      if (stream_data->output->queue_size <= 0)
+        throw StreamBadParamException("queue_size must be strictly positive");
+
+      // the resource is the data of the predict call or of the first call
+      // of the chain
+      oatpp::Vector<oatpp::String> data;
+      if (has_predict)
+        data = stream_data->predict->data;
+      else if (!stream_data->chain->calls->empty())
+        data = stream_data->chain->calls->at(0)->data;
+      if (data == nullptr || data->size() != 1)
+        throw StreamBadParamException(
+            "Stream requires a single resource as data");
+      std::string res_name = data->at(0);
+      auto rit = _resources.find(res_name);
+      if (rit == _resources.end())
+        throw ResourceNotFoundException("Resource with name " + res_name
+                                        + " does not exist");
+      auto res_info = DTO::ResourceResponseBody::createShared();
+      visitor_resources::get_info(rit->second, res_info);
+      double fps = res_info->video != nullptr ? res_info->video->fps : 0.0;
+
+      StreamRunner::grab_fn grab = [this, res_name]() {
+        auto rit = _resources.find(res_name);
+        if (rit == _resources.end())
+          throw ResourceNotFoundException("Resource with name " + res_name
+                                          + " does not exist");
+        return visitor_resources::get_image(rit->second);
+      };
+
+      // calls are rebuilt for every frame, from their JSON serialization,
+      // so that no call object is shared among frames
+      auto mapper = oatpp_utils::createDDMapper();
+      StreamRunner::infer_fn infer;
+      if (has_predict)
+        {
+          std::string call_str = mapper->writeToString(stream_data->predict);
+          std::string sname = stream_data->predict->service;
+          infer = [this, mapper, call_str, sname](const cv::Mat &img) {
+            auto call_dto
+                = mapper->readFromString<oatpp::Object<DTO::ServicePredict>>(
+                    call_str.c_str());
+            call_dto->data = oatpp::Vector<oatpp::String>::createShared();
+            call_dto->_data_raw_img = { img };
+            return APIData::fromDTO(predict(sname, call_dto));
+          };
+        }
+      else
+        {
+          auto chain_dto = DTO::ServiceChain::createShared();
+          chain_dto->chain = stream_data->chain;
+          std::string call_str = mapper->writeToString(chain_dto);
+          std::string cname = stream_name + "_chain";
+          infer = [this, mapper, call_str, cname](const cv::Mat &img) {
+            auto call_dto
+                = mapper->readFromString<oatpp::Object<DTO::ServiceChain>>(
+                    call_str.c_str());
+            auto first_call = call_dto->chain->calls->at(0);
+            first_call->data = oatpp::Vector<oatpp::String>::createShared();
+            first_call->_data_raw_img = { img };
+            return APIData::fromDTO(chain(call_dto, cname));
+          };
+        }
+
+      std::string logger_name = "stream_" + stream_name;
+      auto stream_logger = DD_SPDLOG_LOGGER(logger_name);
+      stream_logger->info("Creating stream on resource \"{}\"", res_name);
+      auto stream = std::make_shared<StreamRunner>(
+          stream_name, grab, infer, stream_data->output, fps, stream_logger);
+      {
+        std::lock_guard<std::mutex> lock(_streams_mtx);
+        if (!_streams.insert({ stream_name, stream }).second)
+          {
+            spdlog::drop(logger_name);
+            throw StreamForbiddenException("Stream already exists");
+          }
+      }
+      stream->start();
+
       auto response = DTO::StreamResponse::createShared();
+      response->body = DTO::StreamResponseBody::createShared();
+      stream->fill_info(response->body);
       return response;
     }
 
     oatpp::Object<DTO::StreamResponse>
     get_stream_info(const std::string &stream_name)
     {
-      (void)stream_name;
+      std::shared_ptr<StreamRunner> stream;
+      {
+        std::lock_guard<std::mutex> lock(_streams_mtx);
+        auto it = _streams.find(stream_name);
+        if (it == _streams.end())
+          throw StreamNotFoundException("Stream with name " + stream_name
+                                        + " does not exist");
+        stream = it->second;
+      }
       auto response = DTO::StreamResponse::createShared();
+      response->body = DTO::StreamResponseBody::createShared();
+      stream->fill_info(response->body);
       return response;
     }
 
     int delete_stream(const std::string stream_name)
     {
-      (void)stream_name;
+      std::shared_ptr<StreamRunner> stream;
+      {
+        std::lock_guard<std::mutex> lock(_streams_mtx);
+        auto it = _streams.find(stream_name);
+        if (it == _streams.end())
+          throw StreamNotFoundException("Stream with name " + stream_name
+                                        + " does not exist");
+        stream = it->second;
+        _streams.erase(it);
+      }
+      stream->stop();
+      spdlog::drop("stream_" + stream_name);
       return 200;
     }
 
@@ -1461,9 +1717,17 @@ namespace dd
     std::unordered_map<std::string, res_variant_type>
         _resources; /**< container of instanciated resources */
 
+    std::unordered_map<std::string, std::shared_ptr<PredictBatcher>>
+        _batchers; /**< predict batchers, per service with batching. */
+
+    std::unordered_map<std::string, std::shared_ptr<StreamRunner>>
+        _streams; /**< container of running streams. */
+
   protected:
     std::mutex _mlservices_mtx; /**< mutex around adding/removing services. */
     std::mutex _resources_mtx;  /**< mutex around adding/removing resources. */
+    std::mutex _batchers_mtx;   /**< mutex around adding/removing batchers. */
+    std::mutex _streams_mtx;    /**< mutex around adding/removing streams. */
   };
 }
 
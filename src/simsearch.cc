@@ -22,6 +22,14 @@
 #include "simsearch.h"
 #include "utils/fileops.hpp"
 #include "utils/utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <map>
 #ifdef USE_FAISS
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -67,6 +75,224 @@ namespace dd
     _cat = tok.at(6);
   }
 
+  /*-- URIStore --*/
+
+  namespace
+  {
+    /** fixed part of a stored uri, followed by the uri and category bytes,
+     * padded to 8 bytes */
+    struct URIRecord
+    {
+      uint32_t _uri_size;
+      uint32_t _cat_size;
+      uint32_t _has_bbox;
+      uint32_t _reserved;
+      double _bbox[4];
+      double _prob;
+    };
+
+    /** offset of ids without uri */
+    const uint64_t no_record = std::numeric_limits<uint64_t>::max();
+  }
+
+  URIStore::~URIStore()
+  {
+    close();
+  }
+
+  void URIStore::open(const std::string &model_repo)
+  {
+    _model_repo = model_repo;
+    if (!fileops::file_exists(file_path(_offsets_name)))
+      {
+        if (fileops::file_exists(_model_repo + "/" + _legacy_db_name))
+          {
+            import_legacy_db();
+            return;
+          }
+        std::ofstream(file_path(_offsets_name),
+                      std::ios::binary | std::ios::trunc);
+        std::ofstream(file_path(_records_name),
+                      std::ios::binary | std::ios::trunc);
+      }
+    map();
+  }
+
+  std::string URIStore::file_path(const std::string &name) const
+  {
+    return _model_repo + "/" + name + _file_suffix;
+  }
+
+  void URIStore::close()
+  {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    _offsets.reset();
+    _records.reset();
+    _records_size = 0;
+  }
+
+  void URIStore::remove()
+  {
+    close();
+    fileops::remove_file(_model_repo, _offsets_name);
+    fileops::remove_file(_model_repo, _records_name);
+    std::string db_filename = _model_repo + "/" + _legacy_db_name;
+    if (fileops::file_exists(db_filename))
+      {
+        fileops::clear_directory(db_filename);
+        rmdir(db_filename.c_str());
+      }
+  }
+
+  void URIStore::map()
+  {
+    // graph and tree searches resolve ids at random
+    std::unique_ptr<MappedFile> offsets(
+        new MappedFile(file_path(_offsets_name), false));
+    std::unique_ptr<MappedFile> records(
+        new MappedFile(file_path(_records_name), false));
+    if (!offsets->is_open() || !records->is_open())
+      throw SimIndexException("Cannot open uri store in " + _model_repo);
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    _offsets = std::move(offsets);
+    _records = std::move(records);
+    _records_size = _records->size();
+  }
+
+  void URIStore::import_legacy_db()
+  {
+    std::cerr << "converting index db to uri store\n";
+    db::DB *legacy_db = db::GetDB("lmdb");
+    legacy_db->Open(_model_repo + "/" + _legacy_db_name, db::READ);
+    std::map<int, URIData> uris;
+    std::unique_ptr<db::Cursor> cursor(legacy_db->NewCursor());
+    while (cursor->valid())
+      {
+        URIData uri;
+        uri.decode(cursor->value());
+        uris.insert(std::pair<int, URIData>(std::stoi(cursor->key()), uri));
+        cursor->Next();
+      }
+    cursor.reset();
+    legacy_db->Close();
+    delete legacy_db;
+
+    // runs of consecutive ids, ids missing from the db get no record
+    std::vector<std::pair<int, std::vector<URIData>>> runs;
+    for (auto &u : uris)
+      {
+        if (runs.empty()
+            || runs.back().first + static_cast<int>(runs.back().second.size())
+                   != u.first)
+          runs.emplace_back(u.first, std::vector<URIData>());
+        runs.back().second.push_back(u.second);
+      }
+
+    // written aside then renamed, the offsets file last since its presence
+    // marks a complete store, an interrupted import is retried next open
+    _file_suffix = ".tmp";
+    try
+      {
+        std::ofstream(file_path(_offsets_name),
+                      std::ios::binary | std::ios::trunc);
+        std::ofstream(file_path(_records_name),
+                      std::ios::binary | std::ios::trunc);
+        map();
+        for (auto &run : runs)
+          put(run.first, run.second);
+        close();
+      }
+    catch (...)
+      {
+        close();
+        std::remove(file_path(_offsets_name).c_str());
+        std::remove(file_path(_records_name).c_str());
+        _file_suffix.clear();
+        throw;
+      }
+    std::string records_tmp = file_path(_records_name);
+    std::string offsets_tmp = file_path(_offsets_name);
+    _file_suffix.clear();
+    if (std::rename(records_tmp.c_str(), file_path(_records_name).c_str())
+            != 0
+        || std::rename(offsets_tmp.c_str(), file_path(_offsets_name).c_str())
+               != 0)
+      throw SimIndexException("Cannot convert index db to uri store in "
+                              + _model_repo);
+    map();
+  }
+
+  void URIStore::put(const int &idx, const std::vector<URIData> &uris)
+  {
+    int first = size();
+    if (idx < first)
+      throw SimIndexException("uri " + std::to_string(idx)
+                              + " has already been stored");
+
+    // records are written before the offsets that point to them
+    std::string records;
+    std::vector<uint64_t> offsets(idx - first, no_record);
+    for (const URIData &uri : uris)
+      {
+        offsets.push_back(_records_size + records.size());
+        URIRecord r;
+        std::memset(&r, 0, sizeof(r));
+        r._uri_size = uri._uri.size();
+        r._cat_size = uri._cat.size();
+        r._has_bbox = uri._bbox.size() == 4;
+        if (r._has_bbox)
+          std::copy(uri._bbox.begin(), uri._bbox.end(), r._bbox);
+        r._prob = uri._prob;
+        records.append(reinterpret_cast<const char *>(&r), sizeof(r));
+        records.append(uri._uri);
+        records.append(uri._cat);
+        records.resize((records.size() + 7) / 8 * 8, '\0');
+      }
+    std::ofstream records_out(file_path(_records_name),
+                              std::ios::binary | std::ios::app);
+    records_out.write(records.data(), records.size());
+    records_out.close();
+    std::ofstream offsets_out(file_path(_offsets_name),
+                              std::ios::binary | std::ios::app);
+    offsets_out.write(reinterpret_cast<const char *>(offsets.data()),
+                      offsets.size() * sizeof(uint64_t));
+    offsets_out.close();
+    if (!records_out || !offsets_out)
+      throw SimIndexException("Cannot write uri store in " + _model_repo);
+    map();
+  }
+
+  bool URIStore::get(const int &idx, URIData &uri) const
+  {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    if (!_offsets || idx < 0
+        || static_cast<size_t>(idx) >= _offsets->size() / sizeof(uint64_t))
+      return false;
+    uint64_t offset
+        = reinterpret_cast<const uint64_t *>(_offsets->data())[idx];
+    if (offset == no_record)
+      return false;
+    const char *p = _records->data() + offset;
+    URIRecord r;
+    std::memcpy(&r, p, sizeof(r));
+    p += sizeof(r);
+    uri._uri.assign(p, r._uri_size);
+    p += r._uri_size;
+    uri._cat.assign(p, r._cat_size);
+    if (r._has_bbox)
+      uri._bbox.assign(r._bbox, r._bbox + 4);
+    else
+      uri._bbox.clear();
+    uri._prob = r._prob;
+    return true;
+  }
+
+  int URIStore::size() const
+  {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    return _offsets ? _offsets->size() / sizeof(uint64_t) : 0;
+  }
+
   /*-- SearchEngine --*/
   template <class TSE>
   SearchEngine<TSE>::SearchEngine(const int &dim,
@@ -83,17 +309,23 @@ namespace dd
 
   template <class TSE> void SearchEngine<TSE>::create_index()
   {
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    boost::unique_lock<boost::shared_mutex> search_lock(_search_mutex);
     _tse->create_index();
   }
 
   template <class TSE> void SearchEngine<TSE>::update_index()
   {
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    boost::unique_lock<boost::shared_mutex> search_lock(_search_mutex);
     _tse->update_index();
   }
 
   template <class TSE> void SearchEngine<TSE>::remove_index()
   {
     std::cerr << "removing index\n";
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    boost::unique_lock<boost::shared_mutex> search_lock(_search_mutex);
     _tse->remove_index();
   }
 
@@ -101,8 +333,8 @@ namespace dd
   void SearchEngine<TSE>::index(const URIData &uri,
                                 const std::vector<double> &data)
   {
-    std::lock_guard<std::mutex> lock(_index_mutex);
-    _tse->index(uri, data);
+    index(std::vector<URIData>({ uri }),
+          std::vector<std::vector<double>>({ data }));
   }
 
   template <class TSE>
@@ -110,34 +342,94 @@ namespace dd
                                 const std::vector<std::vector<double>> &datas)
   {
     std::lock_guard<std::mutex> lock(_index_mutex);
-    _tse->index(uris, datas);
+    if (TSE::_concurrent_index)
+      {
+        boost::shared_lock<boost::shared_mutex> search_lock(_search_mutex);
+        _tse->index(uris, datas);
+      }
+    else
+      {
+        boost::unique_lock<boost::shared_mutex> search_lock(_search_mutex);
+        _tse->index(uris, datas);
+      }
   }
 
   template <class TSE>
   void SearchEngine<TSE>::search(const std::vector<double> &data,
                                  const int &nn, std::vector<URIData> &uris,
-                                 std::vector<double> &distances)
+                                 std::vector<double> &distances,
+                                 const SearchParams &params)
+  {
+    boost::shared_lock<boost::shared_mutex> lock(_search_mutex);
+    _tse->search(data, nn, uris, distances, params);
+  }
+
+  template <class TSE>
+  void SearchEngine<TSE>::search_batch(
+      const std::vector<double> &data, const int &nn,
+      std::vector<std::vector<URIData>> &uris,
+      std::vector<std::vector<double>> &distances,
+      const SearchParams &params)
   {
-    _tse->search(data, nn, uris, distances);
+    if (data.size() % _dim != 0)
+      throw SimSearchException("search queries size "
+                               + std::to_string(data.size())
+                               + " is not a multiple of index dimension "
+                               + std::to_string(_dim));
+    boost::shared_lock<boost::shared_mutex> lock(_search_mutex);
+    _tse->search_batch(data, nn, uris, distances, params);
+  }
+
+  template <class TSE>
+  void SearchEngine<TSE>::remove(const std::vector<int> &ids)
+  {
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    boost::unique_lock<boost::shared_mutex> search_lock(_search_mutex);
+    _tse->remove(ids);
   }
 
 #ifdef USE_ANNOY
   /*- AnnoySE -*/
 
+  /** Annoy angular distance, sqrt(2 - 2 cos(u,v)) */
+  static double angular_distance(const double *u, const double *v,
+                                 const int &f)
+  {
+    double pp = 0.0, qq = 0.0, pq = 0.0;
+    for (int i = 0; i < f; ++i)
+      {
+        pp += u[i] * u[i];
+        qq += v[i] * v[i];
+        pq += u[i] * v[i];
+      }
+    double ppqq = pp * qq;
+    double d = ppqq > 0.0 ? 2.0 - 2.0 * pq / std::sqrt(ppqq) : 2.0;
+    return std::sqrt(std::max(d, 0.0));
+  }
+
   AnnoySE::AnnoySE(const int &f, const std::string &model_repo)
       : _f(f), _model_repo(model_repo)
   {
-    _aindex = new AnnoyIndex<int, double, Angular, Kiss32Random,
-                             AnnoyIndexSingleThreadedBuildPolicy>(f);
-    _db = db::GetDB(_db_backend);
+    _aindex = std::make_shared<AnnoyIndexSE>(f);
   }
 
   AnnoySE::~AnnoySE()
   {
-    delete _aindex;
-    if (_db)
-      _db->Close();
-    delete _db;
+    stop_rebuild();
+    if (delta_size() > 0)
+      {
+        // pending vectors are merged so that they survive a restart
+        try
+          {
+            rebuild_tree();
+          }
+        catch (std::exception &e)
+          {
+            std::cerr << "could not merge delta into index: " << e.what()
+                      << std::endl;
+          }
+      }
+    _aindex.reset();
   }
 
   void AnnoySE::create_index() // TODO: exception
@@ -148,41 +440,35 @@ namespace dd
         _saved_tree = true;
         _aindex->load(index_filename.c_str(), _map_populate);
         _built_index = true;
+        _index_size = _aindex->get_n_items();
       }
-    std::string db_filename = _model_repo + "/" + _db_name;
-    if (fileops::file_exists(db_filename))
-      {
-        std::cerr << "open existing index db\n";
-        _db->Open(db_filename, db::WRITE);
-      }
-    else
-      {
-        std::cerr << "create index db\n";
-        _db->Open(db_filename, db::NEW);
-      }
+    _uris.open(_model_repo);
   }
 
   void AnnoySE::remove_index()
   {
+    stop_rebuild();
+    {
+      std::lock_guard<std::mutex> lock(_delta_mutex);
+      _delta = std::make_shared<const std::vector<double>>();
+    }
     fileops::remove_file(_model_repo, _index_name);
-    std::string db_filename = _model_repo + "/" + _db_name;
-    fileops::clear_directory(db_filename);
-    rmdir(db_filename.c_str());
+    _uris.remove();
   }
 
   void AnnoySE::update_index()
   {
+    if (_saved_tree)
+      {
+        rebuild_tree(); // merges the delta
+        return;
+      }
     build_tree();
-    save_tree(); // no turning back
+    save_tree();
   }
 
   void AnnoySE::build_tree()
   {
-    if (_count_put % _count_put_max != 0)
-      {
-        _txn->Commit(); // last pending db commit
-        _txn = std::unique_ptr<db::Transaction>(_db->NewTransaction());
-      }
     _aindex->build(_ntrees);
     _built_index = true;
   }
@@ -200,80 +486,413 @@ namespace dd
     _saved_tree = true;
   }
 
+  void AnnoySE::rebuild_tree()
+  {
+    std::lock_guard<std::mutex> rlock(_rebuild_mutex);
+    std::shared_ptr<AnnoyIndexSE> aindex;
+    std::shared_ptr<const std::vector<double>> delta;
+    {
+      std::lock_guard<std::mutex> lock(_delta_mutex);
+      if (_delta->empty())
+        return;
+      aindex = _aindex;
+      delta = _delta;
+    }
+
+    // new forest from base and delta vectors, searches keep using the
+    // current tree meanwhile
+    auto nindex = std::make_shared<AnnoyIndexSE>(_f);
+    int nbase = aindex->get_n_items();
+    std::vector<double> vec(_f);
+    for (int i = 0; i < nbase; ++i)
+      {
+        aindex->get_item(i, vec.data());
+        nindex->add_item(i, vec.data());
+      }
+    int ndelta = delta->size() / _f;
+    for (int j = 0; j < ndelta; ++j)
+      nindex->add_item(nbase + j, delta->data() + j * _f);
+    nindex->build(_ntrees);
+
+    // saved aside then renamed, the current tree mapping remains valid
+    std::string index_path = _model_repo + "/" + _index_name;
+    std::string tmp_path = index_path + ".tmp";
+    if (!nindex->save(tmp_path.c_str(), _map_populate)
+        || std::rename(tmp_path.c_str(), index_path.c_str()) != 0)
+      throw SimIndexException("Failed saving rebuilt Annoy index "
+                              + index_path);
+
+    // vectors appended during the rebuild stay in the delta
+    std::lock_guard<std::mutex> lock(_delta_mutex);
+    _aindex = nindex;
+    _delta = std::make_shared<const std::vector<double>>(
+        _delta->begin() + ndelta * _f, _delta->end());
+  }
+
+  int AnnoySE::delta_size()
+  {
+    std::lock_guard<std::mutex> lock(_delta_mutex);
+    return _delta->size() / _f;
+  }
+
+  void AnnoySE::add_to_delta(const std::vector<std::vector<double>> &vecs)
+  {
+    std::lock_guard<std::mutex> lock(_delta_mutex);
+    auto delta = std::make_shared<std::vector<double>>();
+    delta->reserve(_delta->size() + vecs.size() * _f);
+    delta->assign(_delta->begin(), _delta->end());
+    for (const std::vector<double> &vec : vecs)
+      delta->insert(delta->end(), vec.begin(), vec.end());
+    _delta = delta;
+    if (!_rebuild_thread.joinable())
+      _rebuild_thread = std::thread(&AnnoySE::rebuild_loop, this);
+    else if (static_cast<int>(_delta->size()) / _f >= _delta_max)
+      _rebuild_cv.notify_one();
+  }
+
+  void AnnoySE::rebuild_loop()
+  {
+    std::unique_lock<std::mutex> lock(_delta_mutex);
+    while (!_rebuild_stop)
+      {
+        // wakes up when the delta is full, or periodically
+        _rebuild_cv.wait_for(lock, std::chrono::seconds(_rebuild_period),
+                             [this]() {
+                               return _rebuild_stop
+                                      || static_cast<int>(_delta->size()) / _f
+                                             >= _delta_max;
+                             });
+        if (_rebuild_stop || _delta->empty())
+          continue;
+        lock.unlock();
+        try
+          {
+            rebuild_tree();
+          }
+        catch (std::exception &e)
+          {
+            std::cerr << "background index rebuild failed: " << e.what()
+                      << std::endl;
+          }
+        lock.lock();
+      }
+  }
+
+  void AnnoySE::stop_rebuild()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_delta_mutex);
+      _rebuild_stop = true;
+    }
+    _rebuild_cv.notify_one();
+    if (_rebuild_thread.joinable())
+      _rebuild_thread.join();
+    _rebuild_stop = false;
+  }
+
   // must be protected by mutex
   void AnnoySE::index(const URIData &uri, const std::vector<double> &vec)
   {
     if (_saved_tree)
-      throw SimIndexException("Cannot index after Annoy index has been saved");
+      {
+        index(std::vector<URIData>({ uri }),
+              std::vector<std::vector<double>>({ vec }));
+        return;
+      }
     int idx = _index_size;
     _aindex->add_item(idx, &vec[0]);
     ++_index_size;
-    add_to_db(idx, uri);
+    add_to_db(idx, { uri });
   }
 
   void AnnoySE::index(const std::vector<URIData> &uris,
                       const std::vector<std::vector<double>> &vecs)
   {
-    for (size_t i = 0; i < uris.size(); ++i)
+    if (uris.empty())
+      return;
+    if (_saved_tree)
       {
-        index(uris[i], vecs[i]);
+        // the saved tree is read-only, vectors go to the delta buffer once
+        // their uris are stored, so that searches can resolve them
+        add_to_db(_index_size, uris);
+        _index_size += uris.size();
+        add_to_delta(vecs);
+        return;
       }
+    for (size_t i = 0; i < uris.size(); ++i)
+      _aindex->add_item(_index_size + i, &vecs[i][0]);
+    add_to_db(_index_size, uris);
+    _index_size += uris.size();
   }
 
   void AnnoySE::search(const std::vector<double> &vec, const int &nn,
                        std::vector<URIData> &uris,
-                       std::vector<double> &distances)
+                       std::vector<double> &distances,
+                       const SearchParams &params)
   {
     if (!_built_index)
       throw SimSearchException(
           "Cannot search before the Annoy tree has been built");
+    // the tree and delta are swapped together, the delta is scanned
+    // from a snapshot outside of the lock
+    std::shared_ptr<AnnoyIndexSE> aindex;
+    std::shared_ptr<const std::vector<double>> delta;
+    {
+      std::lock_guard<std::mutex> lock(_delta_mutex);
+      aindex = _aindex;
+      delta = _delta;
+    }
+    std::vector<std::pair<double, int>> nns;
+    int nbase = aindex->get_n_items();
+    int ndelta = delta->size() / _f;
+    nns.reserve(ndelta + nn);
+    for (int j = 0; j < ndelta; ++j)
+      nns.emplace_back(angular_distance(&vec[0], delta->data() + j * _f, _f),
+                       nbase + j);
     std::vector<int> result;
-    _aindex->get_nns_by_vector(&vec[0], nn, -1, &result, &distances);
-    for (auto i : result)
+    std::vector<double> result_distances;
+    aindex->get_nns_by_vector(&vec[0], nn, params._search_k, &result,
+                              &result_distances);
+    for (size_t i = 0; i < result.size(); ++i)
+      nns.emplace_back(result_distances[i], result[i]);
+
+    // tree and delta neighbors merged by distance
+    size_t n = std::min(nns.size(), static_cast<size_t>(nn));
+    std::partial_sort(nns.begin(), nns.begin() + n, nns.end());
+    for (size_t i = 0; i < n; ++i)
       {
         URIData uri;
-        get_from_db(i, uri);
+        get_from_db(nns[i].second, uri);
         uris.push_back(uri);
+        distances.push_back(nns[i].first);
       }
   }
 
-  void AnnoySE::add_to_db(const int &idx, const URIData &fmap)
+  void AnnoySE::search_batch(const std::vector<double> &vecs, const int &nn,
+                             std::vector<std::vector<URIData>> &uris,
+                             std::vector<std::vector<double>> &distances,
+                             const SearchParams &params)
   {
-    if (_count_put == 0)
-      _txn = std::unique_ptr<db::Transaction>(_db->NewTransaction());
-    _txn->Put(std::to_string(idx), fmap.encode());
-    ++_count_put;
-    if (_count_put % _count_put_max == 0)
+    if (!_built_index)
+      throw SimSearchException(
+          "Cannot search before the Annoy tree has been built");
+    int nq = vecs.size() / _f;
+    uris.assign(nq, std::vector<URIData>());
+    distances.assign(nq, std::vector<double>());
+    // the tree is read-only, queries are searched concurrently
+    std::vector<std::exception_ptr> errors(nq);
+#pragma omp parallel for schedule(dynamic)
+    for (int q = 0; q < nq; ++q)
       {
-        _txn->Commit(); // batch commit
-        _txn = std::unique_ptr<db::Transaction>(_db->NewTransaction());
+        try
+          {
+            std::vector<double> vec(vecs.begin() + q * _f,
+                                    vecs.begin() + (q + 1) * _f);
+            search(vec, nn, uris[q], distances[q], params);
+          }
+        catch (...)
+          {
+            errors[q] = std::current_exception();
+          }
       }
+    for (auto &e : errors)
+      if (e)
+        std::rethrow_exception(e);
+  }
+
+  void AnnoySE::remove(const std::vector<int> &ids)
+  {
+    (void)ids;
+    throw SimSearchException("Annoy index does not support removal");
+  }
+
+  void AnnoySE::add_to_db(const int &idx, const std::vector<URIData> &fmaps)
+  {
+    _uris.put(idx, fmaps);
   }
 
   void AnnoySE::get_from_db(const int &idx, URIData &fmap)
   {
-    std::string tmp;
-    _db->Get(std::to_string(idx), tmp);
-    fmap.decode(tmp);
+    if (!_uris.get(idx, fmap))
+      throw SimSearchException("No uri for index " + std::to_string(idx));
   }
 
   template class SearchEngine<AnnoySE>;
 #endif
 
+#ifdef USE_HNSW
+  /*- HnswSE -*/
+
+  HnswSE::HnswSE(const int &f, const std::string &model_repo)
+      : _f(f), _model_repo(model_repo)
+  {
+  }
+
+  HnswSE::~HnswSE()
+  {
+  }
+
+  void HnswSE::create_index()
+  {
+    std::string index_filename = _model_repo + "/" + _index_name;
+    if (fileops::file_exists(index_filename))
+      {
+        _hindex = HNSWIndex::load(index_filename, _ondisk);
+        if (!_hindex)
+          throw SimIndexException("Cannot read HNSW index "
+                                  + index_filename);
+        if (_hindex->dim() != _f)
+          throw SimIndexException("HNSW index " + index_filename
+                                  + " dimension does not match");
+      }
+    else
+      {
+        // HNSW<M>, optionally followed by ,SQ8
+        std::vector<std::string> tok = dd_utils::split(_index_key, ',');
+        if (tok.empty() || tok.at(0).compare(0, 4, "HNSW") != 0
+            || (tok.size() > 1 && tok.at(1) != "SQ8") || tok.size() > 2)
+          throw SimIndexException("Unknown HNSW index type " + _index_key);
+        int M = 16;
+        if (tok.at(0).size() > 4)
+          {
+            try
+              {
+                M = std::stoi(tok.at(0).substr(4));
+              }
+            catch (std::exception &e)
+              {
+                throw SimIndexException("Unknown HNSW index type "
+                                        + _index_key);
+              }
+          }
+        _hindex.reset(
+            new HNSWIndex(_f, M, _ef_construction,
+                          tok.size() > 1 ? HNSWIndex::INT8
+                                         : HNSWIndex::FLOAT32));
+      }
+
+    _uris.open(_model_repo);
+  }
+
+  void HnswSE::update_index()
+  {
+    std::string index_path = _model_repo + "/" + _index_name;
+    if (!_hindex->save(index_path))
+      throw SimIndexException("Failed saving HNSW index " + index_path);
+  }
+
+  void HnswSE::remove_index()
+  {
+    fileops::remove_file(_model_repo, _index_name);
+    _uris.remove();
+  }
+
+  void HnswSE::index(const URIData &uri, const std::vector<double> &data)
+  {
+    index(std::vector<URIData>({ uri }),
+          std::vector<std::vector<double>>({ data }));
+  }
+
+  void HnswSE::index(const std::vector<URIData> &uris,
+                     const std::vector<std::vector<double>> &datas)
+  {
+    if (uris.empty())
+      return;
+    std::vector<float> d;
+    for (const std::vector<double> &data : datas)
+      {
+        if (static_cast<int>(data.size()) != _f)
+          throw SimIndexException("indexed vector size "
+                                  + std::to_string(data.size())
+                                  + " does not match index dimension "
+                                  + std::to_string(_f));
+        d.insert(d.end(), data.begin(), data.end());
+      }
+
+    // uris are stored first so that searches can resolve every inserted
+    // vector, must be protected by mutex
+    add_to_db(_hindex->size(), uris);
+    _hindex->add(d.data(), uris.size());
+  }
+
+  void HnswSE::search(const std::vector<double> &vec, const int &nn,
+                      std::vector<URIData> &uris,
+                      std::vector<double> &distances,
+                      const SearchParams &params)
+  {
+    std::vector<float> v(vec.begin(), vec.end());
+    int ef = params._nprobe > 0 ? params._nprobe
+                                : (_nprobe > 0 ? _nprobe : 64);
+    std::vector<std::pair<float, int>> result
+        = _hindex->search(v.data(), nn, ef);
+    for (const std::pair<float, int> &r : result)
+      {
+        URIData uri;
+        get_from_db(r.second, uri);
+        uris.push_back(uri);
+        distances.push_back(r.first / ((double)_f));
+      }
+  }
+
+  void HnswSE::search_batch(const std::vector<double> &vecs, const int &nn,
+                            std::vector<std::vector<URIData>> &uris,
+                            std::vector<std::vector<double>> &distances,
+                            const SearchParams &params)
+  {
+    int nq = vecs.size() / _f;
+    uris.assign(nq, std::vector<URIData>());
+    distances.assign(nq, std::vector<double>());
+    std::vector<std::exception_ptr> errors(nq);
+#pragma omp parallel for schedule(dynamic)
+    for (int q = 0; q < nq; ++q)
+      {
+        try
+          {
+            std::vector<double> vec(vecs.begin() + q * _f,
+                                    vecs.begin() + (q + 1) * _f);
+            search(vec, nn, uris[q], distances[q], params);
+          }
+        catch (...)
+          {
+            errors[q] = std::current_exception();
+          }
+      }
+    for (auto &e : errors)
+      if (e)
+        std::rethrow_exception(e);
+  }
+
+  void HnswSE::remove(const std::vector<int> &ids)
+  {
+    // removed vectors keep routing searches, their uris stay in the store
+    for (int id : ids)
+      _hindex->remove(id);
+  }
+
+  void HnswSE::add_to_db(const int &idx, const std::vector<URIData> &fmaps)
+  {
+    _uris.put(idx, fmaps);
+  }
+
+  void HnswSE::get_from_db(const int &idx, URIData &fmap)
+  {
+    if (!_uris.get(idx, fmap))
+      throw SimSearchException("No uri for index " + std::to_string(idx));
+  }
+
+  template class SearchEngine<HnswSE>;
+#endif
+
 #ifdef USE_FAISS
   FaissSE::FaissSE(const int &f, const std::string &model_repo)
       : _f(f), _model_repo(model_repo)
   {
-    _db = db::GetDB(_db_backend);
     _index_key = std::string("Flat");
   }
 
   FaissSE::~FaissSE()
   {
     delete _findex;
-    if (_db)
-      _db->Close();
-    delete _db;
   }
 
   void FaissSE::create_index()
@@ -360,17 +979,7 @@ namespace dd
       }
 #endif
 
-    std::string db_filename = _model_repo + "/" + _db_name;
-    if (fileops::file_exists(db_filename))
-      {
-        std::cerr << "open existing index db\n";
-        _db->Open(db_filename, db::WRITE);
-      }
-    else
-      {
-        std::cerr << "create index db\n";
-        _db->Open(db_filename, db::NEW);
-      }
+    _uris.open(_model_repo);
   }
 
   void FaissSE::train()
@@ -412,17 +1021,13 @@ namespace dd
 #else
     faiss::write_index(_findex, index_path.c_str());
 #endif
-    _txn->Commit();
-    _txn = std::unique_ptr<db::Transaction>(_db->NewTransaction());
   }
 
   void FaissSE::remove_index()
   {
     fileops::remove_file(_model_repo, _index_name);
     fileops::remove_file(_model_repo, _il_name);
-    std::string db_filename = _model_repo + "/" + _db_name;
-    fileops::clear_directory(db_filename);
-    rmdir(db_filename.c_str());
+    _uris.remove();
   }
 
   void FaissSE::index(const URIData &uri, const std::vector<double> &data)
@@ -440,7 +1045,7 @@ namespace dd
         _train_samples.insert(_train_samples.end(), data.begin(), data.end());
       }
     ++_index_size;
-    add_to_db(idx, uri);
+    add_to_db(idx, { uri });
   }
 
   void FaissSE::index(const std::vector<URIData> &uris,
@@ -463,66 +1068,93 @@ namespace dd
                                 data.end());
       }
     _index_size += uris.size();
-    for (unsigned long int i = 0; i < uris.size(); ++i)
-      add_to_db(idx + i, uris[i]);
+    add_to_db(idx, uris);
   }
 
   void FaissSE::search(const std::vector<double> &vec, const int &nn,
                        std::vector<URIData> &uris,
-                       std::vector<double> &distances)
+                       std::vector<double> &distances,
+                       const SearchParams &params)
   {
-    if (!_findex->is_trained)
-      train();
-    std::vector<long int> labels(nn, -1);
-    std::vector<float> d(nn, -1.0);
-    std::vector<float> v(vec.begin(), vec.end());
+    std::vector<std::vector<URIData>> batch_uris;
+    std::vector<std::vector<double>> batch_distances;
+    search_batch(vec, nn, batch_uris, batch_distances, params);
+    uris.insert(uris.end(), batch_uris[0].begin(), batch_uris[0].end());
+    distances.insert(distances.end(), batch_distances[0].begin(),
+                     batch_distances[0].end());
+  }
+
+  void FaissSE::search_batch(const std::vector<double> &vecs, const int &nn,
+                             std::vector<std::vector<URIData>> &uris,
+                             std::vector<std::vector<double>> &distances,
+                             const SearchParams &params)
+  {
+    {
+      // concurrent searches of an untrained index train it once
+      std::lock_guard<std::mutex> lock(_train_mutex);
+      if (!_findex->is_trained)
+        train();
+    }
+    int nq = vecs.size() / _f;
+    std::vector<long int> labels(nq * nn, -1);
+    std::vector<float> d(nq * nn, -1.0);
+    std::vector<float> v(vecs.begin(), vecs.end());
+
+    // nprobe goes with the call, the shared index is left untouched
+    faiss::SearchParametersIVF ivf_params;
+    faiss::SearchParameters *search_params = nullptr;
     faiss::IndexIVF *iivf = dynamic_cast<faiss::IndexIVF *>(_findex);
     if (iivf)
       {
-        if (_nprobe == -1)
-          {
-            int np = iivf->nlist / 50;
-            if (np < 2)
-              iivf->nprobe = 2;
-            else
-              iivf->nprobe = np;
-          }
-        else
-          iivf->nprobe = _nprobe;
+        int nprobe = params._nprobe > 0 ? params._nprobe : _nprobe;
+        if (nprobe <= 0)
+          nprobe = std::max(2, static_cast<int>(iivf->nlist / 50));
+        ivf_params.nprobe = nprobe;
+        search_params = &ivf_params;
       }
 
-    _findex->search(1, v.data(), nn, d.data(), labels.data());
-    for (int i = 0; i < nn; ++i)
-      {
-        long int label = labels[i];
-        if (label != -1)
-          {
-            URIData uri;
-            get_from_db(label, uri);
-            uris.push_back(uri);
-            distances.push_back(d[i] / ((double)vec.size()));
-          }
-      }
+    // all queries in a single call, faiss parallelizes over queries
+    {
+#ifdef USE_GPU_FAISS
+      std::unique_lock<std::mutex> gpu_lock(_gpu_search_mutex,
+                                            std::defer_lock);
+      if (_gpu)
+        gpu_lock.lock();
+#endif
+      _findex->search(nq, v.data(), nn, d.data(), labels.data(),
+                      search_params);
+    }
+    uris.assign(nq, std::vector<URIData>());
+    distances.assign(nq, std::vector<double>());
+    for (int q = 0; q < nq; ++q)
+      for (int i = 0; i < nn; ++i)
+        {
+          long int label = labels[q * nn + i];
+          if (label != -1)
+            {
+              URIData uri;
+              get_from_db(label, uri);
+              uris[q].push_back(uri);
+              distances[q].push_back(d[q * nn + i] / ((double)_f));
+            }
+        }
   }
 
-  void FaissSE::add_to_db(const int &idx, const URIData &fmap)
+  void FaissSE::remove(const std::vector<int> &ids)
   {
-    if (_count_put == 0)
-      _txn = std::unique_ptr<db::Transaction>(_db->NewTransaction());
-    _txn->Put(std::to_string(idx), fmap.encode());
-    ++_count_put;
-    if (_count_put % _count_put_max == 0)
-      {
-        _txn->Commit(); // batch commit
-        _txn = std::unique_ptr<db::Transaction>(_db->NewTransaction());
-      }
+    (void)ids;
+    throw SimSearchException("Faiss index does not support removal");
+  }
+
+  void FaissSE::add_to_db(const int &idx, const std::vector<URIData> &fmaps)
+  {
+    _uris.put(idx, fmaps);
   }
 
   void FaissSE::get_from_db(const int &idx, URIData &fmap)
   {
-    std::string tmp;
-    _db->Get(std::to_string(idx), tmp);
-    fmap.decode(tmp);
+    if (!_uris.get(idx, fmap))
+      throw SimSearchException("No uri for index " + std::to_string(idx));
   }
 
   template class SearchEngine<FaissSE>;
@@ -26,6 +26,8 @@
 #ifdef USE_ANNOY
 #include "annoylib.h"
 #include "kissrandom.h"
+#elif USE_HNSW
+#include "hnsw_index.h"
 #else
 #include <faiss/IndexFlat.h>
 #include <faiss/index_io.h>
@@ -41,7 +43,12 @@
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #include "utils/db.hpp"
 #pragma GCC diagnostic pop
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <boost/thread/shared_mutex.hpp>
+#include "utils/mapped_file.hpp"
 
 namespace dd
 {
@@ -87,6 +94,20 @@ namespace dd
     std::string _s;
   };
 
+  /**
+   * \brief per-query search parameters, they are passed down to the index
+   *        instead of being set on it, so that concurrent searches may use
+   *        different values
+   */
+  class SearchParams
+  {
+  public:
+    int _nprobe = -1;   /**< faiss IVF lists visited, HNSW candidate list
+                           size, -1 for the index default. */
+    int _search_k = -1; /**< annoy tree nodes inspected, -1 for the annoy
+                           default of nn x ntrees. */
+  };
+
   /**
    * \brief stored feature map
    */
@@ -115,6 +136,68 @@ namespace dd
     static char _enc_char;
   };
 
+  /**
+   * \brief dense, index-addressed store of indexed uris: an offset table
+   *        and packed binary records, both memory mapped, so that resolving
+   *        a search hit is an array lookup
+   */
+  class URIStore
+  {
+  public:
+    URIStore()
+    {
+    }
+    ~URIStore();
+
+    /**
+     * \brief opens or creates the store, converts a legacy LMDB names db
+     * @param model_repo directory holding the store files
+     */
+    void open(const std::string &model_repo);
+
+    void close();
+
+    /**
+     * \brief removes the store files
+     */
+    void remove();
+
+    /**
+     * \brief writes a batch of uris with consecutive ids
+     * @param idx id of the first uri, ids below idx without uri are left
+     *        empty
+     * @param uris uris to store
+     */
+    void put(const int &idx, const std::vector<URIData> &uris);
+
+    /**
+     * \brief reads a uri
+     * @return false if there is no uri with this id
+     */
+    bool get(const int &idx, URIData &uri) const;
+
+    /** Number of ids, the largest stored id plus one */
+    int size() const;
+
+    const std::string _offsets_name = "names.idx";
+    const std::string _records_name = "names.dat";
+    const std::string _legacy_db_name = "names.bin"; /**< former LMDB. */
+
+  private:
+    void map();
+
+    void import_legacy_db();
+
+    std::string file_path(const std::string &name) const;
+
+    std::string _model_repo;
+    std::string _file_suffix; /**< set while importing the legacy db. */
+    std::unique_ptr<MappedFile> _offsets; /**< uint64 offset per id. */
+    std::unique_ptr<MappedFile> _records; /**< packed records. */
+    uint64_t _records_size = 0;           /**< records file size. */
+    mutable boost::shared_mutex _mutex;   /**< exclusive on remapping. */
+  };
+
   template <class TSE> class SearchEngine
   {
   public:
@@ -134,20 +217,58 @@ namespace dd
                const std::vector<std::vector<double>> &data);
 
     void search(const std::vector<double> &data, const int &nn,
-                std::vector<URIData> &uris, std::vector<double> &distances);
+                std::vector<URIData> &uris, std::vector<double> &distances,
+                const SearchParams &params = SearchParams());
+
+    /**
+     * \brief batch search, runs all queries of a call at once
+     * @param data queries as the rows of a contiguous row-major matrix
+     * @param nn number of nearest neighbors per query
+     * @param uris nearest neighbors, one vector per query
+     * @param distances nearest neighbors distances, one vector per query
+     * @param params search parameters of this call
+     */
+    void search_batch(const std::vector<double> &data, const int &nn,
+                      std::vector<std::vector<URIData>> &uris,
+                      std::vector<std::vector<double>> &distances,
+                      const SearchParams &params = SearchParams());
+
+    /**
+     * \brief removes indexed vectors from search results, waits for
+     *        running searches
+     * @param ids ids of the vectors to remove
+     */
+    void remove(const std::vector<int> &ids);
 
     const int _dim = 128; /**< indexed vector length. */
     TSE *_tse = nullptr;
     std::mutex _index_mutex; /**< mutex around indexing calls. */
+    boost::shared_mutex
+        _search_mutex; /**< shared on searches, exclusive on index updates,
+                          and on indexing unless the engine supports
+                          searches during insertions. */
   };
 
 #ifdef USE_ANNOY
+  typedef AnnoyIndex<int, double, Angular, Kiss32Random,
+                     AnnoyIndexSingleThreadedBuildPolicy>
+      AnnoyIndexSE;
+
+  /**
+   * \brief Annoy search engine. Once the tree has been saved, newly indexed
+   *        vectors go to a brute-force delta buffer searched alongside the
+   *        tree, and a background thread rebuilds the tree from base and
+   *        delta vectors and swaps it in.
+   */
   class AnnoySE
   {
   public:
     AnnoySE(const int &f, const std::string &model_repo);
     ~AnnoySE();
 
+    /** tree items cannot be added while searching */
+    static const bool _concurrent_index = false;
+
     // interface
     void create_index();
 
@@ -161,7 +282,16 @@ namespace dd
                const std::vector<std::vector<double>> &datas);
 
     void search(const std::vector<double> &vec, const int &nn,
-                std::vector<URIData> &uris, std::vector<double> &distances);
+                std::vector<URIData> &uris, std::vector<double> &distances,
+                const SearchParams &params = SearchParams());
+
+    void search_batch(const std::vector<double> &vecs, const int &nn,
+                      std::vector<std::vector<URIData>> &uris,
+                      std::vector<std::vector<double>> &distances,
+                      const SearchParams &params = SearchParams());
+
+    /** not supported, throws */
+    void remove(const std::vector<int> &ids);
 
     // internal functions
     void build_tree();
@@ -170,7 +300,14 @@ namespace dd
 
     void save_tree();
 
-    void add_to_db(const int &idx, const URIData &fmap);
+    /**
+     * \brief rebuilds the saved tree with the delta vectors, saves it and
+     *        swaps it in place of the current tree, searches keep running
+     *        on the current tree meanwhile.
+     */
+    void rebuild_tree();
+
+    void add_to_db(const int &idx, const std::vector<URIData> &fmaps);
 
     void get_from_db(const int &idx, URIData &fmap);
 
@@ -179,24 +316,103 @@ namespace dd
       _ntrees = ntrees;
     }
 
+    /**
+     * \brief number of vectors in the delta buffer
+     */
+    int delta_size();
+
     int _f = 128;      /**< indexed vector length. */
     int _ntrees = 100; /**< number of trees. */
-    AnnoyIndex<int, double, Angular, Kiss32Random,
-               AnnoyIndexSingleThreadedBuildPolicy> *_aindex
-        = nullptr;
+    std::shared_ptr<AnnoyIndexSE> _aindex; /**< current tree. */
     int _index_size = 0;
     std::string _model_repo; /**< model directory */
-    const std::string _db_name = "names.bin";
-    const std::string _db_backend = "lmdb";
-    db::DB *_db = nullptr;
-    std::unique_ptr<db::Transaction> _txn;
-    int _count_put = 0;
-    int _count_put_max = 1000;
+    URIStore _uris;          /**< indexed uris. */
     const std::string _index_name = "index.ann";
     bool _saved_tree = false;  /**< whether the tree has been saved. */
     bool _built_index = false; /**< whether the index has been built. */
     bool _map_populate = true; /**< whether to use MAP_POPULATE when mmapping
                                   the full index. */
+
+    int _delta_max = 10000; /**< delta size that triggers a rebuild. */
+    int _rebuild_period = 60; /**< seconds between rebuilds of a non-empty
+                                 delta. */
+
+  private:
+    void add_to_delta(const std::vector<std::vector<double>> &vecs);
+
+    void rebuild_loop();
+
+    void stop_rebuild();
+
+    /** vectors indexed after the tree has been saved, ids follow the tree
+     * ids. Replaced on changes, searches scan a snapshot */
+    std::shared_ptr<const std::vector<double>> _delta
+        = std::make_shared<const std::vector<double>>();
+    std::mutex _delta_mutex; /**< guards the tree and delta swaps. */
+    std::mutex _rebuild_mutex;  /**< one rebuild at a time. */
+    std::condition_variable _rebuild_cv;
+    std::thread _rebuild_thread;
+    bool _rebuild_stop = false;
+  };
+#endif
+
+#ifdef USE_HNSW
+  /**
+   * \brief built-in HNSW graph search engine, vectors can be indexed and
+   *        removed at any time and are searchable right away
+   */
+  class HnswSE
+  {
+  public:
+    HnswSE(const int &f, const std::string &model_repo);
+    ~HnswSE();
+
+    /** graph insertions run alongside searches */
+    static const bool _concurrent_index = true;
+
+    // interface
+    void create_index();
+
+    void update_index();
+
+    void remove_index();
+
+    void index(const URIData &uri, const std::vector<double> &data);
+
+    void index(const std::vector<URIData> &uris,
+               const std::vector<std::vector<double>> &datas);
+
+    void search(const std::vector<double> &vec, const int &nn,
+                std::vector<URIData> &uris, std::vector<double> &distances,
+                const SearchParams &params = SearchParams());
+
+    void search_batch(const std::vector<double> &vecs, const int &nn,
+                      std::vector<std::vector<URIData>> &uris,
+                      std::vector<std::vector<double>> &distances,
+                      const SearchParams &params = SearchParams());
+
+    /**
+     * \brief removes indexed vectors from search results, saved with the
+     *        next update_index()
+     */
+    void remove(const std::vector<int> &ids);
+
+    void add_to_db(const int &idx, const std::vector<URIData> &fmaps);
+
+    void get_from_db(const int &idx, URIData &fmap);
+
+    std::unique_ptr<HNSWIndex> _hindex;
+    std::string _index_key = "HNSW16"; /**< HNSW<M>, HNSW<M>,SQ8 for 8-bit
+                                          vector storage. */
+    int _ef_construction = 200;
+
+    int _f = 128; /**< indexed vector length. */
+    std::string _model_repo; /**< model directory */
+    URIStore _uris;          /**< indexed uris. */
+    const std::string _index_name = "index.hnsw";
+    bool _ondisk = true; /**< whether to search the saved graph from a file
+                            mapping. */
+    int _nprobe = -1; /**< search candidate list size, -1 for default. */
   };
 #endif
 
@@ -207,6 +423,9 @@ namespace dd
     FaissSE(const int &f, const std::string &model_repo);
     ~FaissSE();
 
+    /** faiss indexes cannot be added to while searching */
+    static const bool _concurrent_index = false;
+
     // interface
     void create_index();
 
@@ -220,10 +439,19 @@ namespace dd
                const std::vector<std::vector<double>> &datas);
 
     void search(const std::vector<double> &vec, const int &nn,
-                std::vector<URIData> &uris, std::vector<double> &distances);
+                std::vector<URIData> &uris, std::vector<double> &distances,
+                const SearchParams &params = SearchParams());
+
+    void search_batch(const std::vector<double> &vecs, const int &nn,
+                      std::vector<std::vector<URIData>> &uris,
+                      std::vector<std::vector<double>> &distances,
+                      const SearchParams &params = SearchParams());
+
+    /** not supported, throws */
+    void remove(const std::vector<int> &ids);
 
     void train();
-    void add_to_db(const int &idx, const URIData &fmap);
+    void add_to_db(const int &idx, const std::vector<URIData> &fmaps);
     void get_from_db(const int &idx, URIData &fmap);
 
     faiss::Index *_findex = nullptr;
@@ -232,24 +460,22 @@ namespace dd
     int _f = 128; /**< indexed vector length. */
     long int _index_size = 0;
     std::string _model_repo; /**< model directory */
-    const std::string _db_name = "names.bin";
-    const std::string _db_backend = "lmdb";
+    URIStore _uris;          /**< indexed uris. */
     const std::string _index_name = "index.faiss";
     const std::string _il_name = "index_mmap.faiss";
-    db::DB *_db = nullptr;
-    std::unique_ptr<db::Transaction> _txn;
-    int _count_put = 0;
-    int _count_put_max = 1000;
     int _train_samples_size = 100000;
     bool _ondisk = true;
-    int _nprobe = -1;
+    int _nprobe = -1; /**< default IVF lists visited, -1 for nlist/50. */
     std::vector<float> _train_samples;
+    std::mutex _train_mutex; /**< first search of an untrained index. */
 
 #ifdef USE_GPU_FAISS
     bool _gpu = false;
     faiss::Index *_gpu_index;
     std::vector<faiss::gpu::GpuResources *> _gpu_res;
     std::vector<int> _gpuids;
+    std::mutex _gpu_search_mutex; /**< gpu indexes are searched by one
+                                     thread at a time. */
 #endif
   };
 #endif
@@ -0,0 +1,334 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stream.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "resources.h"
+#include "utils/cv_utils.hpp"
+
+namespace dd
+{
+  std::string StreamRunner::to_str(StreamStatus status)
+  {
+    switch (status)
+      {
+      case StreamStatus::RUNNING:
+        return "running";
+      case StreamStatus::ENDED:
+        return "ended";
+      case StreamStatus::ERROR:
+        return "error";
+      }
+    return "unknown";
+  }
+
+  StreamRunner::StreamRunner(const std::string &name, const grab_fn &grab,
+                             const infer_fn &infer,
+                             const oatpp::Object<DTO::StreamOutput> &output,
+                             const double &fps,
+                             const std::shared_ptr<spdlog::logger> &logger)
+      : _name(name), _grab(grab), _infer(infer), _output(output),
+        _fps_out(fps > 0 ? fps : 25.0), _logger(logger),
+        _decoded(output->queue_size), _inferred(output->queue_size),
+        _rendered(output->queue_size)
+  {
+  }
+
+  StreamRunner::~StreamRunner()
+  {
+    stop();
+  }
+
+  void StreamRunner::start()
+  {
+    _threads.emplace_back([this]() { decode_loop(); });
+    _threads.emplace_back([this]() { infer_loop(); });
+    _threads.emplace_back([this]() { render_loop(); });
+    _threads.emplace_back([this]() { encode_loop(); });
+  }
+
+  void StreamRunner::stop()
+  {
+    _stop = true;
+    _decoded.close();
+    _inferred.close();
+    _rendered.close();
+    for (auto &t : _threads)
+      if (t.joinable())
+        t.join();
+    _threads.clear();
+    if (_writer.isOpened())
+      _writer.release();
+  }
+
+  void StreamRunner::fail(const std::string &msg)
+  {
+    _logger->error("stream {} failed: {}", _name, msg);
+    {
+      std::lock_guard<std::mutex> lock(_stats_mutex);
+      _status = StreamStatus::ERROR;
+      _message = msg;
+    }
+    _stop = true;
+    _decoded.close();
+    _inferred.close();
+    _rendered.close();
+  }
+
+  void StreamRunner::add_time(double &avg, const double &ms)
+  {
+    // exponential moving average, follows the live rate of the stream
+    if (avg == 0.0)
+      avg = ms;
+    else
+      avg = 0.9 * avg + 0.1 * ms;
+  }
+
+  void StreamRunner::decode_loop()
+  {
+    while (!_stop)
+      {
+        StreamFrame frame;
+        frame._tstart = std::chrono::steady_clock::now();
+        try
+          {
+            frame._img = _grab();
+          }
+        catch (ResourceForbiddenException &e)
+          {
+            // resource is exhausted
+            break;
+          }
+        catch (std::exception &e)
+          {
+            fail(e.what());
+            return;
+          }
+        if (frame._img.empty())
+          break;
+
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - frame._tstart)
+                        .count();
+        {
+          std::lock_guard<std::mutex> lock(_stats_mutex);
+          add_time(_decode_time, ms);
+        }
+        if (!_decoded.push(std::move(frame)))
+          return;
+      }
+    _decoded.close();
+  }
+
+  void StreamRunner::infer_loop()
+  {
+    StreamFrame frame;
+    while (!_stop && _decoded.pop(frame))
+      {
+        auto tstart = std::chrono::steady_clock::now();
+        try
+          {
+            frame._out = _infer(frame._img);
+          }
+        catch (std::exception &e)
+          {
+            fail(e.what());
+            return;
+          }
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - tstart)
+                        .count();
+        {
+          std::lock_guard<std::mutex> lock(_stats_mutex);
+          add_time(_infer_time, ms);
+        }
+        if (!_inferred.push(std::move(frame)))
+          return;
+      }
+    _inferred.close();
+  }
+
+  void StreamRunner::render_loop()
+  {
+    StreamFrame frame;
+    while (!_stop && _inferred.pop(frame))
+      {
+        auto tstart = std::chrono::steady_clock::now();
+        if (_output->draw_bbox)
+          {
+            try
+              {
+                draw(frame);
+              }
+            catch (std::exception &e)
+              {
+                fail(e.what());
+                return;
+              }
+          }
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - tstart)
+                        .count();
+        {
+          std::lock_guard<std::mutex> lock(_stats_mutex);
+          add_time(_render_time, ms);
+        }
+        if (!_rendered.push(std::move(frame)))
+          return;
+      }
+    _rendered.close();
+  }
+
+  void StreamRunner::encode_loop()
+  {
+    StreamFrame frame;
+    while (!_stop && _rendered.pop(frame))
+      {
+        auto tstart = std::chrono::steady_clock::now();
+        try
+          {
+            if (_output->video_out != nullptr && !_writer.isOpened())
+              open_writer(frame._img);
+            if (_writer.isOpened())
+              _writer.write(frame._img);
+          }
+        catch (std::exception &e)
+          {
+            fail(e.what());
+            return;
+          }
+        auto tstop = std::chrono::steady_clock::now();
+        double ms
+            = std::chrono::duration<double, std::milli>(tstop - tstart).count();
+        double latency
+            = std::chrono::duration<double, std::milli>(tstop - frame._tstart)
+                  .count();
+
+        std::lock_guard<std::mutex> lock(_stats_mutex);
+        add_time(_encode_time, ms);
+        if (_frames > 0)
+          {
+            double dt
+                = std::chrono::duration<double>(tstop - _tlast).count();
+            if (dt > 0.0)
+              add_time(_fps, 1.0 / dt);
+          }
+        _tlast = tstop;
+        _latency = (_latency * _frames + latency) / (_frames + 1);
+        _last_latency = latency;
+        ++_frames;
+      }
+
+    if (_writer.isOpened())
+      _writer.release();
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    if (_status == StreamStatus::RUNNING)
+      {
+        _status = StreamStatus::ENDED;
+        _logger->info("stream {} ended after {} frames", _name, _frames);
+      }
+  }
+
+  /** bbox coordinates may come out as integers from the JSON output */
+  static int bbox_coord(const APIData &bbox, const std::string &key)
+  {
+    auto val = bbox.get(key);
+    if (val.is<double>())
+      return static_cast<int>(val.get<double>());
+    else if (val.is<int>())
+      return val.get<int>();
+    else if (val.is<long int>())
+      return static_cast<int>(val.get<long int>());
+    return static_cast<int>(val.get<long long int>());
+  }
+
+  void StreamRunner::draw(StreamFrame &frame) const
+  {
+    if (!frame._out.has("predictions"))
+      return;
+    std::vector<APIData> preds = frame._out.getv("predictions");
+    for (APIData &pred : preds)
+      {
+        if (!pred.has("classes"))
+          continue;
+        std::vector<APIData> classes = pred.getv("classes");
+        for (APIData &cls : classes)
+          {
+            if (!cls.has("bbox"))
+              continue;
+            APIData bbox = cls.getobj("bbox");
+            cv::Point pt1{ bbox_coord(bbox, "xmin"),
+                           bbox_coord(bbox, "ymin") };
+            cv::Point pt2{ bbox_coord(bbox, "xmax"),
+                           bbox_coord(bbox, "ymax") };
+            std::string cat = cls.has("cat")
+                                  ? cls.get("cat").get<std::string>()
+                                  : std::string();
+            cv_utils::draw_bbox(frame._img, pt1, pt2, cat, cat, 2);
+          }
+      }
+  }
+
+  void StreamRunner::open_writer(const cv::Mat &frame)
+  {
+    std::string video_out = _output->video_out;
+    std::string encoding = _output->video_encoding;
+    int fourcc = 0;
+    if (encoding.size() == 4)
+      fourcc = cv::VideoWriter::fourcc(encoding[0], encoding[1], encoding[2],
+                                       encoding[3]);
+    else if (!encoding.empty())
+      throw ResourceBadParamException("Invalid video encoding: " + encoding);
+
+    cv::VideoCaptureAPIs backend = cv::CAP_ANY;
+    if (boost::algorithm::starts_with(video_out, "appsrc"))
+      backend = cv::CAP_GSTREAMER;
+    else if (_output->video_backend != nullptr)
+      backend
+          = VideoResource::get_video_backend_by_name(_output->video_backend);
+
+    _logger->info("Opening VideoWriter on {}, {}x{} - {} fps", video_out,
+                  frame.cols, frame.rows, _fps_out);
+    _writer.open(video_out, backend, fourcc, _fps_out,
+                 cv::Size(frame.cols, frame.rows));
+    if (!_writer.isOpened())
+      throw ResourceInternalException("Video output \"" + video_out
+                                      + "\" could not be opened");
+  }
+
+  void StreamRunner::fill_info(oatpp::Object<DTO::StreamResponseBody> &body)
+  {
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    body->name = _name.c_str();
+    body->status = to_str(_status).c_str();
+    if (!_message.empty())
+      body->message = _message.c_str();
+    body->frames = _frames;
+    body->fps = _status == StreamStatus::RUNNING ? _fps : 0.0;
+    body->latency = _latency;
+    body->last_latency = _last_latency;
+    body->decode_time = _decode_time;
+    body->infer_time = _infer_time;
+    body->render_time = _render_time;
+    body->encode_time = _encode_time;
+  }
+}
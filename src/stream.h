@@ -0,0 +1,272 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <opencv2/opencv.hpp>
+
+#include "apidata.h"
+#include "dd_spdlog.h"
+#include "dto/stream.hpp"
+
+namespace dd
+{
+  /**
+   * \brief stream bad parameter exception
+   */
+  class StreamBadParamException : public std::exception
+  {
+  public:
+    StreamBadParamException(const std::string &s) : _s(s)
+    {
+    }
+    ~StreamBadParamException()
+    {
+    }
+    const char *what() const noexcept
+    {
+      return _s.c_str();
+    }
+
+  private:
+    std::string _s;
+  };
+
+  /**
+   * \brief stream forbidden operation exception
+   */
+  class StreamForbiddenException : public std::exception
+  {
+  public:
+    StreamForbiddenException(const std::string &s) : _s(s)
+    {
+    }
+    ~StreamForbiddenException()
+    {
+    }
+    const char *what() const noexcept
+    {
+      return _s.c_str();
+    }
+
+  private:
+    std::string _s;
+  };
+
+  /**
+   * \brief stream not found exception
+   */
+  class StreamNotFoundException : public std::exception
+  {
+  public:
+    StreamNotFoundException(const std::string &s) : _s(s)
+    {
+    }
+    ~StreamNotFoundException()
+    {
+    }
+    const char *what() const noexcept
+    {
+      return _s.c_str();
+    }
+
+  private:
+    std::string _s;
+  };
+
+  /**
+   * \brief bounded blocking queue between two stages of a stream pipeline
+   */
+  template <typename T> class StreamQueue
+  {
+  public:
+    StreamQueue(const size_t &max_size) : _max_size(max_size)
+    {
+    }
+
+    /**
+     * \brief blocks while the queue is full
+     * @return false if the queue was closed
+     */
+    bool push(T &&elt)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _not_full.wait(lock, [this]() {
+        return _closed || _queue.size() < _max_size;
+      });
+      if (_closed)
+        return false;
+      _queue.push_back(std::move(elt));
+      _not_empty.notify_one();
+      return true;
+    }
+
+    /**
+     * \brief blocks while the queue is empty
+     * @return false if the queue was closed and all elements consumed
+     */
+    bool pop(T &elt)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _not_empty.wait(lock, [this]() { return _closed || !_queue.empty(); });
+      if (_queue.empty())
+        return false;
+      elt = std::move(_queue.front());
+      _queue.pop_front();
+      _not_full.notify_one();
+      return true;
+    }
+
+    /** No more elements are pushed, consumers drain what is left. */
+    void close()
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _closed = true;
+      _not_empty.notify_all();
+      _not_full.notify_all();
+    }
+
+  private:
+    size_t _max_size;
+    std::deque<T> _queue;
+    std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    bool _closed = false;
+  };
+
+  enum class StreamStatus
+  {
+    RUNNING,
+    ENDED,
+    ERROR
+  };
+
+  /**
+   * \brief continuous processing of a resource: every element goes through
+   *        decode -> infer -> render -> encode stages, each stage running on
+   *        its own thread so that consecutive frames overlap.
+   */
+  class StreamRunner
+  {
+  public:
+    /** pulls the next frame, throws ResourceForbiddenException at the end */
+    typedef std::function<cv::Mat()> grab_fn;
+    /** predict or chain call on a frame, returns the call output */
+    typedef std::function<APIData(const cv::Mat &)> infer_fn;
+
+    static std::string to_str(StreamStatus status);
+
+    /**
+     * \brief stream creation
+     * @param name stream name
+     * @param grab resource frame grabbing
+     * @param infer predict or chain call on a frame
+     * @param output stream output parameters
+     * @param fps output video frame rate
+     * @param logger stream logger
+     */
+    StreamRunner(const std::string &name, const grab_fn &grab,
+                 const infer_fn &infer,
+                 const oatpp::Object<DTO::StreamOutput> &output,
+                 const double &fps,
+                 const std::shared_ptr<spdlog::logger> &logger);
+
+    /** Stops the stream and waits for its threads. */
+    ~StreamRunner();
+
+    /** Starts the pipeline threads. */
+    void start();
+
+    /** Stops the pipeline, frames in flight are dropped. */
+    void stop();
+
+    /** Fills up stream status and live statistics. */
+    void fill_info(oatpp::Object<DTO::StreamResponseBody> &body);
+
+  private:
+    /**
+     * \brief a frame going through the pipeline
+     */
+    class StreamFrame
+    {
+    public:
+      cv::Mat _img;
+      APIData _out; /**< predict or chain output. */
+      std::chrono::steady_clock::time_point _tstart; /**< decoding date. */
+    };
+
+    void decode_loop();
+    void infer_loop();
+    void render_loop();
+    void encode_loop();
+
+    /** Draws predicted bboxes onto the frame. */
+    void draw(StreamFrame &frame) const;
+
+    /** Opens the video writer with the first frame size. */
+    void open_writer(const cv::Mat &frame);
+
+    /** Ends the stream with an error, all stages stop. */
+    void fail(const std::string &msg);
+
+    /** Adds a measure to a running average. */
+    void add_time(double &avg, const double &ms);
+
+    std::string _name;
+    grab_fn _grab;
+    infer_fn _infer;
+    oatpp::Object<DTO::StreamOutput> _output;
+    double _fps_out; /**< output video frame rate. */
+    std::shared_ptr<spdlog::logger> _logger;
+
+    StreamQueue<StreamFrame> _decoded;
+    StreamQueue<StreamFrame> _inferred;
+    StreamQueue<StreamFrame> _rendered;
+    std::atomic<bool> _stop = { false };
+    std::vector<std::thread> _threads;
+
+    cv::VideoWriter _writer;
+
+    // status and statistics
+    std::mutex _stats_mutex;
+    StreamStatus _status = StreamStatus::RUNNING;
+    std::string _message;
+    int64_t _frames = 0;
+    double _fps = 0.0;
+    double _latency = 0.0;
+    double _last_latency = 0.0;
+    double _decode_time = 0.0;
+    double _infer_time = 0.0;
+    double _render_time = 0.0;
+    double _encode_time = 0.0;
+    std::chrono::steady_clock::time_point _tlast; /**< last frame written. */
+  };
+}
+
+#endif
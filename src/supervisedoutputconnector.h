@@ -477,7 +477,7 @@ namespace dd
           // index output content
           if (!has_roi)
             {
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
               std::vector<URIData> urids;
               std::vector<std::vector<double>> probsv;
 #endif
@@ -491,7 +491,7 @@ namespace dd
                       ++mit;
                     }
                   URIData urid(bcats._vvcats.at(i)._label);
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
                   urids.push_back(urid);
                   probsv.push_back(probs);
 #else
@@ -499,7 +499,7 @@ namespace dd
 #endif
                   indexed_uris.insert(urid._uri);
                 }
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
               mlm->_se->index(urids, probsv);
 #endif
             }
@@ -511,7 +511,7 @@ namespace dd
                   auto vit = bcats._vvcats.at(i)._vals.begin();
                   auto bit = bcats._vvcats.at(i)._bboxes.begin();
                   auto mit = bcats._vvcats.at(i)._cats.begin();
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
                   std::vector<URIData> urids;
                   std::vector<std::vector<double>> datas;
 #endif
@@ -526,7 +526,7 @@ namespace dd
                       std::string cat = (*mit).second;
                       URIData urid(bcats._vvcats.at(i)._label, bbox, prob,
                                    cat);
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
                       urids.push_back(urid);
                       datas.push_back((*vit)
                                           .second.get("vals")
@@ -542,7 +542,7 @@ namespace dd
                       ++nrois;
                       indexed_uris.insert(urid._uri);
                     }
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
                   mlm->_se->index(urids, datas);
 #endif
                 }
@@ -581,29 +581,60 @@ namespace dd
             search_nn = _search_nn;
           if (output_params->search_nn)
             search_nn = output_params->search_nn;
-#ifdef USE_FAISS
+          SearchParams search_params;
           if (output_params->nprobe)
-            mlm->_se->_tse->_nprobe = output_params->nprobe;
-#endif
-          if (!has_roi)
+            search_params._nprobe = output_params->nprobe;
+          if (output_params->search_k)
+            search_params._search_k = output_params->search_k;
+          // queries of the whole batch, one per result or per bbox, are
+          // searched at once
+          std::vector<double> queries;
+          for (size_t i = 0; i < bcats._vvcats.size(); i++)
             {
-              for (size_t i = 0; i < bcats._vvcats.size(); i++)
+              if (!has_roi)
                 {
-                  std::vector<double> probs;
                   auto mit = bcats._vvcats.at(i)._cats.begin();
                   while (mit != bcats._vvcats.at(i)._cats.end())
                     {
-                      probs.push_back((*mit).first);
+                      queries.push_back((*mit).first);
+                      ++mit;
+                    }
+                }
+              else
+                {
+                  auto vit = bcats._vvcats.at(i)._vals.begin();
+                  auto mit = bcats._vvcats.at(i)._cats.begin();
+                  while (mit
+                         != bcats._vvcats.at(i)
+                                ._cats
+                                .end()) // equivalent to iterating the bboxes
+                    {
+                      APIData ad_vals = (*vit).second;
+                      std::vector<double> vals
+                          = ad_vals.get("vals").get<std::vector<double>>();
+                      queries.insert(queries.end(), vals.begin(), vals.end());
                       ++mit;
+                      ++vit;
                     }
-                  std::vector<URIData> nn_uris;
-                  std::vector<double> nn_distances;
-                  mlm->_se->search(probs, search_nn, nn_uris, nn_distances);
-                  for (size_t j = 0; j < nn_uris.size(); j++)
+                }
+            }
+          std::vector<std::vector<URIData>> nn_uris;
+          std::vector<std::vector<double>> nn_distances;
+          if (!queries.empty())
+            mlm->_se->search_batch(queries, search_nn, nn_uris,
+                                   nn_distances, search_params);
+
+          size_t q = 0; // query index
+          if (!has_roi)
+            {
+              for (size_t i = 0; i < bcats._vvcats.size(); i++)
+                {
+                  for (size_t j = 0; j < nn_uris.at(q).size(); j++)
                     {
-                      bcats._vvcats.at(i).add_nn(nn_distances.at(j),
-                                                 nn_uris.at(j));
+                      bcats._vvcats.at(i).add_nn(nn_distances.at(q).at(j),
+                                                 nn_uris.at(q).at(j));
                     }
+                  ++q;
                 }
             }
           else if (has_roi && has_multibox_rois)
@@ -614,50 +645,42 @@ namespace dd
                       multibox_nn; // one uri (image) / total distance, count
                   std::unordered_map<std::string,
                                      std::pair<double, int>>::iterator hit;
-                  auto vit = bcats._vvcats.at(i)._vals.begin();
                   auto mit = bcats._vvcats.at(i)._cats.begin();
                   while (mit
                          != bcats._vvcats.at(i)
                                 ._cats
                                 .end()) // equivalent to iterating the bboxes
                     {
-                      std::vector<URIData> nn_uris;
-                      std::vector<double> nn_distances;
-                      mlm->_se->search(
-                          (*vit).second.get("vals").get<std::vector<double>>(),
-                          search_nn, nn_uris, nn_distances);
-                      for (size_t j = 0; j < nn_uris.size(); j++)
+                      for (size_t j = 0; j < nn_uris.at(q).size(); j++)
                         {
-                          if ((hit = multibox_nn.find(nn_uris.at(j)._uri))
+                          const URIData &nn_uri = nn_uris.at(q).at(j);
+                          double nn_distance = nn_distances.at(q).at(j);
+                          if ((hit = multibox_nn.find(nn_uri._uri))
                               == multibox_nn.end())
                             {
                               double mb_dist = multibox_distance(
-                                  nn_distances.at(j), nn_uris.at(j)._prob);
+                                  nn_distance, nn_uri._prob);
                               multibox_nn.insert(
                                   std::pair<std::string,
                                             std::pair<double, int>>(
-                                      nn_uris.at(j)._uri,
+                                      nn_uri._uri,
                                       std::pair<double, int>(mb_dist, 1)));
                             }
                           else
                             {
                               (*hit).second.first += multibox_distance(
-                                  nn_distances.at(j), nn_uris.at(j)._prob);
+                                  nn_distance, nn_uri._prob);
                               (*hit).second.second += 1;
                             }
                         }
 
                       ++mit;
-                      ++vit;
+                      ++q;
                     }
                   // final ranking per images and store final results here
                   hit = multibox_nn.begin();
                   while (hit != multibox_nn.end()) // unsorted
                     {
-                      // std::cerr << "adding uri=" << (*hit).first << " /
-                      // dist=" << (*hit).second.first /
-                      // static_cast<double>((*hit).second.second) <<
-                      // std::endl;
                       bcats._vvcats.at(i).add_nn(
                           (*hit).second.first
                               / static_cast<double>((*hit).second.second),
@@ -671,25 +694,20 @@ namespace dd
               for (size_t i = 0; i < bcats._vvcats.size(); i++)
                 {
                   int bb = 0;
-                  auto vit = bcats._vvcats.at(i)._vals.begin();
                   auto mit = bcats._vvcats.at(i)._cats.begin();
                   while (mit
                          != bcats._vvcats.at(i)
                                 ._cats
                                 .end()) // equivalent to iterating the bboxes
                     {
-                      std::vector<URIData> nn_uris;
-                      std::vector<double> nn_distances;
-                      mlm->_se->search(
-                          (*vit).second.get("vals").get<std::vector<double>>(),
-                          search_nn, nn_uris, nn_distances);
-                      ++mit;
-                      ++vit;
-                      for (size_t j = 0; j < nn_uris.size(); j++)
+                      for (size_t j = 0; j < nn_uris.at(q).size(); j++)
                         {
                           bcats._vvcats.at(i).add_bbox_nn(
-                              bb, nn_distances.at(j), nn_uris.at(j));
+                              bb, nn_distances.at(q).at(j),
+                              nn_uris.at(q).at(j));
                         }
+                      ++mit;
+                      ++q;
                       ++bb;
                     }
                 }
@@ -22,62 +22,121 @@
 #include "txtinputfileconn.h"
 #include "utils/fileops.hpp"
 #include "utils/utils.hpp"
+#include "utils/mapped_file.hpp"
 #include <boost/tokenizer.hpp>
+#include <atomic>
+#include <exception>
 #include <iostream>
+#include <map>
 
 namespace dd
 {
 
-  void WordPieceTokenizer::append_input(const std::string &word)
+  void WordPieceTokenizer::compile(
+      const std::unordered_map<std::string, Word> &vocab,
+      const uint64_t &generation)
   {
-    int start = 0;
-    std::vector<std::string> subtokens;
-    bool is_bad = false;
+    std::shared_ptr<Trie> trie = std::make_shared<Trie>();
+    trie->_word_start = _word_start;
+    trie->_suffix_start = _suffix_start;
+    trie->_generation = generation;
+    for (auto const &w : vocab)
+      if (w.second._pos >= static_cast<int>(trie->_pieces.size()))
+        trie->_pieces.resize(w.second._pos + 1);
 
-    while (start < static_cast<int>(word.size()))
+    // build with per node children maps, then flatten
+    std::vector<std::map<unsigned char, int>> children(2);
+    trie->_piece.assign(2, -1);
+    auto insert = [&](const int &root, const std::string &prefix,
+                      const std::string &tok, const int &id) {
+      if (tok.size() <= prefix.size() || tok.compare(0, prefix.size(), prefix))
+        return;
+      int node = root;
+      for (size_t i = prefix.size(); i < tok.size(); ++i)
+        {
+          unsigned char c = tok[i];
+          auto cit = children[node].find(c);
+          if (cit == children[node].end())
+            {
+              int child = children.size();
+              children[node].emplace(c, child);
+              children.emplace_back();
+              trie->_piece.push_back(-1);
+              node = child;
+            }
+          else
+            node = (*cit).second;
+        }
+      trie->_piece[node] = id;
+    };
+    for (auto const &w : vocab)
       {
-        int end = word.size();
-        std::string cur_substr = "";
-        while (start < end)
-          {
-            std::string substr = word.substr(start, end - start);
-            if (start > 0)
-              {
-                substr = _suffix_start + substr;
-              }
-            else
-              {
-                substr = _word_start + substr;
-              }
-            if (in_vocab(substr))
-              {
-                cur_substr = substr;
-                break;
-              }
-            --end;
-          }
-        if (cur_substr == "")
-          {
-            is_bad = true;
-            break;
-          }
-        subtokens.push_back(cur_substr);
-        start = end;
+        if (w.second._pos < 0)
+          continue;
+        trie->_pieces[w.second._pos] = w.first;
+        insert(_word_root, _word_start, w.first, w.second._pos);
+        insert(_suffix_root, _suffix_start, w.first, w.second._pos);
       }
 
-    if (is_bad)
+    trie->_first_edge.reserve(children.size() + 1);
+    for (const std::map<unsigned char, int> &ch : children)
       {
-        _tokens.push_back(_unk_token);
+        trie->_first_edge.push_back(trie->_label.size());
+        for (auto const &e : ch)
+          {
+            trie->_label.push_back(e.first);
+            trie->_child.push_back(e.second);
+          }
       }
-    else
+    trie->_first_edge.push_back(trie->_label.size());
+    _trie = trie;
+  }
+
+  size_t WordPieceTokenizer::longest_piece(const int &root, const char *s,
+                                           const size_t &len, int &id) const
+  {
+    const Trie &trie = *_trie;
+    const unsigned char *labels = trie._label.data();
+    size_t best = 0;
+    int node = root;
+    for (size_t i = 0; i < len; ++i)
       {
-        _tokens.insert(_tokens.end(), subtokens.begin(), subtokens.end());
+        const unsigned char c = s[i];
+        const unsigned char *first = labels + trie._first_edge[node];
+        const unsigned char *last = labels + trie._first_edge[node + 1];
+        const unsigned char *e = std::lower_bound(first, last, c);
+        if (e == last || *e != c)
+          break;
+        node = trie._child[e - labels];
+        if (trie._piece[node] >= 0)
+          {
+            best = i + 1;
+            id = trie._piece[node];
+          }
       }
+    return best;
   }
 
-  bool WordPieceTokenizer::in_vocab(const std::string &tok)
+  void WordPieceTokenizer::append_ids(const char *word, const size_t &len,
+                                      std::vector<int> &ids) const
   {
-    return _ctfc->_vocab.find(tok) != _ctfc->_vocab.end();
+    size_t nids = ids.size();
+    size_t start = 0;
+    while (start < len)
+      {
+        int id = -1;
+        size_t plen
+            = longest_piece(start == 0 ? _word_root : _suffix_root,
+                            word + start, len - start, id);
+        if (plen == 0)
+          {
+            ids.resize(nids);
+            ids.push_back(-1);
+            return;
+          }
+        ids.push_back(id);
+        start += plen;
+      }
   }
 
   /*- DDTxt -*/
@@ -215,17 +274,51 @@ namespace dd
           }
       }
 
-    // parse content
-    // XXX: parallelize with openmp -> requires thread safe parse_content
-    for (std::pair<std::string, int> &p : lfiles)
+    // parse content: files are read and tokenized in parallel by blocks,
+    // words are then interned into the vocabulary in file order, so that
+    // positions do not depend on scheduling. Entries are handed over after
+    // each block, e.g. to be pushed to a db.
+    const size_t block_size = std::max<size_t>(_ctfc->_dir_block_size, 1);
+    std::vector<TxtEntry<double> *> &txt
+        = test_id < 0 ? _ctfc->_txt
+                      : _ctfc->_tests_txt[static_cast<size_t>(test_id)];
+    for (size_t b = 0; b < lfiles.size(); b += block_size)
       {
-        std::ifstream txt_file(p.first);
-        if (!txt_file.is_open())
-          throw InputConnectorBadParamException("cannot open file " + p.first);
-        std::stringstream buffer;
-        buffer << txt_file.rdbuf();
-        std::string ct = buffer.str();
-        _ctfc->parse_content(ct, p.second, test_id);
+        size_t nfiles = std::min(block_size, lfiles.size() - b);
+        std::vector<std::vector<TxtEntry<double> *>> fentries(nfiles);
+        std::vector<std::exception_ptr> eptrs(nfiles);
+        _ctfc->init_wordpiece(); // blocks may grow the vocabulary
+#pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < nfiles; ++i)
+          {
+            const std::pair<std::string, int> &p = lfiles[b + i];
+            try
+              {
+                MappedFile txt_file(p.first);
+                if (!txt_file.is_open())
+                  throw InputConnectorBadParamException("cannot open file "
+                                                        + p.first);
+                std::string ct;
+                if (txt_file.size() > 0)
+                  ct.assign(txt_file.data(), txt_file.size());
+                _ctfc->tokenize_content(ct, p.second, fentries[i], false);
+              }
+            catch (...)
+              {
+                eptrs[i] = std::current_exception();
+              }
+          }
+        std::exception_ptr eptr;
+        for (size_t i = 0; i < nfiles; ++i)
+          {
+            if (eptrs[i] && !eptr)
+              eptr = eptrs[i];
+            _ctfc->intern_words(fentries[i]);
+            txt.insert(txt.end(), fentries[i].begin(), fentries[i].end());
+          }
+        if (eptr)
+          std::rethrow_exception(eptr);
+        _ctfc->entries_parsed(test_id);
       }
 
     // post-processing
@@ -244,54 +337,52 @@ namespace dd
     if (_ctfc->_train && !test_dir
         && initial_vocab_size != _ctfc->_vocab.size())
       {
-        // update pos
+        // update pos, remaining words keep their order so that BOW rows
+        // only need to drop the removed words
+        int max_pos = -1;
+        for (auto const &w : _ctfc->_vocab)
+          max_pos = std::max(max_pos, w.second._pos);
+        std::vector<int> remap(max_pos + 1, -1);
+        for (auto const &w : _ctfc->_vocab)
+          remap[w.second._pos] = 0;
         int pos = 0;
-        auto vhit = _ctfc->_vocab.begin();
-        while (vhit != _ctfc->_vocab.end())
-          {
-            (*vhit).second._pos = pos;
-            ++pos;
-            ++vhit;
-          }
+        for (int &p : remap)
+          if (p == 0)
+            p = pos++;
+        for (auto &w : _ctfc->_vocab)
+          w.second._pos = remap[w.second._pos];
+        _ctfc->_bow->remap(remap);
+        _ctfc->vocab_changed();
       }
 
-    if (_ctfc->_generate_vocab && !_ctfc->_characters && !test_dir
-        && (initial_vocab_size != _ctfc->_vocab.size() || _ctfc->_tfidf))
+    if (_ctfc->_generate_vocab && !_ctfc->_characters
+        && !_ctfc->_ordered_words && !test_dir && _ctfc->_tfidf)
       {
-        // clearing up the corpus + tfidf
-        std::unordered_map<std::string, Word>::iterator whit;
-        for (TxtEntry<double> *te : _ctfc->_txt)
+        // tfidf, entries are independent and the vocabulary is read only
+        std::vector<const Word *> words;
+        for (auto const &w : _ctfc->_vocab)
           {
-            TxtBowEntry *tbe = static_cast<TxtBowEntry *>(te);
-            auto hit = tbe->_v.begin();
-            while (hit != tbe->_v.end())
+            if (w.second._pos >= static_cast<int>(words.size()))
+              words.resize(w.second._pos + 1, nullptr);
+            words[w.second._pos] = &w.second;
+          }
+        std::vector<TxtEntry<double> *> &corpus = _ctfc->_txt;
+        const double ndocs = static_cast<double>(corpus.size());
+#pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < corpus.size(); ++i)
+          {
+            TxtBowEntry *tbe = static_cast<TxtBowEntry *>(corpus[i]);
+            const int *indices = tbe->indices();
+            double *values = tbe->values();
+            for (size_t k = 0; k < tbe->size(); ++k)
               {
-                if ((whit = _ctfc->_vocab.find((*hit).first))
-                    != _ctfc->_vocab.end())
-                  {
-                    if (_ctfc->_tfidf)
-                      {
-                        Word w = (*whit).second;
-                        (*hit).second
-                            = (std::log(
-                                  1.0
-                                  + (*hit).second
-                                        / static_cast<double>(w._total_count)))
-                              * std::log(
-                                  _ctfc->_txt.size()
-                                      / static_cast<double>(w._total_docs)
-                                  + 1.0);
-                        // std::cerr << "tfidf feature w=" << (*hit).first << "
-                        // / val=" << (*hit).second << std::endl;
-                      }
-                    ++hit;
-                  }
-                else
-                  {
-                    // std::cerr << "removing ws=" << (*hit).first <<
-                    // std::endl;
-                    hit = tbe->_v.erase(hit);
-                  }
+                const Word *w = words[indices[k]];
+                values[k]
+                    = std::log(1.0
+                               + values[k]
+                                     / static_cast<double>(w->_total_count))
+                      * std::log(ndocs / static_cast<double>(w->_total_docs)
+                                 + 1.0);
               }
           }
       }
@@ -318,6 +409,18 @@ namespace dd
   /*- TxtInputFileConn -*/
   void TxtInputFileConn::parse_content(const std::string &content,
                                        const float &target, int test_id)
+  {
+    std::vector<TxtEntry<double> *> &entries
+        = test_id < 0 ? _txt : _tests_txt[static_cast<size_t>(test_id)];
+    init_wordpiece();
+    tokenize_content(content, target, entries);
+    if (_characters)
+      std::cerr << "\rloaded text samples=" << _txt.size();
+  }
+
+  void TxtInputFileConn::tokenize_content(
+      const std::string &content, const float &target,
+      std::vector<TxtEntry<double> *> &entries, const bool &intern)
   {
     if (!_train && content.empty())
       throw InputConnectorBadParamException("no text data found");
@@ -339,7 +442,6 @@ namespace dd
           std::transform(ct.begin(), ct.end(), ct.begin(), ::tolower);
         if (!_characters)
           {
-            std::unordered_map<std::string, Word>::iterator vhit;
             std::vector<std::string> tokens;
             if (_punctuation_tokens)
               {
@@ -378,63 +480,52 @@ namespace dd
                 tokens.insert(tokens.end(), tokenizer.begin(),
                               tokenizer.end());
               }
-            if (_wordpiece_tokens)
-              {
-                _wordpiece_tokenizer.reset();
-                for (const std::string &token : tokens)
-                  {
-                    _wordpiece_tokenizer.append_input(token);
-                  }
-                tokens = std::move(_wordpiece_tokenizer._tokens);
-                _wordpiece_tokenizer._tokens = std::vector<std::string>();
-              }
+            if (_wordpiece_tokens
+                && !_wordpiece_tokenizer.compiled(_vocab_generation))
+              throw InputConnectorInternalException(
+                  "wordpiece tokenizer is not compiled");
 
             if (_ordered_words)
               {
                 TxtOrderedWordsEntry *towe = new TxtOrderedWordsEntry(target);
-                for (std::string w : tokens)
-                  {
-                    towe->add_word(w);
-                  }
-
-                if (test_id < 0)
-                  _txt.push_back(towe);
+                if (_wordpiece_tokens)
+                  for (const std::string &token : tokens)
+                    _wordpiece_tokenizer.append_ids(token.data(),
+                                                    token.size(), towe->_ids);
                 else
-                  _tests_txt[static_cast<size_t>(test_id)].push_back(towe);
+                  for (std::string w : tokens)
+                    {
+                      towe->add_word(w);
+                    }
+
+                entries.push_back(towe);
               }
             else
               {
+                if (_wordpiece_tokens)
+                  {
+                    // BOW entries hold the pieces as words
+                    static thread_local std::vector<int> ids;
+                    ids.clear();
+                    for (const std::string &token : tokens)
+                      _wordpiece_tokenizer.append_ids(token.data(),
+                                                      token.size(), ids);
+                    tokens.clear();
+                    for (int id : ids)
+                      tokens.push_back(_wordpiece_tokenizer.piece(id));
+                  }
                 TxtBowEntry *tbe = new TxtBowEntry(target);
-                for (std::string w : tokens)
+                std::vector<std::string> words;
+                for (std::string &w : tokens)
+                  if (static_cast<int>(w.length()) >= _min_word_length)
+                    words.push_back(std::move(w));
+                tbe->set_words(words);
+                if (intern)
                   {
-                    if (static_cast<int>(w.length()) < _min_word_length)
-                      continue;
-
-                    // check and fillup vocab.
-                    int pos = -1;
-                    if ((vhit = _vocab.find(w)) == _vocab.end())
-                      {
-                        if (_train)
-                          {
-                            pos = _vocab.size();
-                            _vocab.emplace(std::make_pair(w, Word(pos)));
-                          }
-                      }
-                    else
-                      {
-                        if (_train)
-                          {
-                            (*vhit).second._total_count++;
-                            if (!tbe->has_word(w))
-                              (*vhit).second._total_docs++;
-                          }
-                      }
-                    tbe->add_word(w, 1.0, _count);
+                    std::vector<TxtEntry<double> *> tbes = { tbe };
+                    intern_words(tbes);
                   }
-                if (test_id < 0)
-                  _txt.push_back(tbe);
-                else
-                  _tests_txt[static_cast<size_t>(test_id)].push_back(tbe);
+                entries.push_back(tbe);
               }
           }
         else // character-level features
@@ -485,15 +576,58 @@ namespace dd
                   }
                 while (str_i < end && seq < _sequence);
               }
-            if (test_id < 0)
-              _txt.push_back(tce);
-            else
-              _tests_txt[static_cast<size_t>(test_id)].push_back(tce);
-            std::cerr << "\rloaded text samples=" << _txt.size();
+            entries.push_back(tce);
           }
       }
   }
 
+  void TxtInputFileConn::intern_words(std::vector<TxtEntry<double> *> &entries)
+  {
+    if (_characters || _ordered_words)
+      return;
+    size_t vocab_size = _vocab.size();
+    std::vector<std::pair<int, double>> row;
+    for (TxtEntry<double> *te : entries)
+      {
+        TxtBowEntry *tbe = static_cast<TxtBowEntry *>(te);
+        row.clear();
+        for (const std::pair<std::string, int> &w : tbe->_words)
+          {
+            std::unordered_map<std::string, Word>::iterator vhit;
+            if ((vhit = _vocab.find(w.first)) == _vocab.end())
+              {
+                if (!_train)
+                  continue;
+                int pos = _vocab.size();
+                vhit = _vocab
+                           .emplace(std::make_pair(
+                               w.first, Word(pos, w.second, 1)))
+                           .first;
+              }
+            else if (_train)
+              {
+                (*vhit).second._total_count += w.second;
+                (*vhit).second._total_docs++;
+              }
+            row.push_back(std::make_pair(
+                (*vhit).second._pos,
+                _count ? static_cast<double>(w.second) : 1.0));
+          }
+        std::sort(row.begin(), row.end());
+        tbe->set_row(_bow, _bow->add_row(row));
+      }
+    if (_vocab.size() != vocab_size)
+      vocab_changed();
+  }
+
+  void TxtInputFileConn::vocab_changed()
+  {
+    // generations are unique across connectors, whose copies share the
+    // compiled wordpiece tries
+    static std::atomic<uint64_t> generations(0);
+    _vocab_generation = ++generations;
+  }
+
   void TxtInputFileConn::serialize_vocab()
   {
     std::string vocabfname = _model_repo + "/" + _vocabfname;
@@ -541,6 +675,7 @@ namespace dd
         int pos = std::atoi(tokens.at(1).c_str());
         _vocab.emplace(std::make_pair(key, Word(pos)));
       }
+    vocab_changed();
     _logger->info("loaded vocabulary of size={}", _vocab.size());
   }
 
@@ -570,6 +705,36 @@ namespace dd
     for (auto e : v)
       delete e;
     v.clear();
+    if (_bow.use_count() == 1 && _bow->rows() > 0)
+      *_bow = TxtBowMatrix(); // no entry left
+  }
+
+  /*- TxtBowMatrix -*/
+  void TxtBowMatrix::remap(const std::vector<int> &remap)
+  {
+    // rows are compacted in place, as positions keep their order rows stay
+    // sorted
+    int64_t k = 0;
+    int64_t rstart = 0;
+    for (size_t r = 0; r < rows(); ++r)
+      {
+        int64_t rend = _indptr[r + 1];
+        for (int64_t i = rstart; i < rend; ++i)
+          {
+            int pos = _indices[i] < static_cast<int>(remap.size())
+                          ? remap[_indices[i]]
+                          : -1;
+            if (pos < 0)
+              continue;
+            _indices[k] = pos;
+            _values[k] = _values[i];
+            ++k;
+          }
+        _indptr[r + 1] = k;
+        rstart = rend;
+      }
+    _indices.resize(k);
+    _values.resize(k);
   }
 
 }
@@ -107,6 +107,46 @@ namespace dd
     std::string _uri;
   };
 
+  /**
+   * \brief bag-of-words rows over vocabulary positions, stored as a single
+   *        CSR matrix shared by the entries of a connector
+   */
+  class TxtBowMatrix
+  {
+  public:
+    /**
+     * \brief appends a row
+     * @param row (vocabulary position, value) pairs, sorted by position
+     * @return row index
+     */
+    int64_t add_row(const std::vector<std::pair<int, double>> &row)
+    {
+      for (const std::pair<int, double> &e : row)
+        {
+          _indices.push_back(e.first);
+          _values.push_back(e.second);
+        }
+      _indptr.push_back(_indices.size());
+      return _indptr.size() - 2;
+    }
+
+    /**
+     * \brief moves vocabulary positions, removed words are dropped
+     * @param remap new position of every old position, -1 for removed
+     *        words, must preserve the order of positions
+     */
+    void remap(const std::vector<int> &remap);
+
+    size_t rows() const
+    {
+      return _indptr.size() - 1;
+    }
+
+    std::vector<int64_t> _indptr = { 0 }; /**< row offsets, rows + 1. */
+    std::vector<int> _indices;            /**< vocabulary positions. */
+    std::vector<double> _values;
+  };
+
   class TxtBowEntry : public TxtEntry<double>
   {
   public:
@@ -118,50 +158,81 @@ namespace dd
     {
     }
 
-    void add_word(const std::string &str, const double &v, const bool &count)
+    /**
+     * \brief sets the words of the document, they are kept as word counts
+     *        until the entry gets its row
+     */
+    void set_words(std::vector<std::string> &words)
     {
-      std::unordered_map<std::string, double>::iterator hit;
-      if ((hit = _v.find(str)) != _v.end())
+      std::sort(words.begin(), words.end());
+      _words.clear();
+      for (std::string &w : words)
         {
-          if (count)
-            (*hit).second += v;
+          if (!_words.empty() && _words.back().first == w)
+            ++_words.back().second;
+          else
+            _words.emplace_back(std::move(w), 1);
         }
-      else
-        _v.insert(std::pair<std::string, double>(str, v));
     }
 
-    bool has_word(const std::string &str)
+    void set_row(const std::shared_ptr<TxtBowMatrix> &m, const int64_t &row)
     {
-      return _v.count(str);
+      _m = m;
+      _row = row;
+      _words = std::vector<std::pair<std::string, int>>();
     }
 
     void reset()
     {
-      _vit = _v.begin();
+      _vit = begin();
     }
 
-    void get_next_elt(std::string &key, double &val)
+    void get_next_elt(int &pos, double &val)
     {
-      if (_vit != _v.end())
+      if (_vit < end())
         {
-          key = (*_vit).first;
-          val = (*_vit).second;
+          pos = _m->_indices[_vit];
+          val = _m->_values[_vit];
           ++_vit;
         }
     }
 
     bool has_elt() const
     {
-      return _vit != _v.end();
+      return _vit < end();
     }
 
     size_t size() const
     {
-      return _v.size();
+      return end() - begin();
+    }
+
+    const int *indices() const
+    {
+      return _m ? _m->_indices.data() + begin() : nullptr;
     }
 
-    std::unordered_map<std::string, double> _v; /**< words as (<pos,val>). */
-    std::unordered_map<std::string, double>::iterator _vit;
+    double *values()
+    {
+      return _m ? _m->_values.data() + begin() : nullptr;
+    }
+
+    std::vector<std::pair<std::string, int>>
+        _words; /**< word counts, until interned into the vocabulary. */
+    std::shared_ptr<TxtBowMatrix> _m; /**< corpus rows. */
+    int64_t _row = -1;
+    int64_t _vit = 0;
+
+  private:
+    int64_t begin() const
+    {
+      return _m ? _m->_indptr[_row] : 0;
+    }
+
+    int64_t end() const
+    {
+      return _m ? _m->_indptr[_row + 1] : 0;
+    }
   };
 
   class TxtCharEntry : public TxtEntry<double>
@@ -251,34 +322,58 @@ namespace dd
 
     size_t size() const
     {
-      return _v.size();
+      return _v.size() + _ids.size();
     }
 
     std::vector<std::string> _v;
     std::vector<std::string>::iterator _vit;
+    std::vector<int> _ids; /**< vocabulary positions of wordpiece tokens,
+                              -1 for unknown words, instead of _v. */
   };
 
   /** Tokenizer that uses greedy longest-match-first search to cut words
-   * in pieces */
+   * in pieces, over tries compiled from the vocabulary */
   class WordPieceTokenizer
   {
   public:
-    std::vector<std::string> _tokens;
-    TxtInputFileConn *_ctfc = nullptr;
-
     WordPieceTokenizer()
     {
     }
 
-    void reset()
+    /**
+     * \brief compiles the vocabulary into a trie of word beginnings and a
+     *        trie of word suffixes, shared by copies of the tokenizer.
+     *        Tokens without position are left out
+     * @param generation identifies the vocabulary content, see compiled()
+     */
+    void compile(const std::unordered_map<std::string, Word> &vocab,
+                 const uint64_t &generation = 0);
+
+    /**
+     * \brief whether the tries are compiled from this vocabulary
+     *        generation with the current prefixes
+     */
+    bool compiled(const uint64_t &generation = 0) const
     {
-      _tokens.clear();
+      return _trie && _trie->_generation == generation
+             && _trie->_word_start == _word_start
+             && _trie->_suffix_start == _suffix_start;
     }
 
-    void append_input(const std::string &word);
+    /**
+     * \brief cuts a word in pieces, in a single pass over the bytes of each
+     *        piece and without allocation beyond the growth of ids
+     * @param ids vocabulary positions of the pieces are appended, a word
+     *        that cannot be cut in pieces is a single -1
+     */
+    void append_ids(const char *word, const size_t &len,
+                    std::vector<int> &ids) const;
 
-  public:
-    bool in_vocab(const std::string &tok);
+    /** Piece from its vocabulary position, the unknown token for -1 */
+    const std::string &piece(const int &id) const
+    {
+      return id < 0 ? _unk_token : _trie->_pieces[id];
+    }
 
     std::string _suffix_start
         = "##"; /**< Suffix tokens in vocabulary are prefixed by this */
@@ -286,6 +381,33 @@ namespace dd
         = ""; /**< Tokens corresponding to word or word beggining in the
                  vocabulary are prefixed by this */
     std::string _unk_token = "[UNK]";
+
+  private:
+    /**
+     * \brief tries as flat arrays, the children of a node are contiguous
+     *        edges sorted by byte
+     */
+    class Trie
+    {
+    public:
+      std::vector<int> _first_edge;      /**< per node, nodes + 1. */
+      std::vector<int> _piece;           /**< per node, position or -1. */
+      std::vector<unsigned char> _label; /**< per edge. */
+      std::vector<int> _child;           /**< per edge. */
+      std::vector<std::string> _pieces;  /**< tokens by position. */
+      std::string _word_start;
+      std::string _suffix_start;
+      uint64_t _generation = 0;
+    };
+
+    static constexpr int _word_root = 0;
+    static constexpr int _suffix_root = 1;
+
+    /** Longest piece at the start of s, 0 if none */
+    size_t longest_piece(const int &root, const char *s, const size_t &len,
+                         int &id) const;
+
+    std::shared_ptr<const Trie> _trie;
   };
 
   class TxtInputFileConn : public InputConnectorStrategy
@@ -293,7 +415,6 @@ namespace dd
   public:
     TxtInputFileConn() : InputConnectorStrategy()
     {
-      _wordpiece_tokenizer._ctfc = this;
     }
     TxtInputFileConn(const TxtInputFileConn &i)
         : InputConnectorStrategy(i), _iterator(i._iterator),
@@ -306,10 +427,9 @@ namespace dd
           _alphabet_str(i._alphabet_str), _alphabet(i._alphabet),
           _sequence(i._sequence), _seq_forward(i._seq_forward),
           _generate_vocab(i._generate_vocab), _vocab(i._vocab),
-          _vocab_sep(i._vocab_sep),
+          _vocab_generation(i._vocab_generation), _vocab_sep(i._vocab_sep),
           _wordpiece_tokenizer(i._wordpiece_tokenizer), _ndbed(i._ndbed)
     {
-      _wordpiece_tokenizer._ctfc = this;
     }
     ~TxtInputFileConn()
     {
@@ -324,6 +444,7 @@ namespace dd
       fillup_parameters(ad);
       if (!_characters && !_train)
         deserialize_vocab(false);
+      init_wordpiece();
     }
 
     void fillup_parameters(const APIData &ad_input)
@@ -503,6 +624,49 @@ namespace dd
                                const float &target = -1, int test_id = -1);
     // test -1 for train, 0 ,1  ... for test_id
 
+    /**
+     * \brief tokenizes a document into entries
+     * @param entries tokenized entries are appended to entries
+     * @param intern whether to intern BOW words into the vocabulary right
+     *        away, otherwise entries keep their words until intern_words is
+     *        called, and the call is thread safe
+     */
+    void tokenize_content(const std::string &content, const float &target,
+                          std::vector<TxtEntry<double> *> &entries,
+                          const bool &intern = true);
+
+    /**
+     * \brief compiles the wordpiece tokenizer if needed, before calling
+     *        tokenize_content
+     */
+    void init_wordpiece()
+    {
+      if (_wordpiece_tokens
+          && !_wordpiece_tokenizer.compiled(_vocab_generation))
+        _wordpiece_tokenizer.compile(_vocab, _vocab_generation);
+    }
+
+    /**
+     * \brief to be called after modifying the vocabulary, so that the
+     *        wordpiece tokenizer gets compiled again
+     */
+    void vocab_changed();
+
+    /**
+     * \brief interns the words of BOW entries into the vocabulary, and
+     *        stores them as rows of the BOW matrix
+     */
+    void intern_words(std::vector<TxtEntry<double> *> &entries);
+
+    /**
+     * \brief called once a block of files from a data directory has been
+     *        tokenized into the train or test entries
+     */
+    virtual void entries_parsed(int test_id)
+    {
+      (void)test_id;
+    }
+
     // serialization of vocabulary
     void serialize_vocab();
     void deserialize_vocab(const bool &required = true);
@@ -546,15 +710,21 @@ namespace dd
     bool _generate_vocab = true;
     std::unordered_map<std::string, Word>
         _vocab; /**< string to word stats, including word */
+    uint64_t _vocab_generation = 0; /**< see vocab_changed(). */
     std::string _vocabfname = "vocab.dat";
     std::string _correspname = "corresp.txt";
     char _vocab_sep = ','; /**< vocabulary separator */
     int _dirs = 0;         /**< directories as input. */
+    size_t _dir_block_size
+        = 1024; /**< files tokenized in parallel at a time, when reading a
+                   data directory. */
     WordPieceTokenizer _wordpiece_tokenizer;
 
     // data
     std::vector<TxtEntry<double> *> _txt;
     std::vector<std::vector<TxtEntry<double> *>> _tests_txt;
+    std::shared_ptr<TxtBowMatrix> _bow
+        = std::make_shared<TxtBowMatrix>(); /**< rows of BOW entries. */
     std::string _db_fname;
 
     int64_t _ndbed = 0;
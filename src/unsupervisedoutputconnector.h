@@ -35,6 +35,9 @@ namespace dd
   public:
     oatpp::Object<DTO::Dimensions> _imgsize;
     oatpp::UnorderedFields<DTO::DTOVector<double>> _confidences;
+    oatpp::Object<DTO::SegmentationMask> _mask; /**< encoded class map. */
+    oatpp::Object<DTO::SegmentationMask>
+        _mask_confidence; /**< encoded confidence map. */
   };
 
   class UnsupervisedResult
@@ -178,6 +181,11 @@ namespace dd
                           DTO::DTOVector<double>(std::move(vec))));
                     }
                 }
+              if (ad.has("mask"))
+                extra._mask = to_mask_dto(ad.getobj("mask"));
+              if (ad.has("mask_confidence"))
+                extra._mask_confidence
+                    = to_mask_dto(ad.getobj("mask_confidence"));
               std::string meta_uri;
               if (ad.has("index_uri"))
                 meta_uri = ad.get("index_uri").get<std::string>();
@@ -193,6 +201,29 @@ namespace dd
         }
     }
 
+    /**
+     * \brief encoded segmentation mask from a result, see
+     *        cv_utils::mask_to_rle
+     */
+    static oatpp::Object<DTO::SegmentationMask>
+    to_mask_dto(const APIData &ad_mask)
+    {
+      auto mask = DTO::SegmentationMask::createShared();
+      mask->format = ad_mask.get("format").get<std::string>().c_str();
+      mask->width = ad_mask.get("width").get<int>();
+      mask->height = ad_mask.get("height").get<int>();
+      if (ad_mask.has("data"))
+        mask->data = ad_mask.get("data").get<std::string>().c_str();
+      else
+        {
+          mask->values = DTO::DTOVector<int>(
+              ad_mask.get("values").get<std::vector<int>>());
+          mask->counts = DTO::DTOVector<int>(
+              ad_mask.get("counts").get<std::vector<int>>());
+        }
+      return mask;
+    }
+
     oatpp::Object<DTO::PredictBody>
     finalize(const APIData &ad_in, const OutputConnectorConfig &config,
              MLModel *mlm)
@@ -251,7 +282,7 @@ namespace dd
 
             // index output content -> vector (XXX: will need to flatten in
             // case of multiple vectors)
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
           std::vector<URIData> urids;
           std::vector<std::vector<double>> vvals;
 #endif
@@ -262,7 +293,7 @@ namespace dd
                 urid = URIData(_vvres.at(i)._uri);
               else
                 urid = URIData(_vvres.at(i)._meta_uri);
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
               urids.push_back(urid);
               vvals.push_back(_vvres.at(i)._vals);
 #else
@@ -270,7 +301,7 @@ namespace dd
 #endif
               indexed_uris.insert(urid._uri);
             }
-#ifdef USE_FAISS
+#if defined(USE_FAISS) || defined(USE_HNSW)
           mlm->_se->index(urids, vvals);
 #endif
         }
@@ -296,19 +327,26 @@ namespace dd
           int search_nn = output_params->search_nn != nullptr
                               ? int(output_params->search_nn)
                               : _search_nn;
-#ifdef USE_FAISS
+          SearchParams search_params;
           if (output_params->nprobe != nullptr)
-            mlm->_se->_tse->_nprobe = output_params->nprobe;
-#endif
+            search_params._nprobe = output_params->nprobe;
+          if (output_params->search_k != nullptr)
+            search_params._search_k = output_params->search_k;
+          // all outputs of the batch are searched at once
+          std::vector<double> queries;
+          for (size_t i = 0; i < _vvres.size(); i++)
+            queries.insert(queries.end(), _vvres.at(i)._vals.begin(),
+                           _vvres.at(i)._vals.end());
+          std::vector<std::vector<URIData>> nn_uris;
+          std::vector<std::vector<double>> nn_distances;
+          mlm->_se->search_batch(queries, search_nn, nn_uris, nn_distances,
+                                 search_params);
           for (size_t i = 0; i < _vvres.size(); i++)
             {
-              std::vector<URIData> nn_uris;
-              std::vector<double> nn_distances;
-              mlm->_se->search(_vvres.at(i)._vals, search_nn, nn_uris,
-                               nn_distances);
-              for (size_t j = 0; j < nn_uris.size(); j++)
+              for (size_t j = 0; j < nn_uris.at(i).size(); j++)
                 {
-                  _vvres.at(i).add_nn(nn_distances.at(j), nn_uris.at(j)._uri);
+                  _vvres.at(i).add_nn(nn_distances.at(i).at(j),
+                                      nn_uris.at(i).at(j)._uri);
                 }
             }
         }
@@ -345,13 +383,15 @@ namespace dd
                 = DTO::DTOVector<bool>(std::move(_vvres.at(i)._bvals));
           else if (_string_binarized)
             pred_dto->vals = oatpp::String(_vvres.at(i)._str.c_str());
-          else
+          else if (_vvres.at(i)._extra._mask == nullptr)
             pred_dto->vals
                 = DTO::DTOVector<double>(std::move(_vvres.at(i)._vals));
           if (_vvres.at(i)._extra._imgsize)
             pred_dto->imgsize = _vvres.at(i)._extra._imgsize;
           if (_vvres.at(i)._extra._confidences != nullptr)
             pred_dto->confidences = _vvres.at(i)._extra._confidences;
+          pred_dto->mask = _vvres.at(i)._extra._mask;
+          pred_dto->mask_confidence = _vvres.at(i)._extra._mask_confidence;
           if (i == _vvres.size() - 1)
             pred_dto->last = true;
 #ifdef USE_SIMSEARCH
@@ -22,6 +22,7 @@
 #ifndef DD_UTILS_CVUTILS_HPP
 #define DD_UTILS_CVUTILS_HPP
 
+#include <algorithm>
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include "ext/base64/base64.h"
@@ -73,6 +74,99 @@ namespace dd
         throw std::runtime_error("Image could not be encoded");
       return encoded;
     }
+
+    template <typename T>
+    inline void mask_to_rle_t(const cv::Mat &mask, std::vector<int> &values,
+                              std::vector<int> &counts)
+    {
+      for (int r = 0; r < mask.rows; ++r)
+        {
+          const T *row = mask.ptr<T>(r);
+          for (int c = 0; c < mask.cols; ++c)
+            {
+              if (!counts.empty() && values.back() == row[c])
+                ++counts.back();
+              else
+                {
+                  values.push_back(row[c]);
+                  counts.push_back(1);
+                }
+            }
+        }
+    }
+
+    /** Run-length encoding of a single-channel 8-bit, 16-bit or 32-bit
+     * integer mask, runs follow the row-major order of the pixels */
+    inline void mask_to_rle(const cv::Mat &mask, std::vector<int> &values,
+                            std::vector<int> &counts)
+    {
+      values.clear();
+      counts.clear();
+      switch (mask.type())
+        {
+        case CV_8UC1:
+          mask_to_rle_t<uint8_t>(mask, values, counts);
+          break;
+        case CV_16UC1:
+          mask_to_rle_t<uint16_t>(mask, values, counts);
+          break;
+        case CV_32SC1:
+          mask_to_rle_t<int>(mask, values, counts);
+          break;
+        default:
+          throw std::runtime_error("Mask type not supported by RLE");
+        }
+    }
+
+    /** Decodes a mask encoded with mask_to_rle, as 32-bit integers */
+    inline cv::Mat rle_to_mask(const std::vector<int> &values,
+                               const std::vector<int> &counts,
+                               const int &height, const int &width)
+    {
+      cv::Mat mask(height, width, CV_32SC1);
+      int *out = mask.ptr<int>();
+      int *end = out + mask.total();
+      for (size_t i = 0; i < values.size() && i < counts.size(); ++i)
+        {
+          if (counts[i] < 0 || counts[i] > end - out)
+            throw std::runtime_error("RLE does not match mask size");
+          out = std::fill_n(out, counts[i], values[i]);
+        }
+      if (out != end)
+        throw std::runtime_error("RLE does not match mask size");
+      return mask;
+    }
+
+    /** Draw a bbox with its label, color is picked from the class name */
+    inline void draw_bbox(cv::Mat &img, const cv::Point &pt1,
+                          const cv::Point &pt2, const std::string &cat,
+                          const std::string &label, const int &thickness)
+    {
+      static const cv::Scalar bbox_palette[]
+          = { { 82, 188, 227 }, { 196, 110, 49 }, { 39, 54, 227 },
+              { 68, 227, 81 },  { 77, 157, 255 }, { 255, 112, 207 },
+              { 240, 228, 65 }, { 94, 242, 151 }, { 236, 121, 242 },
+              { 28, 77, 120 } };
+      static const size_t bbox_palette_size = 10;
+
+      size_t cls_hash = std::hash<std::string>{}(cat);
+      cv::Scalar color = bbox_palette[cls_hash % bbox_palette_size];
+      cv::rectangle(img, pt1, pt2, cv::Scalar(255, 255, 255), thickness + 2);
+      cv::rectangle(img, pt1, pt2, color, thickness);
+
+      // font size relatively to base opencv font size
+      float font_size = 2;
+      int x_txt = pt1.x + 5;
+      if (x_txt > img.cols - 15)
+        x_txt = img.cols - 15;
+      int y_txt = std::min(img.rows - 20,
+                           static_cast<int>(pt2.y + 2 + font_size * 12));
+
+      cv::putText(img, label, cv::Point(x_txt, y_txt), cv::FONT_HERSHEY_PLAIN,
+                  font_size, cv::Scalar(255, 255, 255), thickness + 2);
+      cv::putText(img, label, cv::Point(x_txt, y_txt), cv::FONT_HERSHEY_PLAIN,
+                  font_size, color, thickness);
+    }
   }
 }
 
@@ -0,0 +1,103 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DD_MAPPED_FILE_H
+#define DD_MAPPED_FILE_H
+
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dd
+{
+  /**
+   * \brief read-only memory mapping of a whole file, unmapped on destruction
+   */
+  class MappedFile
+  {
+  public:
+    /**
+     * @param fname file to map
+     * @param sequential whether the file is mostly read front to back
+     */
+    MappedFile(const std::string &fname, const bool &sequential = true)
+    {
+      int fd = ::open(fname.c_str(), O_RDONLY);
+      if (fd < 0)
+        return;
+      struct stat st;
+      if (::fstat(fd, &st) == 0)
+        {
+          _size = st.st_size;
+          _open = true;
+          if (_size > 0)
+            {
+              void *addr
+                  = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+              if (addr == MAP_FAILED)
+                {
+                  _size = 0;
+                  _open = false;
+                }
+              else
+                {
+                  _data = static_cast<const char *>(addr);
+                  ::madvise(addr, _size,
+                            sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                }
+            }
+        }
+      ::close(fd);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+      if (_data)
+        ::munmap(const_cast<char *>(_data), _size);
+    }
+
+    bool is_open() const
+    {
+      return _open;
+    }
+
+    const char *data() const
+    {
+      return _data;
+    }
+
+    size_t size() const
+    {
+      return _size;
+    }
+
+  private:
+    const char *_data = nullptr;
+    size_t _size = 0;
+    bool _open = false;
+  };
+}
+
+#endif
@@ -45,6 +45,8 @@ namespace dd
                                    DTO::vectorDeserialize<double>);
       deser->setDeserializerMethod(DTO::DTOVector<uint8_t>::Class::CLASS_ID,
                                    DTO::vectorDeserialize<uint8_t>);
+      deser->setDeserializerMethod(DTO::DTOVector<int>::Class::CLASS_ID,
+                                   DTO::vectorDeserialize<int>);
       deser->setDeserializerMethod(DTO::DTOVector<bool>::Class::CLASS_ID,
                                    DTO::vectorDeserialize<bool>);
       auto ser = object_mapper->getSerializer();
@@ -58,6 +60,8 @@ namespace dd
                                DTO::vectorSerialize<double>);
       ser->setSerializerMethod(DTO::DTOVector<uint8_t>::Class::CLASS_ID,
                                DTO::vectorSerialize<uint8_t>);
+      ser->setSerializerMethod(DTO::DTOVector<int>::Class::CLASS_ID,
+                               DTO::vectorSerialize<int>);
       ser->setSerializerMethod(DTO::DTOVector<bool>::Class::CLASS_ID,
                                DTO::vectorSerialize<bool>);
 
@@ -91,6 +95,74 @@ namespace dd
       return result;
     }
 
+    template <typename T>
+    static bool copyDTOVector(const oatpp::Void &polymorph, oatpp::Void &copy)
+    {
+      if (polymorph.getValueType() != DTO::DTOVector<T>::Class::getType())
+        return false;
+      auto vec = polymorph.cast<DTO::DTOVector<T>>();
+      copy = DTO::DTOVector<T>(std::vector<T>(*vec));
+      return true;
+    }
+
+    oatpp::Void dtoDeepCopy(const oatpp::Void &polymorph)
+    {
+      namespace type = oatpp::data::mapping::type;
+      if (polymorph == nullptr)
+        return polymorph;
+
+      oatpp::Void copy;
+      auto class_id = polymorph.getValueType()->classId.id;
+      if (polymorph.getValueType() == oatpp::Any::Class::getType())
+        {
+          auto anyHandle = static_cast<type::AnyHandle *>(polymorph.get());
+          copy = oatpp::Any(
+              dtoDeepCopy(oatpp::Void(anyHandle->ptr, anyHandle->type)));
+        }
+      else if (class_id == type::__class::AbstractObject::CLASS_ID.id)
+        {
+          auto dispatcher = static_cast<
+              const type::__class::AbstractObject::PolymorphicDispatcher *>(
+              polymorph.getValueType()->polymorphicDispatcher);
+          copy = dispatcher->createObject();
+          auto object = static_cast<oatpp::BaseObject *>(polymorph.get());
+          auto object_copy = static_cast<oatpp::BaseObject *>(copy.get());
+          for (auto const &field : dispatcher->getProperties()->getList())
+            field->set(object_copy, dtoDeepCopy(field->get(object)));
+        }
+      else if (class_id == type::__class::AbstractVector::CLASS_ID.id
+               || class_id == type::__class::AbstractList::CLASS_ID.id)
+        {
+          auto dispatcher = static_cast<
+              const type::__class::Collection::PolymorphicDispatcher *>(
+              polymorph.getValueType()->polymorphicDispatcher);
+          copy = dispatcher->createObject();
+          for (auto it = dispatcher->beginIteration(polymorph);
+               !it->finished(); it->next())
+            dispatcher->addItem(copy, dtoDeepCopy(it->get()));
+        }
+      else if (class_id == type::__class::AbstractPairList::CLASS_ID.id
+               || class_id == type::__class::AbstractUnorderedMap::CLASS_ID.id)
+        {
+          auto dispatcher = static_cast<
+              const type::__class::Map::PolymorphicDispatcher *>(
+              polymorph.getValueType()->polymorphicDispatcher);
+          copy = dispatcher->createObject();
+          for (auto it = dispatcher->beginIteration(polymorph);
+               !it->finished(); it->next())
+            dispatcher->addItem(copy, it->getKey(),
+                                dtoDeepCopy(it->getValue()));
+        }
+      else if (polymorph.getValueType() == DTO::DTOApiData::Class::getType())
+        copy = DTO::DTOApiData(APIData(*polymorph.cast<DTO::DTOApiData>()));
+      else if (!copyDTOVector<double>(polymorph, copy)
+               && !copyDTOVector<uint8_t>(polymorph, copy)
+               && !copyDTOVector<int>(polymorph, copy)
+               && !copyDTOVector<bool>(polymorph, copy))
+        copy = polymorph; // strings, primitives and images
+      return copy;
+    }
+
     void dtoToJDoc(const oatpp::Void &polymorph, JDoc &jdoc, bool ignore_null)
     {
       dtoToJVal(polymorph, jdoc, jdoc, ignore_null);
@@ -171,6 +243,16 @@ namespace dd
               jval.PushBack(vec->at(i), jdoc.GetAllocator());
             }
         }
+      else if (polymorph.getValueType()
+               == DTO::DTOVector<int>::Class::getType())
+        {
+          auto vec = polymorph.cast<DTO::DTOVector<int>>();
+          jval = JVal(rapidjson::kArrayType);
+          for (size_t i = 0; i < vec->size(); ++i)
+            {
+              jval.PushBack(vec->at(i), jdoc.GetAllocator());
+            }
+        }
       else if (polymorph.getValueType()
                == DTO::DTOVector<bool>::Class::getType())
         {
@@ -39,6 +39,10 @@ namespace dd
     oatpp::UnorderedFields<oatpp::Any>
     dtoToUFields(const oatpp::Void &polymorph);
 
+    /** Deep copy of a DTO, objects, collections, maps and vectors are
+     * copied, other values are shared */
+    oatpp::Void dtoDeepCopy(const oatpp::Void &polymorph);
+
     template <typename Wrapper> inline Wrapper staticCast(oatpp::Void val)
     {
       return Wrapper(
@@ -24,6 +24,7 @@
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <iostream>
+#include <thread>
 
 #ifdef USE_TENSORRT
 #include <cuda_runtime_api.h>
@@ -55,6 +56,65 @@ static std::string trt_gan_repo
 
 static std::string test_img_folder = "../examples/all/images";
 
+TEST(chain, chain_graph_schedule)
+{
+  // detector -> crop -> { age, gender, embedding }
+  ChainGraph graph;
+  graph.add_service("", "", "detect");
+  graph.add_action("crop", "crop");
+  graph.add_service("age", "crop", "age");
+  graph.add_service("gender", "crop", "gender");
+  graph.add_service("embedding", "", "embedding"); // parent is last action
+  ASSERT_EQ(graph._nodes.at(0)._id, "0");
+  ASSERT_EQ(graph.first_service_id(), "0");
+  ASSERT_EQ(graph._nodes.at(1)._deps, std::vector<int>({ 0 }));
+  for (int n = 2; n < 5; ++n)
+    {
+      ASSERT_EQ(graph._nodes.at(n)._deps, std::vector<int>({ 1 }));
+      ASSERT_EQ(graph._nodes.at(n)._input_id, "crop");
+    }
+
+  std::mutex mutex;
+  int running = 0;
+  int max_running = 0;
+  graph.run([&](const int &, const ChainGraph::Node &) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      max_running = std::max(max_running, ++running);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::lock_guard<std::mutex> lock(mutex);
+    --running;
+    return 0;
+  });
+  ASSERT_EQ(max_running, 3); // the three classifiers
+  for (const ChainGraph::Node &node : graph._nodes)
+    ASSERT_TRUE(node._time >= 45.0);
+  ASSERT_TRUE(graph._nodes.at(2)._start >= graph._nodes.at(1)._start + 45.0);
+  ASSERT_EQ(graph.timings()->size(), 5);
+}
+
+TEST(chain, chain_graph_actions)
+{
+  ChainGraph graph;
+  graph.add_service("", "", "detect");
+  graph.add_action("", "crop");   // default id "0", as the first service
+  graph.add_action("", "rotate"); // same output as crop, runs after it
+  graph.add_service("", "", "classif");
+  ASSERT_EQ(graph._nodes.at(1)._id, "0");
+  ASSERT_EQ(graph._nodes.at(2)._id, "1");
+  ASSERT_EQ(graph._nodes.at(2)._deps, std::vector<int>({ 0, 1 }));
+  ASSERT_EQ(graph._nodes.at(3)._deps, std::vector<int>({ 2 }));
+  ASSERT_THROW(graph.add_service("3", "", "classif"), ChainBadParamException);
+
+  // calls after a call without output are skipped
+  graph.run([](const int &n, const ChainGraph::Node &) { return n == 1; });
+  ASSERT_EQ(graph._nodes.at(1)._status, 1);
+  ASSERT_EQ(graph._nodes.at(2)._status, -1);
+  ASSERT_EQ(graph._nodes.at(3)._status, -1);
+  ASSERT_EQ(graph.timings()->size(), 2);
+}
+
 #ifdef USE_TORCH
 
 TEST(chain, chain_torch_detection_classification)
@@ -309,6 +369,16 @@ TEST(chain, chain_caffe_faces_classification)
   ASSERT_EQ(pred2["classes"].Size(), 0);
   ASSERT_EQ(pred1["classes"][0]["age"]["classes"][0]["cat"].GetString(),
             std::string("52"));
+
+  // per-call timings
+  ASSERT_TRUE(jd["body"]["calls_time"].IsArray());
+  ASSERT_EQ(jd["body"]["calls_time"].Size(), 3);
+  ASSERT_EQ(jd["body"]["calls_time"][1]["id"].GetString(),
+            std::string("face_detection_crop"));
+  ASSERT_EQ(jd["body"]["calls_time"][2]["name"].GetString(), age_sname);
+  ASSERT_TRUE(jd["body"]["calls_time"][2]["start"].GetDouble()
+              >= jd["body"]["calls_time"][1]["start"].GetDouble()
+                     + jd["body"]["calls_time"][1]["time"].GetDouble());
 }
 
 TEST(chain, chain_caffe_detect_draw_bboxes)
@@ -28,6 +28,7 @@
 #include "jsonapi.h"
 #include <gtest/gtest.h>
 #include <iostream>
+#include <map>
 
 using namespace dd;
 
@@ -448,7 +449,81 @@ TEST(inputconn, img)
                 == 0); // the two images must be identical
 }
 
+TEST(inputconn, img_order)
+{
+  std::string mnist_repo = "../examples/caffe/mnist/";
+  std::vector<std::string> uris;
+  for (int i = 0; i < 64; i++)
+    uris.push_back(mnist_repo
+                   + (i % 2 ? "/sample_digit2.png" : "/sample_digit.png"));
+  APIData ad;
+  ad.add("data", uris);
+  ImgInputFileConn iifc;
+  iifc.transform(ad);
+
+  // images and uris keep the input order
+  ASSERT_EQ(64, iifc._uris.size());
+  ASSERT_EQ(64, iifc._images.size());
+  for (int i = 0; i < 64; i++)
+    {
+      ASSERT_EQ(uris.at(i), iifc._uris.at(i));
+      cv::Mat diff;
+      cv::compare(iifc._images.at(i), iifc._images.at(i % 2), diff,
+                  cv::CMP_NE);
+      std::vector<cv::Mat> channels(3);
+      cv::split(diff, channels);
+      for (int c = 0; c < 3; c++)
+        ASSERT_EQ(0, cv::countNonZero(channels.at(c)));
+    }
+  cv::Mat diff;
+  cv::compare(iifc._images.at(0), iifc._images.at(1), diff, cv::CMP_NE);
+  ASSERT_GT(cv::countNonZero(diff.reshape(1)), 0);
+}
+
 // TODO: test csv scale, separator, categorical, ...
+TEST(inputconn, img_raw_views)
+{
+  // chain crops are passed as views into the source frame, a crop of the
+  // whole frame is not a submatrix but still shares its buffer
+  cv::Mat frame(120, 160, CV_8UC3);
+  cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+  cv::Mat frame_copy = frame.clone();
+  std::vector<cv::Mat> crops = { frame(cv::Rect(10, 20, 40, 30)),
+                                 frame(cv::Rect(0, 0, 160, 60)),
+                                 frame(cv::Rect(0, 0, 160, 120)) };
+
+  for (int size : { -1, 32 })
+    {
+      APIData ad, pad, pinp;
+      ad.add("data_raw_img", crops);
+      pinp.add("width", size);
+      pinp.add("height", size);
+      pinp.add("rgb", true);
+      std::vector<APIData> vpinp = { pinp };
+      pad.add("input", vpinp);
+      std::vector<APIData> vpad = { pad };
+      ad.add("parameters", vpad);
+      ImgInputFileConn iifc;
+      iifc.transform(ad);
+      ASSERT_EQ(3, iifc._images.size());
+
+      // the source frame is left untouched
+      cv::Mat diff;
+      cv::compare(frame, frame_copy, diff, cv::CMP_NE);
+      ASSERT_EQ(0, cv::countNonZero(diff.reshape(1)));
+
+      cv::Mat expected;
+      if (size > 0)
+        cv::resize(crops.at(0), expected, cv::Size(size, size), 0, 0,
+                   cv::INTER_CUBIC);
+      else
+        expected = crops.at(0).clone();
+      cv::cvtColor(expected, expected, cv::COLOR_BGR2RGB);
+      cv::compare(iifc._images.at(0), expected, diff, cv::CMP_NE);
+      ASSERT_EQ(0, cv::countNonZero(diff.reshape(1)));
+    }
+}
+
 TEST(inputconn, csv_mem1)
 {
   std::string no_header = "2590,56,2,212,5";
@@ -733,6 +808,132 @@ TEST(inputconn, csv_ignore)
   remove("test.csv");
 }
 
+TEST(inputconn, csv_chunks)
+{
+  std::ofstream of("test.csv");
+  of << "id,target,val1,color" << std::endl;
+  for (int i = 0; i < 100; ++i)
+    of << i << "," << (i < 50 ? "low" : "high") << "," << i * 2 << ","
+       << (i % 3 == 0 ? "red" : i % 3 == 1 ? "green" : "blue") << "\r\n";
+  of.close();
+  std::vector<std::string> vdata = { "test.csv" };
+
+  // categoricals and labels
+  APIData ad;
+  ad.add("data", vdata);
+  APIData pad, pinp;
+  pinp.add("id", std::string("id"));
+  pinp.add("label", std::string("target"));
+  std::vector<std::string> vcats = { "color" };
+  pinp.add("categoricals", vcats);
+  std::vector<APIData> vpinp = { pinp };
+  pad.add("input", vpinp);
+  std::vector<APIData> vpad = { pad };
+  ad.add("parameters", vpad);
+  CSVInputFileConn cifc;
+  cifc._logger = spdlog::stdout_logger_mt("test_chunks1");
+  cifc._train = true;
+  cifc._chunk_size = 64; // many chunks, not aligned on lines
+  try
+    {
+      cifc.transform(ad);
+    }
+  catch (std::exception &e)
+    {
+      std::cerr << "exception=" << e.what() << std::endl;
+      ASSERT_FALSE(true);
+    }
+  ASSERT_EQ(100, cifc._csvdata.size());
+  ASSERT_EQ(6, cifc._columns.size());
+  // ids in order of appearance, whatever the chunks
+  ASSERT_EQ(0, cifc._categoricals["color"].get_cat_num("red"));
+  ASSERT_EQ(1, cifc._categoricals["color"].get_cat_num("green"));
+  ASSERT_EQ(2, cifc._categoricals["color"].get_cat_num("blue"));
+  ASSERT_EQ("low", cifc._hcorresp[0]);
+  ASSERT_EQ("high", cifc._hcorresp[1]);
+  for (int i = 0; i < 100; ++i)
+    {
+      const CSVline &line = cifc._csvdata.at(i);
+      ASSERT_EQ(std::to_string(i), line._str);
+      std::vector<double> v = { double(i), i < 50 ? 0.0 : 1.0, i * 2.0,
+                                0.0,       0.0,                0.0 };
+      v[3 + i % 3] = 1.0;
+      ASSERT_EQ(v, line._v);
+    }
+
+  // scaling bounds
+  APIData ad2;
+  ad2.add("data", vdata);
+  APIData pad2, pinp2;
+  pinp2.add("id", std::string("id"));
+  pinp2.add("label", std::string("target"));
+  std::vector<std::string> vign = { "color" };
+  pinp2.add("ignore", vign);
+  pinp2.add("scale", true);
+  pinp2.add("scale_type", std::string("znorm"));
+  std::vector<APIData> vpinp2 = { pinp2 };
+  pad2.add("input", vpinp2);
+  std::vector<APIData> vpad2 = { pad2 };
+  ad2.add("parameters", vpad2);
+  CSVInputFileConn cifc2;
+  cifc2._logger = spdlog::stdout_logger_mt("test_chunks2");
+  cifc2._train = true;
+  cifc2._chunk_size = 64;
+  try
+    {
+      cifc2.transform(ad2);
+    }
+  catch (std::exception &e)
+    {
+      std::cerr << "exception=" << e.what() << std::endl;
+      ASSERT_FALSE(true);
+    }
+  ASSERT_EQ(100, cifc2._csvdata.size());
+  ASSERT_EQ(3, cifc2._mean_vals.size());
+  ASSERT_DOUBLE_EQ(49.5, cifc2._mean_vals[0]);
+  ASSERT_DOUBLE_EQ(99.0, cifc2._mean_vals[2]);
+  ASSERT_DOUBLE_EQ(3333.0, cifc2._variance_vals[2]);
+  for (int i = 0; i < 100; ++i)
+    {
+      const CSVline &line = cifc2._csvdata.at(i);
+      ASSERT_EQ(i, line._v[0]);             // id is not scaled
+      ASSERT_EQ(i < 50 ? 0 : 1, line._v[1]); // nor are labels
+      ASSERT_NEAR((i * 2 - 99.0) / std::sqrt(3333.0), line._v[2], 1e-9);
+    }
+  remove("test.csv");
+}
+
+TEST(inputconn, csv_out_of_range)
+{
+  // memory lines and file chunks classify fields the same way
+  std::string header = "id,val1,target";
+  std::string d1 = "1,1e999,2";
+  std::ofstream of("test.csv");
+  of << header << std::endl << d1 << std::endl;
+  of.close();
+  std::vector<std::vector<std::string>> vvdata
+      = { { header, d1 }, { "test.csv" } };
+  int l = 0;
+  for (auto &vdata : vvdata)
+    {
+      APIData ad;
+      ad.add("data", vdata);
+      APIData pad, pinp;
+      pinp.add("id", std::string("id"));
+      pinp.add("label", std::string("target"));
+      std::vector<APIData> vpinp = { pinp };
+      pad.add("input", vpinp);
+      std::vector<APIData> vpad = { pad };
+      ad.add("parameters", vpad);
+      CSVInputFileConn cifc;
+      cifc._logger
+          = spdlog::stdout_logger_mt("test_range" + std::to_string(l++));
+      cifc._train = true;
+      ASSERT_THROW(cifc.transform(ad), std::out_of_range);
+    }
+  remove("test.csv");
+}
+
 TEST(inputconn, csvts_basic)
 {
   std::string header = "target,cap-shape,cap-surface,cap-color,bruises";
@@ -818,6 +1019,211 @@ TEST(inputconn, csvts_error)
   fileops::remove_dir("csvts");
 }
 
+/** records the number of entries each time a block of files is parsed */
+class BlockTxtInputFileConn : public TxtInputFileConn
+{
+public:
+  void entries_parsed(int test_id) override
+  {
+    (void)test_id;
+    _parsed.push_back(_txt.size());
+  }
+
+  std::vector<size_t> _parsed;
+};
+
+TEST(inputconn, txt_read_dir)
+{
+  // files from a directory are parsed in parallel by blocks, the vocabulary
+  // must match the one from parsing them one by one
+  std::string data_dir = "txt_read_dir";
+  std::vector<std::string> words
+      = { "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf" };
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> dist(0, words.size() - 1);
+  std::vector<std::pair<std::string, int>> contents;
+  fileops::create_dir(data_dir, 0777);
+  for (int cl = 0; cl < 2; ++cl)
+    {
+      std::string cls_dir = data_dir + "/cls" + std::to_string(cl);
+      fileops::create_dir(cls_dir, 0777);
+      for (int f = 0; f < 50; ++f)
+        {
+          std::string ct;
+          for (int w = 0; w < 30; ++w)
+            ct += words[dist(gen)] + (w % 7 == 0 ? ", " : " ");
+          std::ofstream out(cls_dir + "/" + std::to_string(f) + ".txt");
+          out << ct;
+          contents.push_back(std::make_pair(ct, cl));
+        }
+    }
+
+  BlockTxtInputFileConn tifc;
+  tifc._logger = spdlog::stdout_logger_mt("test_txt_read_dir");
+  tifc._train = true;
+  tifc._model_repo = data_dir;
+  tifc._min_count = 1;
+  tifc._dir_block_size = 16;
+  DDTxt dtxt;
+  dtxt._ctfc = &tifc;
+  dtxt._logger = tifc._logger;
+  ASSERT_EQ(0, dtxt.read_dir(data_dir, -1));
+  // entries are handed over once per block
+  ASSERT_EQ(std::vector<size_t>({ 16, 32, 48, 64, 80, 96, 100 }),
+            tifc._parsed);
+
+  TxtInputFileConn ref;
+  ref._train = true;
+  ref._min_count = 1;
+  for (auto &c : contents)
+    ref.parse_content(c.first, c.second);
+
+  ASSERT_EQ(100, tifc._txt.size());
+  ASSERT_EQ(ref._vocab.size(), tifc._vocab.size());
+  std::vector<bool> seen(tifc._vocab.size(), false);
+  for (auto &w : ref._vocab)
+    {
+      Word tw = tifc._vocab.at(w.first);
+      ASSERT_EQ(w.second._total_count, tw._total_count);
+      ASSERT_EQ(w.second._total_docs, tw._total_docs);
+      ASSERT_FALSE(seen.at(tw._pos));
+      seen.at(tw._pos) = true;
+    }
+  std::vector<double> counts(2, 0.0), ref_counts(2, 0.0);
+  for (size_t i = 0; i < tifc._txt.size(); ++i)
+    {
+      TxtBowEntry *tbe = static_cast<TxtBowEntry *>(tifc._txt.at(i));
+      TxtBowEntry *rtbe = static_cast<TxtBowEntry *>(ref._txt.at(i));
+      for (size_t k = 0; k < tbe->size(); ++k)
+        counts.at(tbe->_target) += tbe->values()[k];
+      for (size_t k = 0; k < rtbe->size(); ++k)
+        ref_counts.at(rtbe->_target) += rtbe->values()[k];
+    }
+  // class numbers follow the directory listing order
+  std::sort(counts.begin(), counts.end());
+  std::sort(ref_counts.begin(), ref_counts.end());
+  ASSERT_EQ(ref_counts, counts);
+  fileops::clear_directory(data_dir);
+  fileops::remove_dir(data_dir);
+}
+
+TEST(inputconn, txt_bow_matrix)
+{
+  TxtInputFileConn tifc;
+  tifc._train = true;
+  tifc._min_word_length = 1;
+  tifc.parse_content("beta alpha beta gamma", 0);
+  tifc.parse_content("delta alpha", 1);
+  ASSERT_EQ(4, tifc._vocab.size());
+  ASSERT_EQ(2, tifc._bow->rows());
+  ASSERT_EQ(std::vector<int64_t>({ 0, 3, 5 }), tifc._bow->_indptr);
+  Word alpha = tifc._vocab.at("alpha");
+  ASSERT_EQ(2, alpha._total_count);
+  ASSERT_EQ(2, alpha._total_docs);
+  Word beta = tifc._vocab.at("beta");
+  ASSERT_EQ(2, beta._total_count);
+  ASSERT_EQ(1, beta._total_docs);
+
+  // rows are sorted by vocabulary position, values are word counts
+  TxtBowEntry *tbe = static_cast<TxtBowEntry *>(tifc._txt.at(0));
+  ASSERT_EQ(3, tbe->size());
+  ASSERT_EQ(0, tbe->_row);
+  std::map<int, double> row;
+  tbe->reset();
+  int prev_pos = -1;
+  while (tbe->has_elt())
+    {
+      int pos;
+      double val;
+      tbe->get_next_elt(pos, val);
+      ASSERT_LT(prev_pos, pos);
+      prev_pos = pos;
+      row[pos] = val;
+    }
+  ASSERT_EQ(2.0, row.at(beta._pos));
+  ASSERT_EQ(1.0, row.at(alpha._pos));
+
+  // removing words keeps rows sorted
+  int gamma_pos = tifc._vocab.at("gamma")._pos;
+  std::vector<int> remap(4);
+  for (int p = 0, q = 0; p < 4; ++p)
+    remap[p] = p == gamma_pos ? -1 : q++;
+  tifc._bow->remap(remap);
+  tifc._vocab.erase("gamma");
+  for (auto &w : tifc._vocab)
+    w.second._pos = remap[w.second._pos];
+  ASSERT_EQ(std::vector<int64_t>({ 0, 2, 4 }), tifc._bow->_indptr);
+  ASSERT_EQ(2, tbe->size());
+  ASSERT_LT(tbe->indices()[0], tbe->indices()[1]);
+
+  // unknown words are dropped at prediction time, no counts
+  tifc._train = false;
+  tifc._count = false;
+  tifc.parse_content("alpha alpha epsilon", 0);
+  tbe = static_cast<TxtBowEntry *>(tifc._txt.at(2));
+  ASSERT_EQ(1, tbe->size());
+  ASSERT_EQ(1.0, tbe->values()[0]);
+  ASSERT_EQ(3, tifc._vocab.size());
+}
+
+TEST(inputconn, txt_wordpiece)
+{
+  std::unordered_map<std::string, Word> vocab;
+  int pos = 0;
+  for (std::string token :
+       { "[UNK]", "un", "unaff", "##aff", "##able", "##ab", "##le", "a" })
+    vocab.emplace(token, Word(pos++));
+
+  WordPieceTokenizer wpt;
+  ASSERT_FALSE(wpt.compiled());
+  wpt.compile(vocab);
+  ASSERT_TRUE(wpt.compiled());
+
+  // ids are vocabulary positions
+  std::vector<int> ids;
+  wpt.append_ids("unaffable", 9, ids);
+  ASSERT_EQ(std::vector<int>({ vocab.at("unaff")._pos,
+                               vocab.at("##able")._pos }),
+            ids);
+
+  // longest match first, from the start of the word then on suffixes
+  auto pieces = [&wpt](const std::string &word) {
+    std::vector<int> ids;
+    wpt.append_ids(word.c_str(), word.size(), ids);
+    std::vector<std::string> p;
+    for (int id : ids)
+      p.push_back(wpt.piece(id));
+    return p;
+  };
+  ASSERT_EQ(std::vector<std::string>({ "unaff", "##able" }),
+            pieces("unaffable"));
+  ASSERT_EQ(std::vector<std::string>({ "un", "##able" }), pieces("unable"));
+  ASSERT_EQ(std::vector<std::string>({ "a" }), pieces("a"));
+
+  // a word that cannot be cut entirely is a single unknown piece
+  ids = { 3 };
+  wpt.append_ids("unablex", 7, ids);
+  ASSERT_EQ(std::vector<int>({ 3, -1 }), ids);
+  ASSERT_EQ("[UNK]", wpt.piece(-1));
+  ASSERT_EQ(std::vector<std::string>({ "[UNK]" }), pieces("xyz"));
+
+  // copies share the compiled tries
+  WordPieceTokenizer wpt_copy = wpt;
+  ASSERT_TRUE(wpt_copy.compiled());
+
+  // a new vocabulary generation or prefix requires a new compilation
+  vocab.emplace("_un", Word(pos++));
+  vocab.emplace("le", Word(pos++));
+  ASSERT_FALSE(wpt.compiled(1));
+  wpt._word_start = "_";
+  wpt._suffix_start = "";
+  ASSERT_FALSE(wpt.compiled());
+  wpt.compile(vocab, 1);
+  ASSERT_TRUE(wpt.compiled(1));
+  ASSERT_EQ(std::vector<std::string>({ "_un", "a", "le" }),
+            pieces("unale"));
+}
+
 /*TEST(inputconn,txt_parse_content)
 {
   std::string str = "everything runs fine, right?";
@@ -49,6 +49,7 @@ class CompleteDTOTest : public oatpp::DTO
   DTO_FIELD(oatpp::Vector<oatpp::Any>, v)
       = oatpp::Vector<oatpp::Any>::createShared();
   DTO_FIELD(dd::DTO::DTOVector<bool>, dto_vec) = std::vector<bool>();
+  DTO_FIELD(dd::DTO::DTOVector<int>, int_vec) = std::vector<int>();
   DTO_FIELD(oatpp::Object<VectorDTOTest>, child)
       = VectorDTOTest::createShared();
   DTO_FIELD(oatpp::UnorderedFields<Any>, ufields)
@@ -85,6 +86,7 @@ TEST(dto, dto_to_json)
 {
   auto dto = CompleteDTOTest::createShared();
   dto->dto_vec->push_back(true);
+  dto->int_vec->push_back(-3);
   dto->child->dto_vec->push_back(2.3);
   dto->v->push_back(oatpp::Int32(5));
   dto->v->push_back(VectorDTOTest::createShared());
@@ -110,6 +112,8 @@ TEST(dto, dto_to_json)
   ASSERT_EQ(jdoc["v"][1]["dto_vec"].Size(), 0);
   ASSERT_EQ(jdoc["dto_vec"].Size(), 1);
   ASSERT_EQ(jdoc["dto_vec"][0].GetBool(), true);
+  ASSERT_EQ(jdoc["int_vec"].Size(), 1);
+  ASSERT_EQ(jdoc["int_vec"][0].GetInt(), -3);
   ASSERT_EQ(jdoc["child"]["dto_vec"].Size(), 1);
   ASSERT_EQ(jdoc["child"]["dto_vec"][0].GetDouble(), 2.3);
   ASSERT_EQ(jdoc["ufields"]["a"].GetBool(), false);
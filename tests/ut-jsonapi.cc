@@ -201,6 +201,13 @@ TEST(jsonapi, service_status)
   ASSERT_EQ(
       jd["body"]["service_stats"]["total_transform_duration_ms"].GetDouble(),
       0);
+  ASSERT_TRUE(jd["body"]["service_stats"].HasMember("predict_latency_ms"));
+  ASSERT_EQ(
+      jd["body"]["service_stats"]["predict_latency_ms"]["p50"].GetDouble(),
+      -1);
+  ASSERT_EQ(
+      jd["body"]["service_stats"]["predict_latency_ms"]["p999"].GetDouble(),
+      -1);
 
   std::string jpredictstr
       = "{\"service\":\"" + sname
@@ -234,6 +241,25 @@ TEST(jsonapi, service_status)
   ASSERT_GE(
       jd["body"]["service_stats"]["total_transform_duration_ms"].GetDouble(),
       0);
+  ASSERT_GT(
+      jd["body"]["service_stats"]["predict_latency_ms"]["p50"].GetDouble(),
+      0);
+  ASSERT_GE(
+      jd["body"]["service_stats"]["predict_latency_ms"]["p999"].GetDouble(),
+      jd["body"]["service_stats"]["predict_latency_ms"]["p50"].GetDouble());
+  // failed calls do not account for phases
+  ASSERT_EQ(
+      jd["body"]["service_stats"]["inference_latency_ms"]["p50"].GetDouble(),
+      -1);
+
+  // prometheus metrics
+  std::string metrics = japi.metrics();
+  ASSERT_TRUE(metrics.find("dd_predict_calls_total{service=\"my_service\","
+                           "status=\"failure\"} 1")
+              != std::string::npos);
+  ASSERT_TRUE(metrics.find("dd_predict_duration_seconds_count{service=\"my_"
+                           "service\",phase=\"predict\"} 1")
+              != std::string::npos);
 }
 
 TEST(jsonapi, service_purge)
@@ -19,7 +19,9 @@
  * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <gtest/gtest.h>
 
 #include "oatpp-test/UnitTest.hpp"
@@ -123,6 +125,16 @@ void test_services(std::shared_ptr<DedeApiTestClient> client)
   ASSERT_TRUE(d["head"].HasMember("services"));
   ASSERT_EQ(1, d["head"]["services"].Size());
 
+  // metrics call
+  response = client->get_metrics();
+  message = response->readBodyToString();
+  ASSERT_TRUE(message != nullptr);
+  ASSERT_EQ(response->getStatusCode(), 200);
+  std::string metrics = message->c_str();
+  ASSERT_TRUE(
+      metrics.find("dd_predict_calls_total{service=\"" + serv_lower + "\"")
+      != std::string::npos);
+
   // delete call
   response = client->delete_services(serv.c_str(), nullptr);
   ASSERT_EQ(response->getStatusCode(), 200);
@@ -588,6 +600,56 @@ void test_predict(std::shared_ptr<DedeApiTestClient> client)
   std::cout << "jstr=" << *message << std::endl;
   ASSERT_EQ(response->getStatusCode(), 200);
 
+  // binary predict, one encoded image and one raw image
+  std::ifstream imgf(mnist_repo + "/sample_digit.png", std::ios::binary);
+  std::string img_bytes((std::istreambuf_iterator<char>(imgf)),
+                        std::istreambuf_iterator<char>());
+  ASSERT_FALSE(img_bytes.empty());
+  std::string raw_bytes(28 * 28, '\0');
+  std::string boundary = "ddboundary";
+  std::string call_json
+      = "{\"service\":\"" + serv
+        + "\",\"parameters\":{\"mllib\":{\"gpu\":true},\"input\":{"
+          "\"bw\":true,\"width\":28,\"height\":28},\"output\":{"
+          "\"best\":3}}}";
+  std::string multipart_post
+      = "--" + boundary
+        + "\r\nContent-Disposition: form-data; name=\"call\"\r\n\r\n"
+        + call_json + "\r\n--" + boundary
+        + "\r\nContent-Disposition: form-data; name=\"data\"; "
+          "filename=\"digit.png\"\r\nContent-Type: image/png\r\n\r\n"
+        + img_bytes + "\r\n--" + boundary
+        + "\r\nContent-Disposition: form-data; name=\"data\"; "
+          "filename=\"black\"\r\nX-Raw-Shape: 28x28x1\r\n\r\n"
+        + raw_bytes + "\r\n--" + boundary + "--\r\n";
+  response = client->post_predict_binary(
+      ("multipart/form-data; boundary=" + boundary).c_str(),
+      oatpp::String(multipart_post.data(), multipart_post.size()));
+  message = response->readBodyToString();
+  ASSERT_TRUE(message != nullptr);
+  std::cout << "jstr=" << *message << std::endl;
+  ASSERT_EQ(response->getStatusCode(), 200);
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(message->c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(2, jd["body"]["predictions"].Size());
+  ASSERT_EQ("digit.png", jd["body"]["predictions"][0]["uri"]);
+  ASSERT_EQ("black", jd["body"]["predictions"][1]["uri"]);
+  ASSERT_TRUE(jd["body"]["predictions"][0]["classes"][0]["prob"].GetDouble()
+              > 0);
+
+  // raw shape not matching the data size
+  std::string bad_post
+      = "--" + boundary
+        + "\r\nContent-Disposition: form-data; name=\"call\"\r\n\r\n"
+        + call_json + "\r\n--" + boundary
+        + "\r\nContent-Disposition: form-data; name=\"data\"\r\n"
+          "X-Raw-Shape: 32x32x3\r\n\r\n"
+        + raw_bytes + "\r\n--" + boundary + "--\r\n";
+  response = client->post_predict_binary(
+      ("multipart/form-data; boundary=" + boundary).c_str(),
+      oatpp::String(bad_post.data(), bad_post.size()));
+  ASSERT_EQ(response->getStatusCode(), 400);
+
   // remove services and trained model files
   response = client->delete_services(serv.c_str(), "lib");
   ASSERT_EQ(response->getStatusCode(), 200);
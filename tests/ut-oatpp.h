@@ -95,6 +95,7 @@ class DedeApiTestClient : public oatpp::web::client::ApiClient
 
   API_CLIENT_INIT(DedeApiTestClient)
   API_CALL("GET", "/info", get_info)
+  API_CALL("GET", "/metrics", get_metrics)
   API_CALL("GET", "/services/{service-name}", get_services,
            PATH(oatpp::String, service_name, "service-name"))
   API_CALL("GET", "/services/{service-name}", get_service_with_labels,
@@ -119,6 +120,9 @@ class DedeApiTestClient : public oatpp::web::client::ApiClient
            QUERY(Int16, job))
   API_CALL("POST", "/predict", post_predict,
            BODY_STRING(oatpp::String, predict_data))
+  API_CALL("POST", "/predict/binary", post_predict_binary,
+           HEADER(oatpp::String, content_type, "Content-Type"),
+           BODY_STRING(oatpp::String, predict_data))
 };
 
 typedef std::function<void(std::shared_ptr<DedeApiTestClient>)>
@@ -102,6 +102,51 @@ TEST(faissse, index_search_incr)
   rmdir(model_repo.c_str());
 }
 
+TEST(faissse, search_batch)
+{
+  std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
+  std::vector<double> vec2 = { 0.0, 1.0, 0.0, 0.0 };
+  std::vector<double> vec3 = { 1.0, 0.0, 1.0, 0.0 };
+
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  SearchEngine<FaissSE> se(t, model_repo);
+  se.create_index();
+  se.index(URIData("test1"), vec1);
+  se.index(URIData("test2"), vec2);
+  se.index(URIData("test3"), vec3);
+  se.update_index();
+
+  // queries as rows of a single matrix
+  std::vector<double> queries;
+  for (auto vec : { vec2, vec3, vec1 })
+    queries.insert(queries.end(), vec.begin(), vec.end());
+  std::vector<std::vector<URIData>> uris;
+  std::vector<std::vector<double>> distances;
+  se.search_batch(queries, 2, uris, distances);
+  ASSERT_EQ(uris.size(), 3);
+  ASSERT_EQ(distances.size(), 3);
+  ASSERT_EQ(uris.at(0).at(0)._uri, "test2");
+  ASSERT_EQ(uris.at(1).at(0)._uri, "test3");
+  ASSERT_EQ(uris.at(2).at(0)._uri, "test1");
+  for (size_t i = 0; i < uris.size(); i++)
+    {
+      ASSERT_EQ(uris.at(i).size(), 2);
+      ASSERT_NEAR(distances.at(i).at(0), 0.0, 1e-6);
+    }
+
+  // same results as single searches
+  std::vector<URIData> single_uris;
+  std::vector<double> single_distances;
+  se.search(vec3, 2, single_uris, single_distances);
+  ASSERT_EQ(single_uris.at(1)._uri, uris.at(1).at(1)._uri);
+  ASSERT_NEAR(single_distances.at(1), distances.at(1).at(1), 1e-6);
+
+  se.remove_index();
+  rmdir(model_repo.c_str());
+}
+
 TEST(simsearch, predict_simsearch_unsup)
 {
   // create service
@@ -172,7 +217,7 @@ TEST(simsearch, predict_simsearch_unsup)
 
   // assert existence of index
   ASSERT_TRUE(fileops::file_exists(mnist_repo + "index.faiss"));
-  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.idx"));
 
   // search index
   jpredictstr = "{\"service\":\"" + sname
@@ -199,7 +244,7 @@ TEST(simsearch, predict_simsearch_unsup)
 
   // assert non-existence of index
   ASSERT_TRUE(!fileops::file_exists(mnist_repo + "index.faiss"));
-  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.idx"));
 }
 
 TEST(simsearch, predict_simsearch_sup)
@@ -272,7 +317,7 @@ TEST(simsearch, predict_simsearch_sup)
 
   // assert existence of index
   ASSERT_TRUE(fileops::file_exists(mnist_repo + "index.faiss"));
-  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.idx"));
 
   // search index
   jpredictstr = "{\"service\":\"" + sname
@@ -298,7 +343,7 @@ TEST(simsearch, predict_simsearch_sup)
 
   // assert non-existence of index
   ASSERT_TRUE(!fileops::file_exists(mnist_repo + "index.faiss"));
-  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.idx"));
 }
 
 TEST(simsearch, predict_roi_simsearch)
@@ -347,7 +392,7 @@ TEST(simsearch, predict_roi_simsearch)
 
   // assert existence of index
   ASSERT_TRUE(fileops::file_exists(voc_repo + "index.faiss"));
-  ASSERT_TRUE(fileops::file_exists(voc_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(fileops::file_exists(voc_repo + "names.idx"));
 
   // search index
   jpredictstr = "{\"service\":\"" + sname
@@ -374,7 +419,7 @@ TEST(simsearch, predict_roi_simsearch)
 
   // assert non-existence of index
   ASSERT_TRUE(!fileops::file_exists(voc_repo + "index.faiss"));
-  ASSERT_TRUE(!fileops::file_exists(voc_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(!fileops::file_exists(voc_repo + "names.idx"));
 }
 
 TEST(simsearch, predict_chain)
@@ -488,5 +533,5 @@ TEST(simsearch, predict_chain)
 
   // assert non-existence of index
   ASSERT_TRUE(!fileops::file_exists(mnist_repo + "index.faiss"));
-  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.idx"));
 }
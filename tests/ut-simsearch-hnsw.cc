@@ -0,0 +1,348 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "simsearch.h"
+#include "jsonapi.h"
+#include <gtest/gtest.h>
+#include <iostream>
+#include <random>
+#include <set>
+#include <thread>
+
+using namespace dd;
+
+static std::string ok_str = "{\"status\":{\"code\":200,\"msg\":\"OK\"}}";
+static std::string created_str
+    = "{\"status\":{\"code\":201,\"msg\":\"Created\"}}";
+
+static std::string mnist_repo = "../examples/caffe/mnist/";
+static std::string iterations_mnist = "2";
+
+// fraction of the exact k nearest neighbors found by the graph
+static double hnsw_recall(const HNSWIndex &index,
+                          const std::vector<float> &data,
+                          const std::vector<float> &queries, const int &dim,
+                          const int &k)
+{
+  int n = data.size() / dim;
+  int nq = queries.size() / dim;
+  int found = 0;
+  for (int q = 0; q < nq; ++q)
+    {
+      std::vector<std::pair<float, int>> exact;
+      for (int i = 0; i < n; ++i)
+        {
+          float d = 0.0;
+          for (int j = 0; j < dim; ++j)
+            {
+              float diff = queries[q * dim + j] - data[i * dim + j];
+              d += diff * diff;
+            }
+          exact.emplace_back(d, i);
+        }
+      std::partial_sort(exact.begin(), exact.begin() + k, exact.end());
+      std::set<int> truth;
+      for (int i = 0; i < k; ++i)
+        truth.insert(exact[i].second);
+      for (auto r : index.search(&queries[q * dim], k, 64))
+        found += truth.count(r.second);
+    }
+  return found / static_cast<double>(nq * k);
+}
+
+TEST(hnswindex, recall)
+{
+  int n = 5000, nq = 50, dim = 16, k = 10;
+  std::mt19937 rng(1);
+  std::normal_distribution<float> normal;
+  std::vector<float> data(n * dim), queries(nq * dim);
+  for (float &x : data)
+    x = normal(rng);
+  for (float &x : queries)
+    x = normal(rng);
+
+  for (auto storage : { HNSWIndex::FLOAT32, HNSWIndex::INT8 })
+    {
+      HNSWIndex index(dim, 16, 200, storage);
+      // two batches, the second one is inserted into the first one's graph
+      ASSERT_EQ(index.add(data.data(), n / 2), 0);
+      ASSERT_EQ(index.add(data.data() + n / 2 * dim, n / 2), n / 2);
+      ASSERT_EQ(index.size(), n);
+      double recall = hnsw_recall(index, data, queries, dim, k);
+      std::cerr << "storage=" << storage << " recall@10=" << recall
+                << std::endl;
+      ASSERT_GT(recall, 0.9);
+    }
+}
+
+TEST(hnswindex, remove_save_load)
+{
+  int n = 1000, dim = 8;
+  std::mt19937 rng(2);
+  std::normal_distribution<float> normal;
+  std::vector<float> data(n * dim);
+  for (float &x : data)
+    x = normal(rng);
+  HNSWIndex index(dim);
+  index.add(data.data(), n);
+
+  // a vector is its own nearest neighbor, until removed
+  auto res = index.search(&data[5 * dim], 1, 64);
+  ASSERT_EQ(res.at(0).second, 5);
+  ASSERT_NEAR(res.at(0).first, 0.0, 1e-6);
+  index.remove(5);
+  ASSERT_TRUE(index.removed(5));
+  res = index.search(&data[5 * dim], 10, 64);
+  ASSERT_EQ(res.size(), 10);
+  for (auto r : res)
+    ASSERT_NE(r.second, 5);
+
+  std::string path = "hnsw_test.index";
+  ASSERT_TRUE(index.save(path));
+  for (bool mmap : { true, false })
+    {
+      std::unique_ptr<HNSWIndex> loaded = HNSWIndex::load(path, mmap);
+      ASSERT_TRUE(loaded != nullptr);
+      ASSERT_EQ(loaded->size(), n);
+      ASSERT_TRUE(loaded->removed(5));
+      auto r1 = index.search(&data[7 * dim], 10, 64);
+      auto r2 = loaded->search(&data[7 * dim], 10, 64);
+      ASSERT_EQ(r1, r2);
+
+      // inserting into a loaded index
+      std::vector<float> vec(dim, 10.0);
+      ASSERT_EQ(loaded->add(vec.data(), 1), n);
+      ASSERT_EQ(loaded->search(vec.data(), 1, 64).at(0).second, n);
+    }
+  remove(path.c_str());
+}
+
+TEST(hnswse, index_search)
+{
+  std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
+  std::vector<double> vec2 = { 0.0, 1.0, 0.0, 0.0 };
+  std::vector<double> vec3 = { 1.0, 0.0, 1.0, 0.0 };
+  std::vector<double> vec4 = { 0.0, 0.0, 5.0, 5.0 };
+
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  {
+    SearchEngine<HnswSE> se(t, model_repo);
+    se.create_index();
+    se.index(URIData("test1"), vec1);
+    se.index(URIData("test2"), vec2);
+    se.index(URIData("test3"), vec3);
+    se.update_index();
+
+    // indexing after saving
+    se.index(URIData("test4"), vec4);
+    std::vector<URIData> uris;
+    std::vector<double> distances;
+    se.search(vec4, 3, uris, distances);
+    ASSERT_EQ(uris.size(), 3);
+    ASSERT_EQ(uris.at(0)._uri, "test4");
+    ASSERT_NEAR(distances.at(0), 0.0, 1e-6);
+
+    // removed vectors are not returned
+    se.remove({ 1 });
+    uris.clear();
+    distances.clear();
+    se.search(vec2, 4, uris, distances);
+    ASSERT_EQ(uris.size(), 3);
+    for (auto uri : uris)
+      ASSERT_NE(uri._uri, "test2");
+    std::vector<double> queries(vec2);
+    queries.insert(queries.end(), vec1.begin(), vec1.end());
+    std::vector<std::vector<URIData>> buris;
+    std::vector<std::vector<double>> bdistances;
+    se.search_batch(queries, 4, buris, bdistances);
+    ASSERT_EQ(buris.size(), 2);
+    for (auto &quris : buris)
+      {
+        ASSERT_EQ(quris.size(), 3);
+        for (auto uri : quris)
+          ASSERT_NE(uri._uri, "test2");
+      }
+    se.update_index();
+  }
+
+  // reopening the saved index, removals included
+  SearchEngine<HnswSE> se(t, model_repo);
+  se.create_index();
+  ASSERT_EQ(se._tse->_hindex->size(), 4);
+  std::vector<URIData> uris;
+  std::vector<double> distances;
+  se.search(vec3, 1, uris, distances);
+  ASSERT_EQ(uris.at(0)._uri, "test3");
+  uris.clear();
+  distances.clear();
+  se.search(vec2, 4, uris, distances);
+  ASSERT_EQ(uris.size(), 3);
+  for (auto uri : uris)
+    ASSERT_NE(uri._uri, "test2");
+  se.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(hnswse, concurrent_search)
+{
+  int dim = 16;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+  auto random_vec = [&]() {
+    std::vector<double> vec(dim);
+    for (double &v : vec)
+      v = unif(rng);
+    return vec;
+  };
+  std::vector<std::vector<double>> vecs;
+  std::vector<URIData> uris;
+  for (int i = 0; i < 400; ++i)
+    {
+      vecs.push_back(random_vec());
+      uris.push_back(URIData("test" + std::to_string(i)));
+    }
+
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  SearchEngine<HnswSE> se(dim, model_repo);
+  se.create_index();
+  se.index(std::vector<URIData>(uris.begin(), uris.begin() + 200),
+           std::vector<std::vector<double>>(vecs.begin(),
+                                            vecs.begin() + 200));
+
+  // searches with their own candidate list size run while indexing
+  std::vector<std::thread> searchers;
+  std::vector<int> errors(4, 0);
+  for (int t = 0; t < 4; ++t)
+    searchers.emplace_back([&, t]() {
+      SearchParams params;
+      params._nprobe = 16 * (t + 1);
+      for (int q = 0; q < 100; ++q)
+        {
+          std::vector<URIData> nn_uris;
+          std::vector<double> nn_distances;
+          se.search(vecs.at((q * 7 + t) % 200), 5, nn_uris, nn_distances,
+                    params);
+          if (nn_uris.size() != 5)
+            ++errors[t];
+        }
+    });
+  for (int i = 200; i < 400; i += 10)
+    se.index(std::vector<URIData>(uris.begin() + i, uris.begin() + i + 10),
+             std::vector<std::vector<double>>(vecs.begin() + i,
+                                              vecs.begin() + i + 10));
+  for (std::thread &th : searchers)
+    th.join();
+  for (int e : errors)
+    ASSERT_EQ(e, 0);
+
+  std::vector<URIData> nn_uris;
+  std::vector<double> nn_distances;
+  se.search(vecs.at(321), 1, nn_uris, nn_distances);
+  ASSERT_EQ(nn_uris.at(0)._uri, "test321");
+  se.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(simsearch, predict_simsearch_unsup)
+{
+  // create service
+  JsonAPI japi;
+  std::string sname = "my_service";
+  std::string jstr
+      = "{\"mllib\":\"caffe\",\"description\":\"my "
+        "classifier\",\"type\":\"unsupervised\",\"model\":{\"repository\":\""
+        + mnist_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\"},\"mllib\":{"
+          "\"nclasses\":10}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+  JDoc jd;
+
+  // train
+  std::string gpuid = "0";
+  std::string jtrainstr
+      = "{\"service\":\"" + sname
+        + "\",\"async\":false,\"parameters\":{\"mllib\":{\"gpu\":true,"
+          "\"gpuid\":"
+        + gpuid + ",\"solver\":{\"iterations\":" + iterations_mnist
+        + ",\"snapshot\":200,\"snapshot_prefix\":\"" + mnist_repo
+        + "/mylenet\",\"test_interval\":2}},\"output\":{\"measure_hist\":true,"
+          "\"measure\":[\"f1\"]}}}";
+  joutstr = japi.jrender(japi.service_train(jtrainstr));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(201, jd["status"]["code"].GetInt());
+
+  // predict
+  std::string jpredictstr
+      = "{\"service\":\"" + sname
+        + "\",\"parameters\":{\"input\":{\"bw\":true,\"width\":28,\"height\":"
+          "28},\"mllib\":{\"extract_layer\":\"ip2\"},\"output\":{\"index\":"
+          "true,\"index_type\":\"HNSW16\"}},\"data\":[\""
+        + mnist_repo + "/sample_digit.png\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  std::cout << "joutstr predict index=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_TRUE(jd["body"]["predictions"][0]["indexed"].GetBool());
+
+  // save index
+  jpredictstr = "{\"service\":\"" + sname
+                + "\",\"parameters\":{\"input\":{\"bw\":true,\"width\":28,"
+                  "\"height\":28},\"mllib\":{\"extract_layer\":\"ip2\"},"
+                  "\"output\":{\"build_index\":true}},\"data\":[\""
+                + mnist_repo + "/sample_digit.png\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  std::cout << "joutstr predict build index=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_TRUE(fileops::file_exists(mnist_repo + "index.hnsw"));
+  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.idx"));
+
+  // search index
+  jpredictstr = "{\"service\":\"" + sname
+                + "\",\"parameters\":{\"input\":{\"bw\":true,\"width\":28,"
+                  "\"height\":28},\"mllib\":{\"extract_layer\":\"ip2\"},"
+                  "\"output\":{\"search\":true,\"nprobe\":32}},\"data\":[\""
+                + mnist_repo + "/sample_digit.png\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  std::cout << "joutstr predict search=" << joutstr << std::endl;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200, jd["status"]["code"]);
+  // assert result is itself
+  ASSERT_TRUE(jd["body"]["predictions"][0].HasMember("nns"));
+  ASSERT_TRUE(jd["body"]["predictions"][0]["nns"][0]["dist"].GetDouble()
+              < 1e-6);
+  ASSERT_TRUE(jd["body"]["predictions"][0]["nns"][0]["uri"]
+              == "../examples/caffe/mnist//sample_digit.png");
+
+  // remove service
+  jstr = "{\"clear\":\"lib\"}";
+  joutstr = japi.jrender(japi.service_delete(sname, jstr));
+  ASSERT_EQ(ok_str, joutstr);
+  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "index.hnsw"));
+}
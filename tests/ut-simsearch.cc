@@ -102,6 +102,174 @@ TEST(annoyse, index_search_incr)
   rmdir(model_repo.c_str());
 }
 
+TEST(annoyse, index_search_delta)
+{
+  std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
+  std::vector<double> vec2 = { 0.0, 1.0, 0.0, 0.0 };
+  std::vector<double> vec3 = { 1.0, 0.0, 1.0, 0.0 };
+  std::vector<double> vec4 = { 0.0, 0.0, 5.0, 5.0 };
+
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  AnnoySE ase(t, model_repo);
+  ase.create_index();
+  ase.index(URIData("test1"), vec1);
+  ase.index(URIData("test2"), vec2);
+  ase.index(URIData("test3"), vec3);
+  ase.update_index(); // tree building and saving
+
+  // indexing after the tree has been saved goes to the delta
+  ase.index(URIData("test4"), vec4);
+  ASSERT_EQ(ase.delta_size(), 1);
+  std::vector<URIData> uris;
+  std::vector<double> distances;
+  ase.search(vec4, 2, uris, distances);
+  ASSERT_EQ(uris.size(), 2);
+  ASSERT_EQ(uris.at(0)._uri, "test4");
+  ASSERT_NEAR(distances.at(0), 0.0, 1e-6);
+  ASSERT_LE(distances.at(0), distances.at(1));
+
+  // the delta is merged into a new tree
+  ase.update_index();
+  ASSERT_EQ(ase.delta_size(), 0);
+  uris.clear();
+  distances.clear();
+  ase.search(vec4, 4, uris, distances);
+  ASSERT_EQ(uris.size(), 4);
+  ASSERT_EQ(uris.at(0)._uri, "test4");
+  ASSERT_NEAR(distances.at(0), 0.0, 1e-6);
+  ase.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(annoyse, search_batch)
+{
+  std::vector<double> vec1 = { 1.0, 0.0, 0.0, 0.0 };
+  std::vector<double> vec2 = { 0.0, 1.0, 0.0, 0.0 };
+  std::vector<double> vec3 = { 1.0, 0.0, 1.0, 0.0 };
+
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  SearchEngine<AnnoySE> se(t, model_repo);
+  se.create_index();
+  se.index(URIData("test1"), vec1);
+  se.index(URIData("test2"), vec2);
+  se.index(URIData("test3"), vec3);
+  se.update_index();
+
+  // queries as rows of a single matrix
+  std::vector<double> queries;
+  for (auto vec : { vec2, vec3, vec1 })
+    queries.insert(queries.end(), vec.begin(), vec.end());
+  std::vector<std::vector<URIData>> uris;
+  std::vector<std::vector<double>> distances;
+  se.search_batch(queries, 2, uris, distances);
+  ASSERT_EQ(uris.size(), 3);
+  ASSERT_EQ(distances.size(), 3);
+  ASSERT_EQ(uris.at(0).at(0)._uri, "test2");
+  ASSERT_EQ(uris.at(1).at(0)._uri, "test3");
+  ASSERT_EQ(uris.at(2).at(0)._uri, "test1");
+  for (size_t i = 0; i < uris.size(); i++)
+    {
+      ASSERT_EQ(uris.at(i).size(), 2);
+      ASSERT_NEAR(distances.at(i).at(0), 0.0, 1e-6);
+    }
+
+  // same results as single searches
+  std::vector<URIData> single_uris;
+  std::vector<double> single_distances;
+  se.search(vec3, 2, single_uris, single_distances);
+  ASSERT_EQ(single_uris.at(1)._uri, uris.at(1).at(1)._uri);
+  ASSERT_NEAR(single_distances.at(1), distances.at(1).at(1), 1e-6);
+
+  // per-call search parameters
+  SearchParams params;
+  params._search_k = 1000;
+  se.search_batch(queries, 3, uris, distances, params);
+  ASSERT_EQ(uris.at(1).size(), 3);
+  ASSERT_EQ(uris.at(1).at(0)._uri, "test3");
+
+  se.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(uristore, put_get)
+{
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  {
+    URIStore uris;
+    uris.open(model_repo);
+    ASSERT_EQ(0, uris.size());
+    uris.put(0, { URIData("test0"),
+                  URIData("test1", { 1.0, 2.0, 3.0, 4.0 }, 0.5, "cat") });
+    uris.put(4, { URIData("test4") }); // ids 2 and 3 have no uri
+    ASSERT_EQ(5, uris.size());
+    ASSERT_THROW(uris.put(1, { URIData("test1") }), SimIndexException);
+
+    URIData uri;
+    ASSERT_TRUE(uris.get(1, uri));
+    ASSERT_EQ("test1", uri._uri);
+    ASSERT_EQ("cat", uri._cat);
+    ASSERT_EQ(4, uri._bbox.size());
+    ASSERT_EQ(3.0, uri._bbox.at(2));
+    ASSERT_EQ(0.5, uri._prob);
+    ASSERT_FALSE(uris.get(2, uri));
+    ASSERT_FALSE(uris.get(5, uri));
+  }
+
+  // reopen
+  URIStore uris;
+  uris.open(model_repo);
+  ASSERT_EQ(5, uris.size());
+  URIData uri;
+  ASSERT_TRUE(uris.get(4, uri));
+  ASSERT_EQ("test4", uri._uri);
+  ASSERT_TRUE(uri._bbox.empty());
+  ASSERT_TRUE(uris.get(0, uri));
+  ASSERT_EQ("test0", uri._uri);
+  uris.remove();
+  ASSERT_FALSE(fileops::file_exists(model_repo + "/names.idx"));
+  rmdir(model_repo.c_str());
+}
+
+TEST(uristore, import_legacy_db)
+{
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(), 0770);
+  {
+    db::DB *legacy_db = db::GetDB("lmdb");
+    legacy_db->Open(model_repo + "/names.bin", db::NEW);
+    std::unique_ptr<db::Transaction> txn(legacy_db->NewTransaction());
+    txn->Put("0", URIData("test0").encode());
+    txn->Put("2", URIData("test2").encode());
+    txn->Put("3", URIData("test3").encode());
+    txn->Commit();
+    txn.reset();
+    legacy_db->Close();
+    delete legacy_db;
+  }
+
+  URIStore uris;
+  uris.open(model_repo);
+  ASSERT_EQ(4, uris.size());
+  URIData uri;
+  ASSERT_TRUE(uris.get(3, uri));
+  ASSERT_EQ("test3", uri._uri);
+  ASSERT_TRUE(uris.get(0, uri));
+  ASSERT_EQ("test0", uri._uri);
+  // ids missing from the legacy db have no uri
+  ASSERT_FALSE(uris.get(1, uri));
+  ASSERT_TRUE(fileops::file_exists(model_repo + "/names.idx"));
+  ASSERT_FALSE(fileops::file_exists(model_repo + "/names.idx.tmp"));
+  ASSERT_FALSE(fileops::file_exists(model_repo + "/names.dat.tmp"));
+  uris.remove();
+  ASSERT_FALSE(fileops::file_exists(model_repo + "/names.bin"));
+  rmdir(model_repo.c_str());
+}
+
 TEST(simsearch, predict_simsearch_unsup)
 {
   // create service
@@ -172,9 +340,9 @@ TEST(simsearch, predict_simsearch_unsup)
 
   // assert existence of index
   ASSERT_TRUE(fileops::file_exists(mnist_repo + "index.ann"));
-  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.idx"));
 
-  // assert error on indexing over a built index
+  // indexing over a built index goes to the delta buffer
   jpredictstr = "{\"service\":\"" + sname
                 + "\",\"parameters\":{\"input\":{\"bw\":true,\"width\":28,"
                   "\"height\":28},\"mllib\":{\"extract_layer\":\"ip2\"},"
@@ -184,7 +352,8 @@ TEST(simsearch, predict_simsearch_unsup)
   std::cout << "joutstr predict index=" << joutstr << std::endl;
   jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
   ASSERT_TRUE(!jd.HasParseError());
-  ASSERT_EQ(403, jd["status"]["code"]);
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_TRUE(jd["body"]["predictions"][0]["indexed"].GetBool());
 
   // search index
   jpredictstr = "{\"service\":\"" + sname
@@ -210,7 +379,7 @@ TEST(simsearch, predict_simsearch_unsup)
 
   // assert non-existence of index
   ASSERT_TRUE(!fileops::file_exists(mnist_repo + "index.ann"));
-  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.idx"));
 }
 
 TEST(simsearch, predict_simsearch_sup)
@@ -283,9 +452,9 @@ TEST(simsearch, predict_simsearch_sup)
 
   // assert existence of index
   ASSERT_TRUE(fileops::file_exists(mnist_repo + "index.ann"));
-  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(fileops::file_exists(mnist_repo + "names.idx"));
 
-  // assert error on indexing over a built index
+  // indexing over a built index goes to the delta buffer
   jpredictstr = "{\"service\":\"" + sname
                 + "\",\"parameters\":{\"input\":{\"bw\":true,\"width\":28,"
                   "\"height\":28},\"mllib\":{},\"output\":{\"index\":true,"
@@ -295,7 +464,8 @@ TEST(simsearch, predict_simsearch_sup)
   std::cout << "joutstr predict index=" << joutstr << std::endl;
   jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
   ASSERT_TRUE(!jd.HasParseError());
-  ASSERT_EQ(403, jd["status"]["code"]);
+  ASSERT_EQ(200, jd["status"]["code"]);
+  ASSERT_TRUE(jd["body"]["predictions"][0]["indexed"].GetBool());
 
   // search index
   jpredictstr = "{\"service\":\"" + sname
@@ -321,7 +491,7 @@ TEST(simsearch, predict_simsearch_sup)
 
   // assert non-existence of index
   ASSERT_TRUE(!fileops::file_exists(mnist_repo + "index.ann"));
-  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(!fileops::file_exists(mnist_repo + "names.idx"));
 }
 
 TEST(simsearch, predict_roi_simsearch)
@@ -369,7 +539,7 @@ TEST(simsearch, predict_roi_simsearch)
 
   // assert existence of index
   ASSERT_TRUE(fileops::file_exists(voc_repo + "index.ann"));
-  ASSERT_TRUE(fileops::file_exists(voc_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(fileops::file_exists(voc_repo + "names.idx"));
 
   // search index
   jpredictstr = "{\"service\":\"" + sname
@@ -396,5 +566,5 @@ TEST(simsearch, predict_roi_simsearch)
 
   // assert non-existence of index
   ASSERT_TRUE(!fileops::file_exists(voc_repo + "index.ann"));
-  ASSERT_TRUE(!fileops::file_exists(voc_repo + "names.bin/data.mdb"));
+  ASSERT_TRUE(!fileops::file_exists(voc_repo + "names.idx"));
 }
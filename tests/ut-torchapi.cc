@@ -22,8 +22,12 @@
  */
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <fstream>
 #include <iostream>
 #include <numeric>
+#include <future>
+#include <set>
+#include <thread>
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #pragma GCC diagnostic ignored "-Wunused-variable"
@@ -212,6 +216,240 @@ TEST(torchapi, service_predict)
   ASSERT_EQ(cl_dog, "n02096051 Airedale, Airedale terrier");
 }
 
+TEST(torchapi, service_predict_batching)
+{
+  // create service with dynamic batching
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+          "\"nclasses\":1000,\"batching\":{\"max_batch_size\":4,"
+          "\"max_latency_ms\":100}}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // concurrent single image predict calls are batched together and each
+  // call gets its own prediction back
+  std::vector<std::string> imgs = { "cat.jpg", "dog.jpg", "cat.jpg" };
+  std::vector<std::future<std::string>> futs;
+  for (auto img : imgs)
+    {
+      std::string jpredictstr
+          = "{\"service\":\"imgserv\",\"parameters\":{\"output\":{"
+            "\"best\":1}},\"data\":[\""
+            + incept_repo + img + "\"]}";
+      futs.push_back(std::async(std::launch::async, [&japi, jpredictstr]() {
+        return japi.jrender(japi.service_predict(jpredictstr));
+      }));
+    }
+  for (size_t i = 0; i < imgs.size(); ++i)
+    {
+      joutstr = futs.at(i).get();
+      std::cout << "joutstr=" << joutstr << std::endl;
+      JDoc jd;
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_EQ(jd["body"]["predictions"].Size(), 1);
+      ASSERT_EQ(jd["body"]["predictions"][0]["uri"].GetString(),
+                incept_repo + imgs.at(i));
+      std::string cl
+          = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
+      if (imgs.at(i) == "cat.jpg")
+        ASSERT_EQ(cl, "n02123045 tabby, tabby cat");
+      else
+        ASSERT_EQ(cl, "n02096051 Airedale, Airedale terrier");
+    }
+
+  // remove service
+  joutstr = japi.jrender(japi.service_delete(sname, ""));
+  ASSERT_EQ(ok_str, joutstr);
+}
+
+TEST(torchapi, service_predict_workers)
+{
+  // create service with two predict workers
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+          "\"nclasses\":1000,\"predict_workers\":2}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // concurrent predict calls are dispatched to idle workers
+  std::vector<std::string> imgs = { "cat.jpg", "dog.jpg", "cat.jpg" };
+  std::vector<std::future<std::string>> futs;
+  for (auto img : imgs)
+    {
+      std::string jpredictstr
+          = "{\"service\":\"imgserv\",\"parameters\":{\"output\":{"
+            "\"best\":1}},\"data\":[\""
+            + incept_repo + img + "\"]}";
+      futs.push_back(std::async(std::launch::async, [&japi, jpredictstr]() {
+        return japi.jrender(japi.service_predict(jpredictstr));
+      }));
+    }
+  for (size_t i = 0; i < imgs.size(); ++i)
+    {
+      joutstr = futs.at(i).get();
+      std::cout << "joutstr=" << joutstr << std::endl;
+      JDoc jd;
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_EQ(jd["body"]["predictions"].Size(), 1);
+      ASSERT_EQ(jd["body"]["predictions"][0]["uri"].GetString(),
+                incept_repo + imgs.at(i));
+      std::string cl
+          = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
+      if (imgs.at(i) == "cat.jpg")
+        ASSERT_EQ(cl, "n02123045 tabby, tabby cat");
+      else
+        ASSERT_EQ(cl, "n02096051 Airedale, Airedale terrier");
+    }
+
+  // inferences of all workers count in the service stats
+  joutstr = japi.jrender(japi.service_status(sname));
+  JDoc jd;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(jd["body"]["service_stats"]["inference_count"].GetInt(),
+            static_cast<int>(imgs.size()));
+  ASSERT_EQ(jd["body"]["service_stats"]["predict_count"].GetInt(),
+            static_cast<int>(imgs.size()));
+
+  // remove service
+  joutstr = japi.jrender(japi.service_delete(sname, ""));
+  ASSERT_EQ(ok_str, joutstr);
+}
+
+TEST(torchapi, service_predict_cache)
+{
+  // create service with a predict cache
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+          "\"nclasses\":1000,\"predict_cache\":{\"max_size_mb\":16}}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // the same call twice, the second one is served from the cache
+  std::ifstream ifs(incept_repo + "cat.jpg", std::ios::binary);
+  std::string img_bytes((std::istreambuf_iterator<char>(ifs)),
+                        std::istreambuf_iterator<char>());
+  std::string img_b64;
+  ASSERT_TRUE(Base64::Encode(img_bytes, &img_b64));
+  std::string jpredictstr
+      = "{\"service\":\"imgserv\",\"parameters\":{\"output\":{"
+        "\"best\":1}},\"data\":[\""
+        + img_b64 + "\"]}";
+  for (int i = 0; i < 2; ++i)
+    {
+      joutstr = japi.jrender(japi.service_predict(jpredictstr));
+      std::cout << "joutstr=" << joutstr << std::endl;
+      JDoc jd;
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_EQ(jd["body"]["predictions"].Size(), 1);
+      std::string cl
+          = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
+      ASSERT_EQ(cl, "n02123045 tabby, tabby cat");
+    }
+
+  joutstr = japi.jrender(japi.service_status(sname));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  JDoc jd;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(jd["body"]["service_stats"]["cache_hits"].GetInt(), 1);
+  ASSERT_EQ(jd["body"]["service_stats"]["cache_misses"].GetInt(), 1);
+
+  // files are not cached, their content may change
+  jpredictstr = "{\"service\":\"imgserv\",\"parameters\":{\"output\":{"
+                "\"best\":1}},\"data\":[\""
+                + incept_repo + "cat.jpg\"]}";
+  for (int i = 0; i < 2; ++i)
+    {
+      joutstr = japi.jrender(japi.service_predict(jpredictstr));
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_EQ(200, jd["status"]["code"]);
+    }
+  joutstr = japi.jrender(japi.service_status(sname));
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(jd["body"]["service_stats"]["cache_hits"].GetInt(), 1);
+  ASSERT_EQ(jd["body"]["service_stats"]["cache_misses"].GetInt(), 1);
+
+  // remove service
+  joutstr = japi.jrender(japi.service_delete(sname, ""));
+  ASSERT_EQ(ok_str, joutstr);
+}
+
+TEST(torchapi, service_predict_prefetch)
+{
+  JsonAPI japi;
+  std::string sname = "imgserv";
+  std::string jstr
+      = "{\"mllib\":\"torch\",\"description\":\"resnet-50\",\"type\":"
+        "\"supervised\",\"model\":{\"repository\":\""
+        + incept_repo
+        + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+          "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+          "\"nclasses\":1000}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // batches of one image, prefetched or not, keep the data order
+  std::vector<std::string> imgs
+      = { "cat.jpg", "dog.jpg", "dog.jpg", "cat.jpg", "dog.jpg" };
+  std::string data;
+  for (auto img : imgs)
+    data += std::string(data.empty() ? "" : ",") + "\"" + incept_repo + img
+            + "\"";
+  for (int prefetch : { 0, 2 })
+    {
+      std::string jpredictstr
+          = "{\"service\":\"imgserv\",\"parameters\":{\"mllib\":{\"net\":{"
+            "\"test_batch_size\":1,\"prefetch_batches\":"
+            + std::to_string(prefetch)
+            + "}},\"output\":{\"best\":1}},\"data\":[" + data + "]}";
+      joutstr = japi.jrender(japi.service_predict(jpredictstr));
+      JDoc jd;
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_TRUE(!jd.HasParseError());
+      ASSERT_EQ(200, jd["status"]["code"]);
+      ASSERT_EQ(jd["body"]["predictions"].Size(), imgs.size());
+      for (size_t i = 0; i < imgs.size(); ++i)
+        {
+          auto &pred = jd["body"]["predictions"][static_cast<int>(i)];
+          ASSERT_EQ(pred["uri"].GetString(), incept_repo + imgs.at(i));
+          std::string cl = pred["classes"][0]["cat"].GetString();
+          if (imgs.at(i) == "cat.jpg")
+            ASSERT_EQ(cl, "n02123045 tabby, tabby cat");
+          else
+            ASSERT_EQ(cl, "n02096051 Airedale, Airedale terrier");
+        }
+    }
+
+  // remove service
+  joutstr = japi.jrender(japi.service_delete(sname, ""));
+  ASSERT_EQ(ok_str, joutstr);
+}
+
 TEST(torchapi, service_predict_native_bw)
 {
   // Predict greyscale image with native model should work
@@ -497,6 +735,71 @@ TEST(torchapi, service_predict_segmentation)
   ASSERT_TRUE(confs.IsArray());
   ASSERT_TRUE(preds.Size() == 500 * 374);
   ASSERT_TRUE(confs.Size() == 500 * 374);
+  std::vector<int> classes;
+  for (auto &v : preds.GetArray())
+    classes.push_back(static_cast<int>(v.GetDouble()));
+
+  // encoded masks decode to the same class map
+  for (std::string format : { "rle", "png" })
+    {
+      jpredictstr = "{\"service\":\"segserv\",\"parameters\":{"
+                    "\"input\":{\"height\":224,"
+                    "\"width\":224},\"output\":{\"segmentation\":true, "
+                    "\"confidences\":[\"best\"],\"mask_format\":\""
+                    + format + "\"}},\"data\":[\"" + seg_repo
+                    + "cat.jpg\"]}";
+      joutstr = japi.jrender(japi.service_predict(jpredictstr));
+      JDoc jdm;
+      jdm.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_TRUE(!jdm.HasParseError());
+      ASSERT_EQ(200, jdm["status"]["code"]);
+      auto &pred = jdm["body"]["predictions"][0];
+      ASSERT_FALSE(pred.HasMember("vals"));
+      ASSERT_TRUE(pred.HasMember("mask_confidence"));
+      auto &mask = pred["mask"];
+      ASSERT_EQ(format, mask["format"].GetString());
+      int height = mask["height"].GetInt();
+      int width = mask["width"].GetInt();
+      ASSERT_EQ(500 * 374, height * width);
+
+      cv::Mat segimg;
+      if (format == "rle")
+        {
+          std::vector<int> values, counts;
+          for (auto &v : mask["values"].GetArray())
+            values.push_back(v.GetInt());
+          for (auto &c : mask["counts"].GetArray())
+            counts.push_back(c.GetInt());
+          ASSERT_LT(values.size(), classes.size() / 100);
+          segimg = cv_utils::rle_to_mask(values, counts, height, width);
+        }
+      else
+        {
+          cv_utils::base64_to_image(mask["data"].GetString())
+              .convertTo(segimg, CV_32SC1);
+          ASSERT_EQ(height, segimg.rows);
+          ASSERT_EQ(width, segimg.cols);
+        }
+      ASSERT_EQ(classes, std::vector<int>(segimg.begin<int>(),
+                                          segimg.end<int>()));
+    }
+
+  jpredictstr = "{\"service\":\"segserv\",\"parameters\":{"
+                "\"output\":{\"segmentation\":true,\"mask_format\":"
+                "\"jpg\"}},\"data\":[\""
+                + seg_repo + "cat.jpg\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(400, jd["status"]["code"]);
+
+  // only the "best" confidence map is encoded
+  jpredictstr = "{\"service\":\"segserv\",\"parameters\":{"
+                "\"output\":{\"segmentation\":true,\"confidences\":"
+                "[\"all\"],\"mask_format\":\"rle\"}},\"data\":[\""
+                + seg_repo + "cat.jpg\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(400, jd["status"]["code"]);
 }
 
 TEST(torchapi, service_predict_txt_classification)
@@ -543,20 +846,222 @@ TEST(inputconn, txt_tokenize_ordered_words)
   tifc._wordpiece_tokens = true;
   tifc._punctuation_tokens = true;
 
-  tifc._vocab["every"] = Word();
-  tifc._vocab["##ing"] = Word();
-  tifc._vocab["##thing"] = Word();
-  tifc._vocab["fine"] = Word();
-  tifc._vocab[","] = Word();
-  tifc._vocab["?"] = Word();
-  tifc._vocab["right"] = Word();
+  int pos = 0;
+  for (std::string token :
+       { "every", "##ing", "##thing", "fine", ",", "?", "right" })
+    tifc._vocab[token] = Word(pos++);
+  tifc.vocab_changed();
 
   tifc.parse_content(str, 1);
   TxtOrderedWordsEntry &towe
       = *dynamic_cast<TxtOrderedWordsEntry *>(tifc._txt.at(0));
-  std::vector<std::string> tokens{ "every", "##thing", "[UNK]", "fine",
-                                   ",",     "right",   "?" };
-  ASSERT_EQ(tokens, towe._v);
+  // every ##thing [UNK] fine , right ?
+  std::vector<int> ids{ 0, 2, -1, 3, 4, 6, 5 };
+  ASSERT_EQ(ids, towe._ids);
+  ASSERT_TRUE(towe._v.empty());
+
+  // the vocabulary generation triggers a new compilation
+  tifc._vocab["runs"] = Word(pos++);
+  tifc.vocab_changed();
+  tifc.parse_content(str, 1);
+  ASSERT_EQ(7, dynamic_cast<TxtOrderedWordsEntry *>(tifc._txt.at(1))
+                   ->_ids.at(2));
+}
+
+TEST(inputconn, txt_torch_read_dir_db)
+{
+  std::string data_dir = "txt_torch_read_dir";
+  fileops::create_dir(data_dir, 0777);
+  for (int cl = 0; cl < 2; ++cl)
+    {
+      std::string cls_dir = data_dir + "/cls" + std::to_string(cl);
+      fileops::create_dir(cls_dir, 0777);
+      for (int f = 0; f < 20; ++f)
+        {
+          std::ofstream out(cls_dir + "/" + std::to_string(f) + ".txt");
+          out << "alpha bravo charlie " << f;
+        }
+    }
+
+  TxtTorchInputFileConn tifc;
+  tifc._logger = spdlog::stdout_logger_mt("test_txt_torch_read_dir");
+  tifc._train = true;
+  tifc._ordered_words = true;
+  tifc._input_format = "bert";
+  tifc._width = 8;
+  tifc._db = true;
+  tifc._dir_block_size = 16;
+  DDTxt dtxt;
+  dtxt._ctfc = &tifc;
+  dtxt._logger = tifc._logger;
+  ASSERT_EQ(0, dtxt.read_dir(data_dir, -1));
+
+  // entries are pushed after each block of files, the last one included
+  ASSERT_TRUE(tifc._txt.empty());
+  ASSERT_EQ(40, tifc._dataset._batches.size());
+  ASSERT_EQ(8, tifc._ndbed);
+  fileops::clear_directory(data_dir);
+  fileops::remove_dir(data_dir);
+}
+
+TEST(inputconn, img_torch_image_to_tensor)
+{
+  ImgTorchInputFileConn inputc;
+  inputc._scale = 0.5;
+  inputc._mean = { 10, 20, 30 };
+  inputc._std = { 2, 3, 4 };
+
+  cv::Mat src(48, 64, CV_8UC3);
+  cv::randu(src, 0, 255);
+  cv::Mat view = src(cv::Rect(5, 7, 32, 24));
+
+  // reference: unfused conversion
+  cv::Mat cont = view.clone();
+  at::Tensor raw = torch::from_blob(cont.data, { 24, 32, 3 }, at::kByte)
+                       .toType(at::kFloat)
+                       .permute({ 2, 0, 1 });
+  at::Tensor ref = raw.mul(0.5);
+  for (int c = 0; c < 3; ++c)
+    ref[c] = ref[c].sub_(inputc._mean[c]).div_(inputc._std[c]);
+
+  at::Tensor imgt = inputc._dataset.image_to_tensor(view);
+  ASSERT_EQ(imgt.sizes(), ref.sizes());
+  ASSERT_TRUE(torch::allclose(imgt, ref, 1e-5, 1e-5));
+
+  // write into a half batch slot
+  at::Tensor batch = torch::zeros({ 2, 3, 24, 32 }, at::kHalf);
+  at::Tensor slot = batch[1];
+  inputc._dataset.image_to_tensor(view, slot);
+  ASSERT_TRUE(torch::allclose(batch[1].toType(at::kFloat), ref, 1e-2, 1e-2));
+  ASSERT_EQ(batch[0].abs().sum().item<float>(), 0);
+
+  // targets are not normalized
+  at::Tensor tgt = inputc._dataset.image_to_tensor(view, true);
+  ASSERT_TRUE(torch::equal(tgt, raw));
+
+  // bw images are duplicated when the model does not support them
+  cv::Mat bw(24, 32, CV_8UC1, cv::Scalar(100));
+  inputc._supports_bw = false;
+  at::Tensor bwt = inputc._dataset.image_to_tensor(bw);
+  ASSERT_EQ(bwt.size(0), 3);
+  ASSERT_NEAR(bwt[2][0][0].item<float>(), (100 * 0.5 - 30) / 4.0, 1e-5);
+
+  inputc._mean = { 10, 20 };
+  ASSERT_THROW(inputc._dataset.image_to_tensor(view),
+               InputConnectorBadParamException);
+}
+
+TEST(inputconn, img_torch_db_raw)
+{
+  cv::Mat src(48, 64, CV_8UC3);
+  cv::randu(src, 0, 255);
+  cv::Mat view = src(cv::Rect(5, 7, 32, 24));
+
+  std::string raw;
+  TorchDataset::image_to_raw(view, raw);
+  cv::Mat img;
+  ASSERT_TRUE(TorchDataset::raw_to_image(raw, img));
+  ASSERT_EQ(img.size(), view.size());
+  ASSERT_EQ(img.type(), view.type());
+  ASSERT_EQ(cv::norm(img, view, cv::NORM_INF), 0);
+
+  // encoded images are not raw images
+  std::vector<uint8_t> buf;
+  cv::imencode(".png", view, buf);
+  ASSERT_FALSE(TorchDataset::raw_to_image(std::string(buf.begin(), buf.end()),
+                                          img));
+
+  raw.pop_back();
+  ASSERT_THROW(TorchDataset::raw_to_image(raw, img),
+               InputConnectorInternalException);
+}
+
+TEST(inputconn, img_torch_db_raw_segmentation)
+{
+  cv::Mat src(24, 32, CV_8UC3);
+  cv::randu(src, 0, 255);
+  cv::Mat target(24, 32, CV_8UC1);
+  cv::randu(target, 0, 5);
+
+  std::string datas, targets;
+  TorchDataset::image_to_raw(src, datas);
+  TorchDataset::image_to_raw(target, targets);
+
+  TorchDataset dataset;
+  dataset._segmentation = true;
+  cv::Mat bgr, bw_target;
+  std::vector<torch::Tensor> targett;
+  dataset.read_image_from_db(datas, targets, bgr, targett, bw_target, false,
+                             0, 0);
+  ASSERT_TRUE(targett.empty());
+  ASSERT_EQ(cv::norm(bgr, src, cv::NORM_INF), 0);
+  ASSERT_EQ(bw_target.type(), CV_8UC1);
+  ASSERT_EQ(cv::norm(bw_target, target, cv::NORM_INF), 0);
+
+  // encoded targets are still read, resized with the image
+  std::vector<uint8_t> buf;
+  cv::imencode(".png", target, buf);
+  dataset.read_image_from_db(datas, std::string(buf.begin(), buf.end()), bgr,
+                             targett, bw_target, false, 16, 12);
+  ASSERT_EQ(bgr.size(), cv::Size(16, 12));
+  ASSERT_EQ(bw_target.size(), cv::Size(16, 12));
+  cv::Mat resized;
+  cv::resize(target, resized, cv::Size(16, 12), 0, 0, cv::INTER_NEAREST);
+  ASSERT_EQ(cv::norm(bw_target, resized, cv::NORM_INF), 0);
+}
+
+TEST(inputconn, torch_db_stream)
+{
+  std::string dbname = "ut_db_stream.lmdb";
+  fileops::remove_dir(dbname);
+  std::shared_ptr<db::DB> tdb(db::GetDB("lmdb"));
+  tdb->Open(dbname, db::NEW);
+  std::unique_ptr<db::Transaction> txn(tdb->NewTransaction());
+  int n = 500;
+  for (int i = 0; i < n; ++i)
+    {
+      txn->Put(std::to_string(i) + "_data", "d" + std::to_string(i));
+      txn->Put(std::to_string(i) + "_target", "t" + std::to_string(i));
+    }
+  txn->Commit();
+  txn.reset();
+  tdb->Close();
+  tdb->Open(dbname, db::READ);
+
+  TorchDbStream stream(tdb, 64, 16, true);
+  for (int epoch = 0; epoch < 2; ++epoch)
+    {
+      stream.start(epoch);
+      std::mutex mutex;
+      std::set<std::string> seen;
+      std::vector<std::string> order;
+      std::vector<std::thread> workers;
+      for (int w = 0; w < 4; ++w)
+        workers.emplace_back([&]() {
+          std::vector<TorchDbStream::Record> records;
+          while (stream.pop(10, records) > 0)
+            {
+              std::lock_guard<std::mutex> lock(mutex);
+              for (const TorchDbStream::Record &r : records)
+                {
+                  ASSERT_EQ(r.first.substr(1), r.second.substr(1));
+                  seen.insert(r.first);
+                  order.push_back(r.first);
+                }
+              records.clear();
+            }
+        });
+      for (std::thread &w : workers)
+        w.join();
+
+      // every example once per epoch, not in db order
+      ASSERT_EQ(seen.size(), static_cast<size_t>(n));
+      ASSERT_EQ(order.size(), static_cast<size_t>(n));
+      std::vector<std::string> sorted = order;
+      std::sort(sorted.begin(), sorted.end());
+      ASSERT_NE(order, sorted);
+    }
+  fileops::remove_dir(dbname);
 }
 
 TEST(torchapi, load_weights_native_model)
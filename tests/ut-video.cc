@@ -21,10 +21,12 @@
 
 #include <gtest/gtest.h>
 #include <iostream>
+#include <thread>
 
 #include "oatppjsonapi.h"
 #include "http/controller.hpp"
 #include "utils/oatpp.hpp"
+#include "utils/fileops.hpp"
 
 using namespace dd;
 
@@ -214,4 +216,155 @@ TEST(video, resource)
             std::string("Resource is exhausted"));
 }
 
+TEST(video, resource_background_decoding)
+{
+  auto json_mapper = oatpp_utils::createDDMapper();
+  json_mapper->getDeserializer()->getConfig()->allowUnknownFields = false;
+
+  OatppJsonAPI japi;
+  std::shared_ptr<oatpp::data::mapping::ObjectMapper> mapper = json_mapper;
+  auto controller = DedeController::createShared(&japi, mapper);
+
+  // create resource, every frame is decoded in the background
+  std::string res_name = "video";
+  std::string jstr = "{\"type\":\"video\",\"source\":\""
+                     + example_video_path1
+                     + "\",\"frame_policy\":\"every_frame\","
+                       "\"frame_buffer_size\":4}";
+  std::string joutstr = response_to_str(controller->create_resource(
+      res_name.c_str(),
+      json_mapper->readFromString<oatpp::Object<DTO::Resource>>(
+          jstr.c_str())));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  JDoc jd;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(201, jd["status"]["code"].GetInt());
+
+  // create service
+  std::string sname = "detectserv";
+  jstr = "{\"mllib\":\"torch\",\"description\":\"fasterrcnn\",\"type\":"
+         "\"supervised\",\"model\":{\"repository\":\""
+         + detect_repo
+         + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+           "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+           "\"template\":\"fasterrcnn\",\"gpu\":true,\"gpuid\":0}}}";
+  joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  std::string jpredictstr = "{\"service\":\"detectserv\",\"parameters\":{"
+                            "\"input\":{\"height\":224,"
+                            "\"width\":224},\"output\":{\"bbox\":true, "
+                            "\"confidence_threshold\":0.8}},\"data\":[\""
+                            + res_name + "\"]}";
+
+  // every frame is processed, the last one ends the resource
+  for (int frame_id = 0; frame_id < 30; ++frame_id)
+    {
+      joutstr = japi.jrender(japi.service_predict(jpredictstr));
+      jd = JDoc();
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_EQ(200, jd["status"]["code"].GetInt());
+    }
+  std::cout << "joutstr=" << joutstr << std::endl;
+  ASSERT_EQ(std::string("ended"),
+            jd["body"]["resources"][0]["status"].GetString());
+
+  joutstr = response_to_str(controller->get_resource(res_name.c_str()));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd = JDoc();
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(200, jd["status"]["code"].GetInt());
+  ASSERT_EQ(30, jd["body"]["video"]["current_frame"].GetInt());
+  ASSERT_EQ(30, jd["body"]["video"]["decoded_frames"].GetInt());
+  ASSERT_EQ(0, jd["body"]["video"]["dropped_frames"].GetInt());
+
+  // prediction after last frame
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  jd = JDoc();
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(403, jd["status"]["code"].GetInt());
+}
+
+TEST(video, stream)
+{
+  auto json_mapper = oatpp_utils::createDDMapper();
+  json_mapper->getDeserializer()->getConfig()->allowUnknownFields = false;
+
+  OatppJsonAPI japi;
+  std::shared_ptr<oatpp::data::mapping::ObjectMapper> mapper = json_mapper;
+  auto controller = DedeController::createShared(&japi, mapper);
+
+  // create resource
+  std::string res_name = "video";
+  std::string jstr
+      = "{\"type\":\"video\",\"source\":\"" + example_video_path1 + "\"}";
+  std::string joutstr = response_to_str(controller->create_resource(
+      res_name.c_str(),
+      json_mapper->readFromString<oatpp::Object<DTO::Resource>>(
+          jstr.c_str())));
+  JDoc jd;
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(201, jd["status"]["code"].GetInt());
+
+  // create service
+  std::string sname = "detectserv";
+  jstr = "{\"mllib\":\"torch\",\"description\":\"fasterrcnn\",\"type\":"
+         "\"supervised\",\"model\":{\"repository\":\""
+         + detect_repo
+         + "\"},\"parameters\":{\"input\":{\"connector\":\"image\",\"height\":"
+           "224,\"width\":224,\"rgb\":true,\"scale\":0.0039},\"mllib\":{"
+           "\"template\":\"fasterrcnn\",\"gpu\":true,\"gpuid\":0}}}";
+  joutstr = japi.jrender(japi.service_create(sname, jstr));
+  ASSERT_EQ(created_str, joutstr);
+
+  // stream the resource through the service into a video file
+  std::string stream_name = "detectstream";
+  std::string video_out = "stream_out.avi";
+  jstr = "{\"predict\":{\"service\":\"detectserv\",\"parameters\":{"
+         "\"input\":{\"height\":224,\"width\":224},\"output\":{"
+         "\"bbox\":true,\"confidence_threshold\":0.8}},\"data\":[\""
+         + res_name
+         + "\"]},\"output\":{\"type\":\"video\",\"video_encoding\":"
+           "\"MJPG\",\"video_out\":\""
+         + video_out + "\"}}";
+  joutstr = response_to_str(controller->create_stream(
+      stream_name.c_str(),
+      json_mapper->readFromString<oatpp::Object<DTO::Stream>>(jstr.c_str())));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd = JDoc();
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(201, jd["status"]["code"].GetInt());
+
+  // wait for the end of the resource
+  std::string status = "running";
+  for (int i = 0; i < 600 && status == "running"; ++i)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      joutstr
+          = response_to_str(controller->get_stream_info(stream_name.c_str()));
+      jd = JDoc();
+      jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+      ASSERT_EQ(200, jd["status"]["code"].GetInt());
+      status = jd["body"]["status"].GetString();
+    }
+  std::cout << "joutstr=" << joutstr << std::endl;
+  ASSERT_EQ("ended", status);
+  ASSERT_EQ(30, jd["body"]["frames"].GetInt());
+  ASSERT_TRUE(jd["body"]["latency"].GetDouble() > 0.0);
+  ASSERT_TRUE(jd["body"]["infer_time"].GetDouble() > 0.0);
+
+  // delete stream
+  joutstr = response_to_str(controller->delete_stream(stream_name.c_str()));
+  jd = JDoc();
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(200, jd["status"]["code"].GetInt());
+  ASSERT_TRUE(fileops::file_exists(video_out));
+  remove(video_out.c_str());
+
+  joutstr = response_to_str(controller->get_stream_info(stream_name.c_str()));
+  jd = JDoc();
+  jd.Parse<rapidjson::kParseNanAndInfFlag>(joutstr.c_str());
+  ASSERT_EQ(404, jd["status"]["code"].GetInt());
+}
+
 #endif
@@ -0,0 +1,147 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "txtinputfileconn.h"
+
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace dd;
+
+int main(int argc, char **argv)
+{
+  const char *vocabfname = "";
+  char sep = '\t';
+  int iterations = 10000;
+
+  std::string usage = *argv;
+  usage += " -v VOCAB [-s SEP] [-n ITERATIONS]\n\n"
+           "Measures wordpiece tokenization throughput on sentences of "
+           "8, 32 and 128\nwords drawn from a model vocabulary, e.g. "
+           "vocab.dat of a BERT model repository.\n\n"
+           "-v VOCAB       Vocabulary file, one token<SEP>id per line, "
+           "mandatory\n"
+           "-s SEP         Vocabulary separator (default tab)\n"
+           "-n ITERATIONS  Number of sentences per length (default "
+           "10000)\n";
+  auto error = [&usage]() {
+    std::cerr << usage << std::endl;
+    exit(1);
+  };
+
+  int c;
+  while ((c = getopt(argc, argv, "v:s:n:")) != -1)
+    {
+      switch (c)
+        {
+        case 'v':
+          vocabfname = optarg;
+          break;
+        case 's':
+          sep = *optarg;
+          break;
+        case 'n':
+          iterations = std::max(1, atoi(optarg));
+          break;
+        default:
+          error();
+        }
+    }
+  if (!*vocabfname)
+    error();
+
+  std::ifstream in(vocabfname);
+  if (!in.is_open())
+    {
+      std::cerr << "Cannot open vocabulary " << vocabfname << std::endl;
+      return 1;
+    }
+  std::unordered_map<std::string, Word> vocab;
+  std::vector<std::string> words, suffixes;
+  std::string line;
+  while (getline(in, line))
+    {
+      size_t p = line.find(sep);
+      if (p == std::string::npos)
+        continue;
+      std::string token = line.substr(0, p);
+      vocab.emplace(token, Word(atoi(line.c_str() + p + 1)));
+      if (token.compare(0, 2, "##") == 0)
+        suffixes.push_back(token.substr(2));
+      else if (!token.empty() && token[0] != '[')
+        words.push_back(token);
+    }
+  if (words.empty())
+    {
+      std::cerr << "No word in vocabulary " << vocabfname << std::endl;
+      return 1;
+    }
+
+  WordPieceTokenizer wordpiece;
+  auto tstart = std::chrono::steady_clock::now();
+  wordpiece.compile(vocab);
+  double compile_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - tstart)
+                          .count();
+  std::cout << "Compiled " << vocab.size() << " tokens in " << compile_ms
+            << " ms" << std::endl;
+
+  // a quarter of the words get a vocabulary suffix appended, so that
+  // they are cut in several pieces
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<size_t> word_dist(0, words.size() - 1);
+  std::uniform_int_distribution<size_t> suffix_dist(
+      0, std::max<size_t>(suffixes.size(), 1) - 1);
+  std::vector<int> ids;
+  for (int len : { 8, 32, 128 })
+    {
+      const int nsentences = 64;
+      std::vector<std::vector<std::string>> sentences(nsentences);
+      for (auto &s : sentences)
+        for (int w = 0; w < len; ++w)
+          {
+            s.push_back(words[word_dist(rng)]);
+            if (!suffixes.empty() && rng() % 4 == 0)
+              s.back() += suffixes[suffix_dist(rng)];
+          }
+
+      size_t npieces = 0;
+      tstart = std::chrono::steady_clock::now();
+      for (int i = 0; i < iterations; ++i)
+        {
+          ids.clear();
+          for (const std::string &w : sentences[i % nsentences])
+            wordpiece.append_ids(w.c_str(), w.size(), ids);
+          npieces += ids.size();
+        }
+      double ns = std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - tstart)
+                      .count();
+      std::cout << len << " words: " << ns / iterations / 1000.0
+                << " us/sentence, " << ns / (iterations * len)
+                << " ns/word, "
+                << static_cast<double>(npieces) / iterations
+                << " pieces/sentence" << std::endl;
+    }
+  return 0;
+}
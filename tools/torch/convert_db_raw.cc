@@ -0,0 +1,129 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2023 Jolibrain SASU
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "backends/torch/torchdataset.h"
+#include "utils/fileops.hpp"
+
+#include <unistd.h>
+#include <iostream>
+
+using namespace dd;
+
+/** Whether a db value is a JPEG or PNG encoded image */
+static bool is_encoded_image(const std::string &val)
+{
+  static const std::string jpeg("\xff\xd8\xff", 3);
+  static const std::string png("\x89PNG", 4);
+  return val.compare(0, jpeg.size(), jpeg) == 0
+         || val.compare(0, png.size(), png) == 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *input = "";
+  const char *output = "";
+  int txn_size = 1000;
+
+  std::string usage = *argv;
+  usage += " -i INPUT -o OUTPUT [-n TXN_SIZE]\n\n"
+           "Converts a torch training db of encoded images, e.g. "
+           "train.lmdb,\ninto a db of decoded images (see the db_raw "
+           "input parameter).\n\n"
+           "-i INPUT     Input db, mandatory\n"
+           "-o OUTPUT    Output db, mandatory, must not exist\n"
+           "-n TXN_SIZE  Number of records per transaction (default "
+           "1000)\n";
+  auto error = [&usage]() {
+    std::cerr << usage << std::endl;
+    exit(1);
+  };
+
+  int c;
+  while ((c = getopt(argc, argv, "i:o:n:")) != -1)
+    {
+      switch (c)
+        {
+        case 'i':
+          input = optarg;
+          break;
+        case 'o':
+          output = optarg;
+          break;
+        case 'n':
+          txn_size = std::max(1, atoi(optarg));
+          break;
+        default:
+          error();
+        }
+    }
+  if (!*input || !*output)
+    error();
+
+  if (!fileops::dir_exists(input))
+    {
+      std::cerr << "Input db not found: " << input << std::endl;
+      return 1;
+    }
+  if (fileops::dir_exists(output))
+    {
+      std::cerr << "Output db already exists: " << output << std::endl;
+      return 1;
+    }
+
+  std::unique_ptr<db::DB> in(db::GetDB("lmdb"));
+  std::unique_ptr<db::DB> out(db::GetDB("lmdb"));
+  in->Open(input, db::READ);
+  out->Open(output, db::NEW);
+
+  std::unique_ptr<db::Cursor> cursor(in->NewCursor());
+  std::unique_ptr<db::Transaction> txn(out->NewTransaction());
+  size_t nrecords = 0, nimages = 0;
+  std::string raw;
+  for (cursor->SeekToFirst(); cursor->valid(); cursor->Next())
+    {
+      std::string val = cursor->value();
+      if (is_encoded_image(val))
+        {
+          std::vector<uint8_t> buf(val.begin(), val.end());
+          cv::Mat img = cv::imdecode(buf, cv::IMREAD_UNCHANGED);
+          if (img.empty())
+            {
+              std::cerr << "Could not decode " << cursor->key() << std::endl;
+              return 1;
+            }
+          TorchDataset::image_to_raw(img, raw);
+          txn->Put(cursor->key(), raw);
+          ++nimages;
+        }
+      else
+        txn->Put(cursor->key(), val);
+
+      if (++nrecords % txn_size == 0)
+        {
+          txn->Commit();
+          txn.reset(out->NewTransaction());
+          std::cout << "Converted " << nrecords << " records" << std::endl;
+        }
+    }
+  txn->Commit();
+  std::cout << "Converted " << nrecords << " records, " << nimages
+            << " images" << std::endl;
+  return 0;
+}
@@ -129,13 +129,26 @@ for mname in args.models:
     elif mname in ["distilbert"]:
         traced_model = torch.jit.trace(model, (input_ids, att_mask))
     elif mname in ["gpt2"]:
-        # change order of positional arguments
+        # change order of positional arguments, past keys and values of all
+        # layers are stacked into a single tensor
         def real_forward(self, i, p):
-            return self.p_forward(input_ids=i, position_ids=p)
+            out = self.p_forward(input_ids=i, position_ids=p)
+            return out[0], torch.stack(out[1])
+        # same with past keys and values as input, lets the server generate
+        # text one token at a time
+        def forward_past(self, i, p, past):
+            out = self.p_forward(input_ids=i, position_ids=p,
+                                 past=torch.unbind(past))
+            return out[0], torch.stack(out[1])
         setattr(mclass, 'p_forward', mclass.forward)
         setattr(mclass, 'forward', real_forward)
+        setattr(mclass, 'forward_past', forward_past)
 
-        traced_model = torch.jit.trace(model, (input_ids, position_ids))
+        with torch.no_grad():
+            _, past = model(input_ids[:, :-1], position_ids[:, :-1])
+        traced_model = torch.jit.trace_module(model, {
+            "forward": (input_ids, position_ids),
+            "forward_past": (input_ids[:, -1:], position_ids[:, -1:], past)})
     else:
         raise ValueError("there is no method to trace this model: %s" % mname)
     